@@ -0,0 +1,90 @@
+/*
+ * Compares HartState's CSR storage policies (see CSRStorage.hpp) on trap-heavy
+ * and CSR-heavy work, for RV32 and RV64. The two are built as separate copies
+ * of this file, so build it twice with optimization, e.g.
+ *
+ *     g++ -std=c++20 -O2 -Iinclude -I<RISCV-Knowledge>/include \
+ *         bench/CSRStorage.cpp -o csr-storage-bench
+ *     g++ -std=c++20 -O2 -DHARTKIT_PACKED_CSRS -Iinclude \
+ *         -I<RISCV-Knowledge>/include bench/CSRStorage.cpp -o csr-storage-bench-packed
+ *
+ * and build HartKit clients with HARTKIT_PACKED_CSRS if the packed numbers are
+ * higher.
+ */
+
+#include <chrono>
+#include <cstdio>
+
+#include <HartState.hpp>
+
+static constexpr unsigned int Iterations = 10000000;
+
+template<typename Body>
+static double MillionsPerSecond(Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < Iterations; i++) {
+        body(i);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return Iterations / elapsed.count() / 1e6;
+}
+
+// Each iteration takes an exception, returns from it, and takes and returns
+// from a timer interrupt, like an OS fielding ecalls and ticks.
+template<typename XLEN_t>
+static double Traps() {
+    HartState<XLEN_t> state(0);
+    state.Reset(0x80000000);
+    state.mtvec.base = 0x80001000;
+    state.mtvec.mode = RISCV::tvecMode::Direct;
+    state.mie.mti = true;
+    return MillionsPerSecond([&](unsigned int i) {
+        state.mstatus.mie = true;
+        state.RaiseException(RISCV::TrapCause::ECALL_FROM_M_MODE, i);
+        state.mepc += 4;
+        state.template ReturnFromTrap<RISCV::PrivilegeMode::Machine>();
+        state.mip.mti = true;
+        state.ServiceInterrupts();
+        state.mip.mti = false;
+        state.template ReturnFromTrap<RISCV::PrivilegeMode::Machine>();
+    });
+}
+
+// Each iteration does the whole-register CSR accesses of a context switch.
+template<typename XLEN_t>
+static double CSRAccesses() {
+    HartState<XLEN_t> state(0);
+    state.Reset(0x80000000);
+    XLEN_t sink = 0;
+    double rate = MillionsPerSecond([&](unsigned int i) {
+        sink += state.ReadCSR(RISCV::CSRAddress::MSTATUS);
+        state.WriteCSR(RISCV::CSRAddress::MSTATUS, sink | (i & 0x88));
+        sink += state.ReadCSR(RISCV::CSRAddress::SSTATUS);
+        state.WriteCSR(RISCV::CSRAddress::MIE, i & 0xAAA);
+        sink += state.ReadCSR(RISCV::CSRAddress::MIP);
+        sink += state.ReadCSR(RISCV::CSRAddress::SIE);
+        state.WriteCSR(RISCV::CSRAddress::MCAUSE, i);
+        sink += state.ReadCSR(RISCV::CSRAddress::MCAUSE);
+        sink += state.ReadCSR(RISCV::CSRAddress::SATP);
+    });
+    volatile XLEN_t keep = sink;
+    (void)keep;
+    return rate;
+}
+
+template<typename XLEN_t>
+static void Measure(const char* name) {
+    printf("%s traps: %.1f M/s\n", name, Traps<XLEN_t>());
+    printf("%s CSR groups: %.1f M/s\n", name, CSRAccesses<XLEN_t>());
+}
+
+int main() {
+#if defined(HARTKIT_PACKED_CSRS)
+    printf("packed CSRs\n");
+#else
+    printf("field CSRs\n");
+#endif
+    Measure<__uint32_t>("RV32");
+    Measure<__uint64_t>("RV64");
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Compares swizzle's portable shift-and-mask path with its BMI2 pext/pdep path
+ * (see Swizzle.hpp) on the multi-slice immediates, over random encodings. The
+ * two are built as separate copies of this file, so build it twice with
+ * optimization, e.g.
+ *
+ *     g++ -std=c++20 -O2 -march=native -Iinclude -I<RISCV-Knowledge>/include \
+ *         bench/Swizzle.cpp -o swizzle-bench
+ *     g++ -std=c++20 -O2 -march=native -DHARTKIT_PORTABLE_SWIZZLE -Iinclude \
+ *         -I<RISCV-Knowledge>/include bench/Swizzle.cpp -o swizzle-bench-portable
+ *
+ * and build HartKit clients with HARTKIT_PORTABLE_SWIZZLE where the portable
+ * numbers are higher.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include <Instructions.hpp>
+#include <RiscVDecoder.hpp>
+
+static constexpr unsigned int Iterations = 10000000;
+static constexpr unsigned int Encodings = 4096;
+
+template<typename Body>
+static double MillionsPerSecond(Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < Iterations; i++) {
+        body(i);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return Iterations / elapsed.count() / 1e6;
+}
+
+// Extracts one immediate from each encoding in turn. Independent extractions
+// overlap, as in a decode loop, so this measures throughput; dependent ones
+// pick each encoding with the last immediate, as a branch target feeds the
+// next fetch, so this measures latency.
+template<typename XLEN_t, bool dependent, ExtendBits extend, unsigned int... slices>
+static double Immediate(const std::vector<__uint32_t>& encodings) {
+    XLEN_t sink = 0;
+    double rate = MillionsPerSecond([&](unsigned int i) {
+        if constexpr (dependent) {
+            sink = swizzle<XLEN_t, extend, slices...>(encodings[(i ^ (unsigned int)sink) % Encodings]);
+        } else {
+            sink += swizzle<XLEN_t, extend, slices...>(encodings[i % Encodings]);
+        }
+    });
+    volatile XLEN_t keep = sink;
+    (void)keep;
+    return rate;
+}
+
+template<typename XLEN_t, bool dependent>
+static void Compare(const char* name, const std::vector<__uint32_t>& encodings) {
+    printf("%s %s: I %.1f, S %.1f, B %.1f, J %.1f, CB %.1f, CJ %.1f, CI_SP %.1f M/s\n", name,
+           dependent ? "dependent" : "independent",
+           Immediate<XLEN_t, dependent, ExtendBits::Sign, I_IMM>(encodings),
+           Immediate<XLEN_t, dependent, S_IMM>(encodings),
+           Immediate<XLEN_t, dependent, B_IMM>(encodings),
+           Immediate<XLEN_t, dependent, J_IMM>(encodings),
+           Immediate<XLEN_t, dependent, CB_IMM>(encodings),
+           Immediate<XLEN_t, dependent, CJ_IMM>(encodings),
+           Immediate<XLEN_t, dependent, CI_SP_IMM>(encodings));
+}
+
+int main() {
+#if defined(HARTKIT_BMI2_SWIZZLE)
+    printf("pext/pdep swizzle\n");
+#else
+    printf("portable swizzle\n");
+#endif
+    std::mt19937 random(1);
+    std::vector<__uint32_t> encodings(Encodings);
+    for (__uint32_t& encoding : encodings) {
+        encoding = random();
+    }
+    Compare<__uint32_t, false>("RV32", encodings);
+    Compare<__uint32_t, true>("RV32", encodings);
+    Compare<__uint64_t, false>("RV64", encodings);
+    Compare<__uint64_t, true>("RV64", encodings);
+    return 0;
+}
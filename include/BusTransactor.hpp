@@ -0,0 +1,181 @@
+#pragma once
+
+/*
+ * A Transactor that routes accesses to the devices mapped on a physical bus.
+ * Device ranges are recorded in a radix table over 4 KiB pages - two levels
+ * for RV32, four for RV64's 56-bit physical space - so finding the device for
+ * an address costs the same handful of loads however many devices there are.
+ * A device that covers a whole subtree (big RAM, say) sits at that level, with
+ * its pointer tagged in bit 0, rather than filling in every page below it.
+ * Devices that share a page are chained off it, and told apart by range.
+ *
+ * Devices see absolute physical addresses, just as RAMTransactor does, so RAM
+ * can be mapped here like any other device. Accesses that hit nothing, or run
+ * off the end of a device, are access faults.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <RiscV.hpp>
+#include <Transaction.hpp>
+#include <Transactor.hpp>
+
+template<typename XLEN_t>
+class BusTransactor final : public Transactor<XLEN_t> {
+
+private:
+
+    struct Mapping {
+        __uint64_t base;
+        __uint64_t end; // Exclusive
+        Transactor<XLEN_t>* device;
+        Mapping* next; // Another mapping on the same page, if any
+    };
+
+    static constexpr unsigned int PageBits = 12;
+    static constexpr unsigned int PhysicalBits = sizeof(XLEN_t) == 4 ? 32 : 56;
+    static constexpr unsigned int Levels = sizeof(XLEN_t) == 4 ? 2 : 4;
+    static constexpr unsigned int LevelBits = (PhysicalBits - PageBits + Levels - 1) / Levels;
+    static constexpr unsigned int LevelSize = 1 << LevelBits;
+
+    struct Node {
+        void* children[LevelSize] = {};
+    };
+
+    Node root;
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<std::unique_ptr<Mapping>> mappings;
+
+    inline unsigned int IndexAt(__uint64_t page, unsigned int level) {
+        return (page >> (level * LevelBits)) & (LevelSize - 1);
+    }
+
+    static inline bool IsMapping(void* child) {
+        return (uintptr_t)child & 1;
+    }
+
+    static inline Mapping* AsMapping(void* child) {
+        return (Mapping*)((uintptr_t)child & ~(uintptr_t)1);
+    }
+
+    // Adds mapping over pages [first, last] below node, whose subtrees each
+    // span 1 << (level * LevelBits) pages starting from nodeFirst.
+    inline void Insert(Node* node, unsigned int level, __uint64_t nodeFirst,
+                       __uint64_t first, __uint64_t last, Mapping* mapping) {
+        __uint64_t span = (__uint64_t)1 << (level * LevelBits);
+        for (__uint64_t index = (first - nodeFirst) / span; index <= (last - nodeFirst) / span; index++) {
+            __uint64_t childFirst = nodeFirst + index * span;
+            __uint64_t childLast = childFirst + span - 1;
+            void*& child = node->children[index];
+            if (level == 0) {
+                // Pages shared between devices get a chain of per-page
+                // copies, so each chain only holds that page's mappings.
+                if (child != nullptr) {
+                    mappings.push_back(std::make_unique<Mapping>(*mapping));
+                    mappings.back()->next = AsMapping(child);
+                    child = (void*)((uintptr_t)mappings.back().get() | 1);
+                } else {
+                    child = (void*)((uintptr_t)mapping | 1);
+                }
+                continue;
+            }
+            if (child == nullptr && first <= childFirst && childLast <= last) {
+                child = (void*)((uintptr_t)mapping | 1);
+                continue;
+            }
+            if (child == nullptr) {
+                nodes.push_back(std::make_unique<Node>());
+                child = nodes.back().get();
+            }
+            Insert((Node*)child, level - 1, childFirst,
+                   first > childFirst ? first : childFirst, last < childLast ? last : childLast, mapping);
+        }
+    }
+
+    inline Mapping* Lookup(__uint64_t address) {
+        __uint64_t page = address >> PageBits;
+        if constexpr (sizeof(XLEN_t) > 4) {
+            if (page >> (PhysicalBits - PageBits)) {
+                return nullptr;
+            }
+        }
+        void* child = &root;
+        for (int level = Levels - 1; level >= 0; level--) {
+            child = ((Node*)child)->children[IndexAt(page, level)];
+            if (child == nullptr || IsMapping(child)) {
+                break;
+            }
+        }
+        if (child == nullptr) {
+            return nullptr;
+        }
+        Mapping* mapping = AsMapping(child);
+        while (mapping != nullptr && (address < mapping->base || address >= mapping->end)) {
+            mapping = mapping->next;
+        }
+        return mapping;
+    }
+
+    template<IOVerb verb>
+    inline Transaction<XLEN_t> Access(XLEN_t startAddress, XLEN_t size, char* buf) {
+        Mapping* mapping = Lookup(startAddress);
+        if (mapping == nullptr) [[unlikely]] {
+            return { AccessFault<verb>(), 0 };
+        }
+        if ((__uint64_t)startAddress + size <= mapping->end) [[likely]] {
+            return mapping->device->template Transact<verb>(startAddress, size, buf);
+        }
+        XLEN_t inside = mapping->end - startAddress;
+        Transaction<XLEN_t> transaction = mapping->device->template Transact<verb>(startAddress, inside, buf);
+        if (transaction.trapCause == RISCV::TrapCause::NONE) {
+            transaction.trapCause = AccessFault<verb>();
+        }
+        return transaction;
+    }
+
+public:
+
+    BusTransactor() = default;
+    BusTransactor(const BusTransactor&) = delete;
+    BusTransactor& operator=(const BusTransactor&) = delete;
+
+    // Maps device over [base, base + size). Returns false, mapping nothing, if
+    // that overlaps a device already on the bus or doesn't fit the address space.
+    inline bool Map(__uint64_t base, __uint64_t size, Transactor<XLEN_t>* device) {
+        __uint64_t end = base + size;
+        if (size == 0 || end < base || (end - 1) >> PhysicalBits) {
+            return false;
+        }
+        for (const std::unique_ptr<Mapping>& mapping : mappings) {
+            if (base < mapping->end && mapping->base < end) {
+                return false;
+            }
+        }
+        mappings.push_back(std::make_unique<Mapping>(Mapping { base, end, device, nullptr }));
+        Insert(&root, Levels - 1, 0, base >> PageBits, (end - 1) >> PageBits, mappings.back().get());
+        return true;
+    }
+
+    inline Transaction<XLEN_t> Read(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Read>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Write(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Write>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Fetch(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Fetch>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> CompareAndSwap(XLEN_t startAddress, XLEN_t size, char* expected, char* desired) override {
+        Mapping* mapping = Lookup(startAddress);
+        if (mapping == nullptr || (__uint64_t)startAddress + size > mapping->end) {
+            return { RISCV::TrapCause::STORE_AMO_ACCESS_FAULT, 0 };
+        }
+        return mapping->device->CompareAndSwap(startAddress, size, expected, desired);
+    }
+
+};
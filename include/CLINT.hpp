@@ -0,0 +1,151 @@
+#pragma once
+
+/*
+ * A reference CLINT: msip, mtimecmp and mtime at the usual SiFive offsets from
+ * its base. The MSIP and MTIP bits of each hart's mip follow the registers.
+ *
+ * Standalone, time only moves when the client calls Advance (or SetTime), so a
+ * simulation can tie mtime to instructions retired, host time, or anything
+ * else. Given an EventQueue, mtime instead follows the queue's clock (plus
+ * whatever offset guest writes to mtime have introduced), and each hart's
+ * mtimecmp is scheduled as an event, so idle harts can skip to it.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <RiscV.hpp>
+#include <EventQueue.hpp>
+#include <HartState.hpp>
+#include <Transaction.hpp>
+#include <Transactor.hpp>
+
+template<typename XLEN_t>
+class CLINT final : public Transactor<XLEN_t> {
+
+public:
+
+    static constexpr XLEN_t DefaultBase = 0x2000000;
+    static constexpr XLEN_t Size = 0x10000;
+
+    enum Offset : XLEN_t {
+        MSIP = 0x0,
+        MTIMECMP = 0x4000,
+        MTIME = 0xBFF8
+    };
+
+private:
+
+    XLEN_t base;
+    std::vector<HartState<XLEN_t>*> harts;
+    std::vector<__uint32_t> msip;
+    std::vector<__uint64_t> mtimecmp;
+    __uint64_t mtime = 0; // With an EventQueue, mtime's offset from its clock
+    EventQueue* events;
+    std::vector<unsigned int> timerEvents;
+
+    inline void UpdateTimerInterrupt(unsigned int hart) {
+        harts[hart]->mip.mti = Time() >= mtimecmp[hart];
+        if (events != nullptr) {
+            if (harts[hart]->mip.mti || mtimecmp[hart] == ~(__uint64_t)0) {
+                events->Cancel(timerEvents[hart]);
+            } else {
+                events->Schedule(timerEvents[hart], mtimecmp[hart] - mtime);
+            }
+        }
+    }
+
+    // Accesses may be narrower than the register (RV32 reaches mtime and
+    // mtimecmp a half at a time), so registers are read and written as bytes.
+    template<IOVerb verb, typename REG_t>
+    static inline bool AccessRegister(REG_t* reg, XLEN_t offset, XLEN_t size, char* buf) {
+        if (offset + size > sizeof(REG_t)) {
+            return false;
+        }
+        if constexpr (verb == IOVerb::Write) {
+            memcpy((char*)reg + offset, buf, size);
+        } else {
+            memcpy(buf, (char*)reg + offset, size);
+        }
+        return true;
+    }
+
+    template<IOVerb verb>
+    inline Transaction<XLEN_t> Access(XLEN_t startAddress, XLEN_t size, char* buf) {
+        if constexpr (verb == IOVerb::Fetch) {
+            return { AccessFault<verb>(), 0 };
+        }
+        XLEN_t offset = startAddress - base;
+        bool ok = false;
+        if (offset >= MTIME) {
+            __uint64_t time = Time();
+            ok = AccessRegister<verb>(&time, offset - MTIME, size, buf);
+            if constexpr (verb == IOVerb::Write) {
+                SetTime(time);
+            }
+        } else if (offset >= MTIMECMP) {
+            unsigned int hart = (offset - MTIMECMP) / sizeof(__uint64_t);
+            if (hart < harts.size()) {
+                ok = AccessRegister<verb>(&mtimecmp[hart], (offset - MTIMECMP) % sizeof(__uint64_t), size, buf);
+                if constexpr (verb == IOVerb::Write) {
+                    UpdateTimerInterrupt(hart);
+                }
+            }
+        } else {
+            unsigned int hart = offset / sizeof(__uint32_t);
+            if (hart < harts.size()) {
+                ok = AccessRegister<verb>(&msip[hart], offset % sizeof(__uint32_t), size, buf);
+                if constexpr (verb == IOVerb::Write) {
+                    msip[hart] &= 1;
+                    harts[hart]->mip.msi = msip[hart];
+                }
+            }
+        }
+        if (!ok) {
+            return { AccessFault<verb>(), 0 };
+        }
+        return { RISCV::TrapCause::NONE, size };
+    }
+
+public:
+
+    CLINT(std::vector<HartState<XLEN_t>*> harts, XLEN_t base = DefaultBase, EventQueue* events = nullptr)
+        : base(base), harts(harts), msip(harts.size(), 0), mtimecmp(harts.size(), ~(__uint64_t)0), events(events) {
+        if (events == nullptr) {
+            return;
+        }
+        for (unsigned int hart = 0; hart < harts.size(); hart++) {
+            timerEvents.push_back(events->Register([this, hart] { UpdateTimerInterrupt(hart); }));
+        }
+    }
+
+    inline Transaction<XLEN_t> Read(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Read>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Write(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Write>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Fetch(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Fetch>(startAddress, size, buf);
+    }
+
+    inline void SetTime(__uint64_t time) {
+        mtime = events == nullptr ? time : time - events->Now();
+        for (unsigned int hart = 0; hart < harts.size(); hart++) {
+            UpdateTimerInterrupt(hart);
+        }
+    }
+
+    // With an EventQueue, this shifts mtime against the queue's clock
+    inline void Advance(__uint64_t ticks) {
+        SetTime(Time() + ticks);
+    }
+
+    inline __uint64_t Time() { return events == nullptr ? mtime : events->Now() + mtime; }
+    inline __uint64_t TimeCompare(unsigned int hart) { return mtimecmp[hart]; }
+    inline XLEN_t Base() { return base; }
+
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+/*
+ * How HartState stores mstatus, mie/mip, the cause registers and satp. The
+ * RISCV-Knowledge register types break each field out into a member of its
+ * own, which makes field accesses plain loads and stores but means reading or
+ * writing the whole CSR has to gather or scatter every field. The packed types
+ * here hold each register as bit-fields of one word, laid out as the CSR is, so
+ * whole-register accesses are a mask and field accesses are a shift and mask.
+ *
+ * Both kinds have the same member names and the same Read/Write/Reset, so code
+ * using HartState doesn't care which it gets. HartState uses FieldCSRs, or
+ * PackedCSRs when built with HARTKIT_PACKED_CSRS defined. It isn't a template
+ * parameter, since executors all take HartState<XLEN_t>; bench/CSRStorage.cpp,
+ * built once each way, compares them.
+ *
+ * The tvec registers stay broken out under both: consumers use tvec.base as the
+ * trap vector address, which a bit-field of the packed word couldn't hold.
+ */
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include <RiscV.hpp>
+
+// Layout for GCC and Clang on a little-endian host: bit-fields fill from bit 0.
+// spp and mpp sit outside the word, since a PrivilegeMode bit-field would be
+// signed and couldn't hold Machine in mpp's two bits.
+struct PackedStatus {
+
+    bool uie : 1;
+    bool sie : 1;
+    __uint64_t : 1;
+    bool mie : 1;
+    bool upie : 1;
+    bool spie : 1;
+    __uint64_t : 1;
+    bool mpie : 1;
+    __uint64_t : 5; // spp, and mpp
+    __uint64_t fs : 2;
+    __uint64_t xs : 2;
+    bool mprv : 1;
+    bool sum : 1;
+    bool mxr : 1;
+    bool tvm : 1;
+    bool tw : 1;
+    bool tsr : 1;
+    __uint64_t : 41;
+
+    RISCV::PrivilegeMode spp;
+    RISCV::PrivilegeMode mpp;
+
+    static constexpr __uint64_t UserView = 0x11;
+    static constexpr __uint64_t SupervisorView = 0xDE133;
+    static constexpr __uint64_t MachineView = 0x7FF9BB;
+    static constexpr __uint64_t ReadOnly = 0x18000; // xs
+    static constexpr unsigned int SPPShift = 8;
+    static constexpr unsigned int MPPShift = 11;
+
+    template<RISCV::PrivilegeMode privilege>
+    static constexpr __uint64_t View() {
+        if constexpr (privilege == RISCV::PrivilegeMode::Machine) {
+            return MachineView;
+        } else if constexpr (privilege == RISCV::PrivilegeMode::Supervisor) {
+            return SupervisorView;
+        } else {
+            return UserView;
+        }
+    }
+
+    inline __uint64_t Word() {
+        __uint64_t word;
+        memcpy(&word, this, sizeof(word));
+        return word;
+    }
+
+    inline void SetWord(__uint64_t word) {
+        memcpy(this, &word, sizeof(word));
+    }
+
+    template<typename XLEN_t>
+    inline void Reset() {
+        SetWord(0);
+        spp = RISCV::PrivilegeMode::User;
+        mpp = RISCV::PrivilegeMode::User;
+    }
+
+    // SD summarizes fs and xs; on RV64, uxl (and, for M-mode, sxl) read as 64.
+    template<typename XLEN_t, RISCV::PrivilegeMode privilege>
+    inline XLEN_t Read() {
+        __uint64_t value = Word();
+        value |= ((__uint64_t)spp << SPPShift) | ((__uint64_t)mpp << MPPShift);
+        value &= View<privilege>();
+        if (fs == 3 || xs == 3) {
+            value |= (__uint64_t)1 << (8 * sizeof(XLEN_t) - 1);
+        }
+        if constexpr (sizeof(XLEN_t) == 8) {
+            if constexpr (privilege == RISCV::PrivilegeMode::Machine) {
+                value |= (__uint64_t)0xA << 32;
+            } else if constexpr (privilege == RISCV::PrivilegeMode::Supervisor) {
+                value |= (__uint64_t)0x2 << 32;
+            }
+        }
+        return value;
+    }
+
+    template<typename XLEN_t, RISCV::PrivilegeMode privilege>
+    inline void Write(XLEN_t value) {
+        constexpr __uint64_t writable = View<privilege>() & ~ReadOnly;
+        SetWord((Word() & ~writable) | ((__uint64_t)value & writable));
+        if constexpr (privilege != RISCV::PrivilegeMode::User) {
+            spp = (RISCV::PrivilegeMode)((value >> SPPShift) & 1);
+        }
+        if constexpr (privilege == RISCV::PrivilegeMode::Machine) {
+            RISCV::PrivilegeMode newMPP = (RISCV::PrivilegeMode)((value >> MPPShift) & 3);
+            if (newMPP != RISCV::PrivilegeMode::Reserved) {
+                mpp = newMPP;
+            }
+        }
+    }
+
+};
+
+struct PackedInterrupts {
+
+    bool usi : 1;
+    bool ssi : 1;
+    __uint32_t : 1;
+    bool msi : 1;
+    bool uti : 1;
+    bool sti : 1;
+    __uint32_t : 1;
+    bool mti : 1;
+    bool uei : 1;
+    bool sei : 1;
+    __uint32_t : 1;
+    bool mei : 1;
+    __uint32_t : 20;
+
+    template<RISCV::PrivilegeMode privilege>
+    static constexpr __uint32_t View() {
+        if constexpr (privilege == RISCV::PrivilegeMode::Machine) {
+            return 0xBBB;
+        } else if constexpr (privilege == RISCV::PrivilegeMode::Supervisor) {
+            return 0x333;
+        } else {
+            return 0x111;
+        }
+    }
+
+    inline void Reset() {
+        *this = std::bit_cast<PackedInterrupts>((__uint32_t)0);
+    }
+
+    template<typename XLEN_t, RISCV::PrivilegeMode privilege>
+    inline XLEN_t Read() {
+        return std::bit_cast<__uint32_t>(*this) & View<privilege>();
+    }
+
+    template<typename XLEN_t, RISCV::PrivilegeMode privilege>
+    inline void Write(XLEN_t value) {
+        __uint32_t word = std::bit_cast<__uint32_t>(*this);
+        *this = std::bit_cast<PackedInterrupts>((word & ~View<privilege>()) | ((__uint32_t)value & View<privilege>()));
+    }
+
+};
+
+static_assert(sizeof(PackedInterrupts) == sizeof(__uint32_t));
+
+template<typename XLEN_t>
+struct PackedCause {
+
+    XLEN_t exceptionCode : 8 * sizeof(XLEN_t) - 1;
+    bool interrupt : 1;
+
+    inline void Reset() { *this = std::bit_cast<PackedCause>((XLEN_t)0); }
+    inline XLEN_t Read() { return std::bit_cast<XLEN_t>(*this); }
+    inline void Write(XLEN_t value) { *this = std::bit_cast<PackedCause>(value); }
+
+};
+
+// mode holds a RISCV::PagingMode rather than satp's MODE encoding, so that
+// consumers can pass it straight to TranslationAlgorithm, and sits outside the
+// word like mstatus's privilege fields. Writing a mode this XLEN doesn't have
+// leaves satp as it was.
+template<typename XLEN_t>
+struct PackedSatp {
+
+    static constexpr unsigned int PPNBits = sizeof(XLEN_t) == 4 ? 22 : 44;
+    static constexpr unsigned int ASIDBits = sizeof(XLEN_t) == 4 ? 9 : 16;
+    static constexpr unsigned int ModeShift = PPNBits + ASIDBits;
+
+    XLEN_t ppn : PPNBits;
+    XLEN_t asid : ASIDBits;
+    RISCV::PagingMode mode;
+
+    inline void Reset() {
+        ppn = 0;
+        asid = 0;
+        mode = RISCV::PagingMode::Bare;
+    }
+
+    inline XLEN_t Read() {
+        XLEN_t modeBits = 0;
+        if (mode == RISCV::PagingMode::Sv32) {
+            modeBits = 1;
+        } else if (mode == RISCV::PagingMode::Sv39) {
+            modeBits = 8;
+        } else if (mode == RISCV::PagingMode::Sv48) {
+            modeBits = 9;
+        }
+        return ((XLEN_t)modeBits << ModeShift) | ((XLEN_t)asid << PPNBits) | (XLEN_t)ppn;
+    }
+
+    inline void Write(XLEN_t value) {
+        XLEN_t modeBits = value >> ModeShift;
+        RISCV::PagingMode newMode;
+        if (modeBits == 0) {
+            newMode = RISCV::PagingMode::Bare;
+        } else if (sizeof(XLEN_t) == 4 && modeBits == 1) {
+            newMode = RISCV::PagingMode::Sv32;
+        } else if (sizeof(XLEN_t) == 8 && modeBits == 8) {
+            newMode = RISCV::PagingMode::Sv39;
+        } else if (sizeof(XLEN_t) == 8 && modeBits == 9) {
+            newMode = RISCV::PagingMode::Sv48;
+        } else {
+            return;
+        }
+        mode = newMode;
+        asid = value >> PPNBits;
+        ppn = value;
+    }
+
+};
+
+struct FieldCSRs {
+    template<typename XLEN_t> using Status = RISCV::mstatusReg;
+    template<typename XLEN_t> using Interrupts = RISCV::interruptReg;
+    template<typename XLEN_t> using Cause = RISCV::causeReg<XLEN_t>;
+    template<typename XLEN_t> using Satp = RISCV::satpReg<XLEN_t>;
+};
+
+struct PackedCSRs {
+    template<typename XLEN_t> using Status = PackedStatus;
+    template<typename XLEN_t> using Interrupts = PackedInterrupts;
+    template<typename XLEN_t> using Cause = PackedCause<XLEN_t>;
+    template<typename XLEN_t> using Satp = PackedSatp<XLEN_t>;
+};
+
+#ifdef HARTKIT_PACKED_CSRS
+using DefaultCSRs = PackedCSRs;
+#else
+using DefaultCSRs = FieldCSRs;
+#endif
@@ -0,0 +1,334 @@
+#pragma once
+
+/*
+ * Decoded instructions for guest RAM, kept by physical address, so each
+ * instruction is decoded once rather than every time it's fetched. Each 4 KiB
+ * page gets a slot per halfword, holding the executor and the canonical
+ * encoding to hand it. A slot for every halfword covers both alignments RVC
+ * code can run at: a stream of 32-bit instructions that starts two bytes into
+ * a word decodes from the odd slots, and jumps into either stream land on a
+ * decoded slot. Without C, only the word-aligned slots are used.
+ *
+ * Slots fill on demand from the run loop (Decode), or in bulk ahead of time
+ * (Predecode), which splits a range into pages and decodes them on a pool of
+ * worker threads. Decoding needs nothing but the bytes and the configuration,
+ * so the pages are independent. Call Predecode after loading, e.g. over each
+ * executable segment LoadElf mapped. Nothing else may use the cache while it
+ * runs.
+ *
+ * Consecutive slots of a page are consecutive halfwords of code, so a block
+ * builder can walk a page's slots from any entry point, stepping by each
+ * instruction's length until a slot's endsBlock, and reuse the predecoded work
+ * as it goes. Persist attaches a DecodeCacheFile, so that pages decoded by
+ * earlier runs come from there.
+ *
+ * Breakpoints cost nothing until they're hit: SetBreakpoint patches the slot
+ * at an address with ex_breakpoint, which calls back with HitBreakpoint and
+ * leaves the pc where it is. The client stops its run loop there, and to carry
+ * on, runs the Original slot once by hand. Patches are reapplied whenever the
+ * page is decoded again, and never reach a DecodeCacheFile.
+ *
+ * Every page decoded from is marked with RAMTransactor::MarkCode. Pass the
+ * page addresses the RAMTransactor's TrackCode callback reports to
+ * InvalidatePage, so writes to code drop just that page. Pointers to a page's
+ * slots are good until it's invalidated. A 32-bit instruction that straddles
+ * the end of a page isn't cached, since writes to the next page couldn't
+ * invalidate it; Decode returns nullptr for it, as for anything outside RAM.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <RiscV.hpp>
+#include <DecodedInstruction.hpp>
+#include <DecodeCacheFile.hpp>
+#include <ISA.hpp>
+#include <Instructions.hpp>
+#include <RAMTransactor.hpp>
+#include <RiscVDecoder.hpp>
+
+template<typename XLEN_t, typename ISA = DefaultISA>
+class DecodeCache {
+
+private:
+
+    static constexpr unsigned int PageShift = 12;
+    static constexpr unsigned int SlotsPerPage = ((XLEN_t)1 << PageShift) / 2;
+    static constexpr unsigned int ChunkShift = 9; // Pages per directory entry
+
+    struct Page {
+        DecodedSlot<XLEN_t> slots[SlotsPerPage] = {};
+    };
+
+    struct Chunk {
+        std::unique_ptr<Page> pages[(XLEN_t)1 << ChunkShift];
+    };
+
+    RAMTransactor<XLEN_t>* ram;
+    __uint32_t extensionsVector;
+    RISCV::XlenMode mxlen;
+    std::vector<std::unique_ptr<Chunk>> directory;
+    DecodeCacheFile<XLEN_t>* file = nullptr;
+    typename DecodeCacheFile<XLEN_t>::Configuration configuration;
+
+    // Breakpoint addresses, and the slots the patches replaced
+    std::map<XLEN_t, DecodedSlot<XLEN_t>> breakpoints;
+
+    // nullptr outside RAM, or where no page has been made and create is false
+    inline std::unique_ptr<Page>* PageEntry(XLEN_t address, bool create) {
+        XLEN_t offset = address - ram->Base();
+        if (address < ram->Base() || offset >= ram->Size()) {
+            return nullptr;
+        }
+        XLEN_t page = offset >> PageShift;
+        std::unique_ptr<Chunk>& chunk = directory[page >> ChunkShift];
+        if (chunk == nullptr) {
+            if (!create) {
+                return nullptr;
+            }
+            chunk = std::make_unique<Chunk>();
+        }
+        return &chunk->pages[page & (((XLEN_t)1 << ChunkShift) - 1)];
+    }
+
+    // created says whether the page is new, and so has no slots filled yet
+    inline Page* PageFor(XLEN_t address, bool* created = nullptr) {
+        std::unique_ptr<Page>* entry = PageEntry(address, true);
+        if (entry == nullptr) {
+            return nullptr;
+        }
+        if (created != nullptr) {
+            *created = *entry == nullptr;
+        }
+        if (*entry == nullptr) {
+            *entry = std::make_unique<Page>();
+            ram->MarkCode(address);
+        }
+        return entry->get();
+    }
+
+    inline Instruction<XLEN_t> DecodeEncoding(__uint32_t encoding) {
+        if constexpr (ISA::Fixed) {
+            return decode_instruction<XLEN_t, ISA>(encoding, extensionsVector);
+        } else {
+            return decode_instruction<XLEN_t>(encoding, extensionsVector, mxlen);
+        }
+    }
+
+    // pageAddress is the guest address of page's first byte
+    inline void Fill(Page* page, XLEN_t pageAddress, unsigned int slot) {
+        const char* host = ram->HostPointer(pageAddress) + slot * 2;
+        __uint32_t encoding;
+        __uint16_t low;
+        memcpy(&low, host, sizeof(low));
+        if ((low & 0b11) != 0b11) {
+            encoding = low;
+        } else if (slot == SlotsPerPage - 1) {
+            return;
+        } else {
+            memcpy(&encoding, host, sizeof(encoding));
+        }
+        __uint32_t canonical = canonical_encoding(encoding, mxlen);
+        page->slots[slot] = { DecodeEncoding(encoding).executionFunction, canonical, ends_block(canonical) };
+    }
+
+    inline void Patch(DecodedSlot<XLEN_t>* slot, DecodedSlot<XLEN_t>* original) {
+        if (slot->executor == nullptr || slot->executor == ex_breakpoint<XLEN_t>) {
+            return;
+        }
+        *original = *slot;
+        *slot = { ex_breakpoint<XLEN_t>, slot->encoding, true };
+    }
+
+    // Patches the breakpoints on a page that's just been (re)filled. Predecode
+    // threads each patch their own pages, so they touch different entries.
+    inline void PatchPage(Page* page, XLEN_t pageAddress) {
+        if (breakpoints.empty()) [[likely]] {
+            return;
+        }
+        auto end = breakpoints.lower_bound(pageAddress + ((XLEN_t)1 << PageShift));
+        for (auto breakpoint = breakpoints.lower_bound(pageAddress); breakpoint != end; breakpoint++) {
+            Patch(&page->slots[(breakpoint->first >> 1) & (SlotsPerPage - 1)], &breakpoint->second);
+        }
+    }
+
+    // Takes the whole page from the file if it's there, and stores it there
+    // if not.
+    inline void FillPage(Page* page, XLEN_t pageAddress) {
+        const char* host = ram->HostPointer(pageAddress);
+        if (file == nullptr || !file->Load(configuration, host, page->slots)) {
+            unsigned int step = RISCV::vectorHasExtension(extensionsVector, 'C') ? 1 : 2;
+            for (unsigned int slot = 0; slot < SlotsPerPage; slot += step) {
+                Fill(page, pageAddress, slot);
+            }
+            if (file != nullptr) {
+                file->Store(configuration, host, page->slots);
+            }
+        }
+        PatchPage(page, pageAddress);
+    }
+
+    inline void Configured() {
+        if (file == nullptr) {
+            return;
+        }
+        configuration = DecodeCacheFile<XLEN_t>::Configure(extensionsVector, mxlen, ISA::extensions,
+            [this](__uint32_t encoding) { return DecodeEncoding(encoding).executionFunction; });
+    }
+
+public:
+
+    DecodeCache(RAMTransactor<XLEN_t>* ram, __uint32_t extensionsVector, RISCV::XlenMode mxlen)
+        : ram(ram), extensionsVector(extensionsVector), mxlen(mxlen),
+          directory(((ram->Size() >> PageShift) >> ChunkShift) + 1) {
+        static_assert(SlotsPerPage == DecodeCacheFile<XLEN_t>::SlotsPerPage);
+    }
+
+    // Shares decoded pages with other runs through file (see DecodeCacheFile).
+    // With a file, pages are decoded whole, even on demand.
+    inline void Persist(DecodeCacheFile<XLEN_t>* newFile) {
+        file = newFile;
+        Configured();
+    }
+
+    // The slot for address, if it's been decoded
+    inline const DecodedSlot<XLEN_t>* Lookup(XLEN_t address) {
+        std::unique_ptr<Page>* entry = PageEntry(address, false);
+        if (entry == nullptr || *entry == nullptr) {
+            return nullptr;
+        }
+        const DecodedSlot<XLEN_t>* slot = &(*entry)->slots[(address >> 1) & (SlotsPerPage - 1)];
+        return slot->executor != nullptr ? slot : nullptr;
+    }
+
+    // The slot for address, decoding it first if need be
+    inline const DecodedSlot<XLEN_t>* Decode(XLEN_t address) {
+        const DecodedSlot<XLEN_t>* cached = Lookup(address);
+        if (cached != nullptr) [[likely]] {
+            return cached;
+        }
+        if (address & 1) {
+            return nullptr;
+        }
+        bool created;
+        Page* page = PageFor(address, &created);
+        if (page == nullptr) {
+            return nullptr;
+        }
+        XLEN_t pageAddress = address & ~(((XLEN_t)1 << PageShift) - 1);
+        unsigned int slot = (address >> 1) & (SlotsPerPage - 1);
+        if (file != nullptr && created) {
+            FillPage(page, pageAddress);
+        } else {
+            Fill(page, pageAddress, slot);
+            PatchPage(page, pageAddress);
+        }
+        return page->slots[slot].executor != nullptr ? &page->slots[slot] : nullptr;
+    }
+
+    // Decodes every page that overlaps [start, start + length) and is in RAM,
+    // on up to threads worker threads (0 for one per host CPU).
+    inline void Predecode(XLEN_t start, XLEN_t length, unsigned int threads = 0) {
+        if (length == 0) {
+            return;
+        }
+        std::vector<std::pair<Page*, XLEN_t>> work;
+        XLEN_t last = (start + length - 1) >> PageShift;
+        for (XLEN_t page = start >> PageShift; page <= last; page++) {
+            XLEN_t pageAddress = page << PageShift;
+            Page* target = PageFor(pageAddress);
+            if (target != nullptr) {
+                work.push_back({ target, pageAddress });
+            }
+            if (page == last) {
+                break;
+            }
+        }
+        if (threads == 0) {
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        threads = std::min<std::size_t>(threads, work.size());
+        std::atomic<std::size_t> next = 0;
+        auto worker = [&]() {
+            for (std::size_t index = next++; index < work.size(); index = next++) {
+                FillPage(work[index].first, work[index].second);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned int thread = 1; thread < threads; thread++) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& thread : pool) {
+            thread.join();
+        }
+    }
+
+    // Fails where there's no instruction the cache can hold
+    inline bool SetBreakpoint(XLEN_t address) {
+        if (breakpoints.count(address) != 0) {
+            return true;
+        }
+        if (Decode(address) == nullptr) {
+            return false;
+        }
+        Page* page = PageFor(address);
+        Patch(&page->slots[(address >> 1) & (SlotsPerPage - 1)], &breakpoints[address]);
+        return true;
+    }
+
+    inline void ClearBreakpoint(XLEN_t address) {
+        auto breakpoint = breakpoints.find(address);
+        if (breakpoint == breakpoints.end()) {
+            return;
+        }
+        std::unique_ptr<Page>* entry = PageEntry(address, false);
+        if (entry != nullptr && *entry != nullptr) {
+            DecodedSlot<XLEN_t>& slot = (*entry)->slots[(address >> 1) & (SlotsPerPage - 1)];
+            if (slot.executor == ex_breakpoint<XLEN_t>) {
+                slot = breakpoint->second;
+            }
+        }
+        breakpoints.erase(breakpoint);
+    }
+
+    // The instruction a breakpoint at address stands in for, for the client
+    // to run when resuming from it
+    inline const DecodedSlot<XLEN_t>* Original(XLEN_t address) {
+        auto breakpoint = breakpoints.find(address);
+        return breakpoint != breakpoints.end() ? &breakpoint->second : nullptr;
+    }
+
+    // Hand this the addresses from RAMTransactor's TrackCode callback
+    inline void InvalidatePage(XLEN_t address) {
+        std::unique_ptr<Page>* entry = PageEntry(address, false);
+        if (entry != nullptr) {
+            entry->reset();
+        }
+    }
+
+    inline void Invalidate() {
+        for (std::unique_ptr<Chunk>& chunk : directory) {
+            chunk.reset();
+        }
+        ram->ForgetCode();
+    }
+
+    // For misa writes: a new extensions vector or MXLEN drops everything
+    inline void Configure(__uint32_t newExtensionsVector, RISCV::XlenMode newMxlen) {
+        if (newExtensionsVector == extensionsVector && newMxlen == mxlen) {
+            return;
+        }
+        extensionsVector = newExtensionsVector;
+        mxlen = newMxlen;
+        Configured();
+        Invalidate();
+    }
+
+};
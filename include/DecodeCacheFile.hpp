@@ -0,0 +1,311 @@
+#pragma once
+
+/*
+ * A DecodeCache that persists between runs. Processes simulating the same
+ * images decode the same pages over and over; with a DecodeCacheFile attached,
+ * each page is decoded once, stored in a shared file, and found there by every
+ * later run instead.
+ *
+ * Executors can't be stored as pointers, which move from run to run, so each
+ * is stored as its index in a table of every executor the configuration can
+ * decode to, sorted by address. Configure finds them by decoding every
+ * combination of the fields the decoder looks at, which takes a few tens of
+ * milliseconds. The order only holds for the same build of the simulator, so
+ * entries are keyed by the build (its GNU build ID, or a hash of its code if
+ * it has none) as well as the decoder configuration (XLEN, extensions and
+ * MXLEN) and a hash of the page's bytes. An index past the end of the table
+ * fails the lookup, so whatever is in the file, Load only hands out real
+ * executors. Each entry also keeps a copy of the bytes, so a hash collision
+ * can't hand back the wrong page.
+ *
+ * The file is an open-addressed table of fixed capacity, mapped shared at
+ * startup. Nothing in it is checked until a page is looked up, so opening it
+ * costs the same however many entries it holds. Any number of processes (and
+ * DecodeCache's predecode threads) can use one file at once: an entry is
+ * claimed with a compare-and-swap, filled, then published. A process that dies
+ * mid-fill just wastes its entry. When a page's probe sequence is full, the
+ * page isn't stored; delete the file to start over.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include <fcntl.h>
+#include <link.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <RiscV.hpp>
+#include <DecodedInstruction.hpp>
+#include <Instructions.hpp>
+#include <RiscVDecoder.hpp>
+
+// A fast hash of whole 64-bit words; length must be a multiple of 8.
+inline __uint64_t decode_cache_hash(const char* bytes, std::size_t length, __uint64_t seed = 0) {
+    __uint64_t hash = seed ^ 0xcbf29ce484222325;
+    for (std::size_t offset = 0; offset < length; offset += sizeof(__uint64_t)) {
+        __uint64_t word;
+        memcpy(&word, bytes + offset, sizeof(word));
+        hash = (hash ^ word) * 0x9e3779b97f4a7c15;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+// Identifies the build of the loaded object containing address: by its GNU
+// build ID, or failing that by the contents of its executable segments.
+inline __uint64_t code_identity(const void* address) {
+    struct Search {
+        ElfW(Addr) address;
+        __uint64_t identity;
+    } search = { (ElfW(Addr))address, 0 };
+    dl_iterate_phdr([](struct dl_phdr_info* info, size_t, void* data) -> int {
+        Search* search = (Search*)data;
+        bool contains = false;
+        for (int index = 0; index < info->dlpi_phnum; index++) {
+            const ElfW(Phdr)& segment = info->dlpi_phdr[index];
+            ElfW(Addr) start = info->dlpi_addr + segment.p_vaddr;
+            if (segment.p_type == PT_LOAD && search->address - start < segment.p_memsz) {
+                contains = true;
+            }
+        }
+        if (!contains) {
+            return 0;
+        }
+        for (int index = 0; index < info->dlpi_phnum; index++) {
+            const ElfW(Phdr)& segment = info->dlpi_phdr[index];
+            if (segment.p_type != PT_NOTE) {
+                continue;
+            }
+            const char* note = (const char*)(info->dlpi_addr + segment.p_vaddr);
+            const char* end = note + segment.p_memsz;
+            while (note + sizeof(ElfW(Nhdr)) <= end) {
+                const ElfW(Nhdr)* header = (const ElfW(Nhdr)*)note;
+                const char* name = note + sizeof(ElfW(Nhdr));
+                const char* desc = name + ((header->n_namesz + 3) & ~3);
+                if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4 && memcmp(name, "GNU", 4) == 0 &&
+                    header->n_descsz <= 64) {
+                    char id[64] = {};
+                    memcpy(id, desc, header->n_descsz);
+                    search->identity = decode_cache_hash(id, sizeof(id), header->n_descsz);
+                    return 1;
+                }
+                note = desc + ((header->n_descsz + 3) & ~3);
+            }
+        }
+        for (int index = 0; index < info->dlpi_phnum; index++) {
+            const ElfW(Phdr)& segment = info->dlpi_phdr[index];
+            if (segment.p_type == PT_LOAD && (segment.p_flags & PF_X)) {
+                search->identity = decode_cache_hash((const char*)(info->dlpi_addr + segment.p_vaddr),
+                                                     segment.p_memsz & ~7, search->identity);
+            }
+        }
+        return 1;
+    }, &search);
+    return search.identity;
+}
+
+template<typename XLEN_t>
+class DecodeCacheFile {
+
+public:
+
+    static constexpr unsigned int PageSize = 4096;
+    static constexpr unsigned int SlotsPerPage = PageSize / 2;
+
+    // Everything besides the page's bytes that decoding depends on
+    struct Configuration {
+        __uint64_t key = 0; // Hash of the build and the decoder configuration
+        std::vector<DecodedInstruction<XLEN_t>> executors; // By address
+    };
+
+private:
+
+    static constexpr __uint64_t Magic = 0x3230464344544b48; // "HKTDCF02"
+    static constexpr unsigned int Probes = 16;
+    static constexpr __uint64_t Empty = 0;
+    static constexpr __uint64_t Writing = 1;
+    static constexpr __uint64_t Ready = 2;
+    static constexpr __uint32_t Absent = ~(__uint32_t)0;
+
+    struct Header {
+        __uint64_t magic;
+        __uint64_t capacity;
+    };
+
+    struct PersistedSlot {
+        __uint32_t executor; // Index into Configuration::executors, or Absent
+        __uint32_t encoding;
+    };
+
+    struct Entry {
+        __uint64_t state;
+        __uint64_t contentHash;
+        __uint64_t configuration;
+        char content[PageSize];
+        PersistedSlot slots[SlotsPerPage];
+    };
+
+    Header* header = nullptr;
+    Entry* entries = nullptr;
+    std::size_t mappedSize = 0;
+
+public:
+
+    // Opens path, creating it with room for capacity pages if it doesn't exist
+    // or isn't a decode cache file. If it can't be opened, every Load misses
+    // and every Store does nothing; clients can check IsOpen().
+    DecodeCacheFile(const char* path, __uint64_t capacity = 4096) {
+        int fd = open(path, O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            return;
+        }
+        flock(fd, LOCK_EX);
+        Header existing = {};
+        struct stat status;
+        if (pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) && existing.magic == Magic &&
+            existing.capacity != 0 && fstat(fd, &status) == 0 && (__uint64_t)status.st_size >= sizeof(Entry) * (existing.capacity + 1)) {
+            capacity = existing.capacity;
+        } else {
+            existing = { Magic, capacity };
+            if (ftruncate(fd, 0) != 0 ||
+                ftruncate(fd, sizeof(Entry) * (capacity + 1)) != 0 ||
+                pwrite(fd, &existing, sizeof(existing), 0) != sizeof(existing)) {
+                capacity = 0;
+            }
+        }
+        if (capacity != 0) {
+            // The header gets an entry's worth of room, keeping entries aligned
+            std::size_t length = sizeof(Entry) * (capacity + 1);
+            void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (mapping != MAP_FAILED) {
+                mappedSize = length;
+                header = (Header*)mapping;
+                entries = (Entry*)mapping + 1;
+            }
+        }
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+
+    ~DecodeCacheFile() {
+        if (header != nullptr) {
+            munmap(header, mappedSize);
+        }
+    }
+
+    DecodeCacheFile(const DecodeCacheFile&) = delete;
+    DecodeCacheFile& operator=(const DecodeCacheFile&) = delete;
+
+    inline bool IsOpen() { return header != nullptr; }
+
+    // decode is the client's decoder for this configuration. Besides the
+    // opcode, funct3 and bits 31:20, it only cares whether rd is x0 and
+    // whether rs1 is x0 or 17 (for vid), so those are all that's tried.
+    template<typename Decode>
+    static inline Configuration Configure(__uint32_t extensionsVector, RISCV::XlenMode mxlen,
+                                          __uint32_t isaExtensions, Decode decode) {
+        static const __uint64_t build = code_identity((const void*)inst_illegal<XLEN_t>.executionFunction);
+        __uint64_t fields[] = { build, sizeof(XLEN_t), extensionsVector, (__uint64_t)mxlen, isaExtensions };
+        Configuration configuration;
+        configuration.key = decode_cache_hash((const char*)fields, sizeof(fields));
+        DecodedInstruction<XLEN_t> previous = nullptr;
+        for (__uint32_t bits = 0; bits < (1 << 20); bits++) {
+            __uint32_t encoding = ((bits >> 8) << 20) | (((bits >> 5) & 0b111) << 12) | ((bits & 0b11111) << 2) | 0b11;
+            for (__uint32_t rd : { 0, 1 }) {
+                for (__uint32_t rs1 : { 0, 0b10001 }) {
+                    DecodedInstruction<XLEN_t> executor = decode(encoding | (rs1 << 15) | (rd << 7));
+                    if (executor != previous) {
+                        configuration.executors.push_back(executor);
+                        previous = executor;
+                    }
+                }
+            }
+        }
+        std::vector<DecodedInstruction<XLEN_t>>& executors = configuration.executors;
+        std::sort(executors.begin(), executors.end(), std::less<DecodedInstruction<XLEN_t>>());
+        executors.erase(std::unique(executors.begin(), executors.end()), executors.end());
+        return configuration;
+    }
+
+    // Fills slots for the page at page, if the file has it
+    inline bool Load(const Configuration& configuration, const char* page, DecodedSlot<XLEN_t>* slots) {
+        if (header == nullptr) {
+            return false;
+        }
+        __uint64_t contentHash = decode_cache_hash(page, PageSize);
+        for (unsigned int probe = 0; probe < Probes; probe++) {
+            Entry& entry = entries[(contentHash + probe) % header->capacity];
+            __uint64_t state = __atomic_load_n(&entry.state, __ATOMIC_ACQUIRE);
+            if (state == Empty) {
+                return false;
+            }
+            if (state != Ready || entry.contentHash != contentHash || entry.configuration != configuration.key ||
+                memcmp(entry.content, page, PageSize) != 0) {
+                continue;
+            }
+            for (unsigned int slot = 0; slot < SlotsPerPage; slot++) {
+                __uint32_t executor = entry.slots[slot].executor;
+                if (executor != Absent && executor >= configuration.executors.size()) {
+                    return false; // Corrupt; the caller decodes the page itself
+                }
+            }
+            for (unsigned int slot = 0; slot < SlotsPerPage; slot++) {
+                const PersistedSlot& persisted = entry.slots[slot];
+                if (persisted.executor == Absent) {
+                    slots[slot] = {};
+                } else {
+                    slots[slot] = { configuration.executors[persisted.executor],
+                                    persisted.encoding, ends_block(persisted.encoding) };
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+
+    inline void Store(const Configuration& configuration, const char* page, const DecodedSlot<XLEN_t>* slots) {
+        if (header == nullptr) {
+            return;
+        }
+        const std::vector<DecodedInstruction<XLEN_t>>& executors = configuration.executors;
+        PersistedSlot persisted[SlotsPerPage];
+        for (unsigned int slot = 0; slot < SlotsPerPage; slot++) {
+            if (slots[slot].executor == nullptr) {
+                persisted[slot] = { Absent, 0 };
+                continue;
+            }
+            auto found = std::lower_bound(executors.begin(), executors.end(), slots[slot].executor,
+                                          std::less<DecodedInstruction<XLEN_t>>());
+            if (found == executors.end() || *found != slots[slot].executor) {
+                return; // Not one Configure found, so it has no index
+            }
+            persisted[slot] = { (__uint32_t)(found - executors.begin()), slots[slot].encoding };
+        }
+        __uint64_t contentHash = decode_cache_hash(page, PageSize);
+        for (unsigned int probe = 0; probe < Probes; probe++) {
+            Entry& entry = entries[(contentHash + probe) % header->capacity];
+            __uint64_t state = __atomic_load_n(&entry.state, __ATOMIC_ACQUIRE);
+            if (state == Ready && entry.contentHash == contentHash && entry.configuration == configuration.key &&
+                memcmp(entry.content, page, PageSize) == 0) {
+                return;
+            }
+            if (state != Empty ||
+                !__atomic_compare_exchange_n(&entry.state, &state, Writing, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                continue;
+            }
+            entry.contentHash = contentHash;
+            entry.configuration = configuration.key;
+            memcpy(entry.content, page, PageSize);
+            memcpy(entry.slots, persisted, sizeof(persisted));
+            __atomic_store_n(&entry.state, Ready, __ATOMIC_RELEASE);
+            return;
+        }
+    }
+
+};
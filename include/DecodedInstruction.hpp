@@ -18,3 +18,11 @@ struct Instruction {
     DecodedInstruction<XLEN_t> executionFunction;
     DisassemblyFunction<XLEN_t> disassemblyFunction;
 };
+
+// An instruction as a decode cache holds it, ready to run
+template<typename XLEN_t>
+struct DecodedSlot {
+    DecodedInstruction<XLEN_t> executor; // nullptr until decoded
+    __uint32_t encoding; // canonical_encoding of the fetched bits
+    bool endsBlock; // See ends_block
+};
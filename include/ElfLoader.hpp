@@ -0,0 +1,196 @@
+#pragma once
+
+/*
+ * Loads an ELF32 or ELF64 RISC-V executable into a RAMTransactor without
+ * copying it. The file is mapped read-only to parse it, and then every page of
+ * a PT_LOAD segment that lines up with a host page is mapped privately and
+ * copy-on-write straight over guest RAM (RAMTransactor::MapFile). Only the
+ * ragged first and last page of each segment are copied, and only bss is
+ * zeroed, so a payload's untouched pages are never read off the disk at all.
+ *
+ * Segments are placed by physical address (p_paddr), since that is what the
+ * RAMTransactor serves. The symbol table, if there is one, comes back sorted by
+ * address, for profilers and disassembly to label pcs with.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <RAMTransactor.hpp>
+
+#ifndef EM_RISCV
+#define EM_RISCV 243
+#endif
+
+enum class ElfLoadStatus {
+    Loaded,
+    CantOpen,
+    NotElf,
+    WrongClass,   // ELF64 file for a 32-bit hart
+    NotRiscV,
+    OutsideRAM    // A PT_LOAD segment doesn't fit in the RAMTransactor
+};
+
+template<typename XLEN_t>
+struct ElfSymbol {
+    std::string name;
+    XLEN_t address;
+    XLEN_t size;
+    unsigned char type; // STT_FUNC, STT_OBJECT, ...
+};
+
+template<typename XLEN_t>
+struct ElfImage {
+
+    ElfLoadStatus status = ElfLoadStatus::CantOpen;
+    XLEN_t entry = 0; // For HartState::Reset
+    std::vector<ElfSymbol<XLEN_t>> symbols;
+
+    // The symbol covering address, or failing that the nearest one below it.
+    inline const ElfSymbol<XLEN_t>* Lookup(XLEN_t address) const {
+        auto after = std::upper_bound(symbols.begin(), symbols.end(), address,
+            [](XLEN_t a, const ElfSymbol<XLEN_t>& s) { return a < s.address; });
+        return after == symbols.begin() ? nullptr : &*(after - 1);
+    }
+
+};
+
+template<typename XLEN_t, typename Ehdr, typename Phdr, typename Shdr, typename Sym>
+inline void load_elf_segments(ElfImage<XLEN_t>* image, const char* file, size_t fileSize,
+                              int fd, RAMTransactor<XLEN_t>* ram) {
+
+    const Ehdr* header = (const Ehdr*)file;
+    if (header->e_machine != EM_RISCV) {
+        image->status = ElfLoadStatus::NotRiscV;
+        return;
+    }
+    if (header->e_phoff + (size_t)header->e_phnum * sizeof(Phdr) > fileSize) {
+        image->status = ElfLoadStatus::NotElf;
+        return;
+    }
+
+    const Phdr* segments = (const Phdr*)(file + header->e_phoff);
+    for (unsigned int i = 0; i < header->e_phnum; i++) {
+        const Phdr& segment = segments[i];
+        if (segment.p_type != PT_LOAD || segment.p_memsz == 0) {
+            continue;
+        }
+        if (segment.p_filesz > segment.p_memsz || segment.p_offset + segment.p_filesz > fileSize) {
+            image->status = ElfLoadStatus::NotElf;
+            return;
+        }
+        XLEN_t address = segment.p_paddr;
+        if (address < ram->Base() || address - ram->Base() > ram->Size() ||
+            segment.p_memsz > ram->Size() - (address - ram->Base())) {
+            image->status = ElfLoadStatus::OutsideRAM;
+            return;
+        }
+
+        // Map the page-aligned middle of the file-backed part, if the file
+        // offset and guest address agree modulo the page size. The partial
+        // pages at either end may be shared with a neighbouring segment, so
+        // those get copied instead of mapped over.
+        XLEN_t fileSz = segment.p_filesz;
+        XLEN_t head = fileSz;
+        XLEN_t tail = fileSz;
+        if (((address - ram->Base()) & (4096 - 1)) == (segment.p_offset & (4096 - 1))) {
+            XLEN_t misalignment = (address - ram->Base()) & (4096 - 1);
+            XLEN_t mapStart = misalignment == 0 ? 0 : 4096 - misalignment;
+            XLEN_t mapEnd = mapStart + ((fileSz > mapStart ? fileSz - mapStart : 0) & ~(XLEN_t)(4096 - 1));
+            if (mapEnd > mapStart &&
+                ram->MapFile(address + mapStart, fd, segment.p_offset + mapStart, mapEnd - mapStart)) {
+                head = mapStart;
+                tail = mapEnd;
+            }
+        }
+        ram->Write(address, head, (char*)file + segment.p_offset);
+        ram->Write(address + tail, fileSz - tail, (char*)file + segment.p_offset + tail);
+
+        ram->Zero(address + fileSz, segment.p_memsz - fileSz);
+    }
+
+    image->entry = header->e_entry;
+    image->status = ElfLoadStatus::Loaded;
+
+    // Symbols are best-effort; a stripped or odd file still loads.
+    if (header->e_shoff == 0 || header->e_shoff + (size_t)header->e_shnum * sizeof(Shdr) > fileSize) {
+        return;
+    }
+    const Shdr* sections = (const Shdr*)(file + header->e_shoff);
+    for (unsigned int i = 0; i < header->e_shnum; i++) {
+        if (sections[i].sh_type != SHT_SYMTAB || sections[i].sh_link >= header->e_shnum) {
+            continue;
+        }
+        const Shdr& strtab = sections[sections[i].sh_link];
+        if (sections[i].sh_offset + sections[i].sh_size > fileSize ||
+            strtab.sh_offset + strtab.sh_size > fileSize) {
+            continue;
+        }
+        const Sym* symbols = (const Sym*)(file + sections[i].sh_offset);
+        size_t count = sections[i].sh_size / sizeof(Sym);
+        for (size_t s = 0; s < count; s++) {
+            unsigned char type = symbols[s].st_info & 0xf;
+            if (symbols[s].st_name == 0 || symbols[s].st_name >= strtab.sh_size ||
+                symbols[s].st_shndx == SHN_UNDEF || type == STT_SECTION || type == STT_FILE) {
+                continue;
+            }
+            const char* name = file + strtab.sh_offset + symbols[s].st_name;
+            image->symbols.push_back({
+                std::string(name, strnlen(name, strtab.sh_size - symbols[s].st_name)),
+                (XLEN_t)symbols[s].st_value, (XLEN_t)symbols[s].st_size, type });
+        }
+    }
+    std::sort(image->symbols.begin(), image->symbols.end(),
+        [](const ElfSymbol<XLEN_t>& a, const ElfSymbol<XLEN_t>& b) { return a.address < b.address; });
+}
+
+template<typename XLEN_t>
+inline ElfImage<XLEN_t> LoadElf(const char* path, RAMTransactor<XLEN_t>* ram) {
+
+    ElfImage<XLEN_t> image;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return image;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < EI_NIDENT) {
+        close(fd);
+        image.status = ElfLoadStatus::NotElf;
+        return image;
+    }
+    size_t fileSize = fileStat.st_size;
+    void* mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return image;
+    }
+    const char* file = (const char*)mapping;
+
+    image.status = ElfLoadStatus::NotElf;
+    if (memcmp(file, ELFMAG, SELFMAG) == 0 && file[EI_DATA] == ELFDATA2LSB) {
+        if (file[EI_CLASS] == ELFCLASS32 && fileSize >= sizeof(Elf32_Ehdr)) {
+            load_elf_segments<XLEN_t, Elf32_Ehdr, Elf32_Phdr, Elf32_Shdr, Elf32_Sym>(&image, file, fileSize, fd, ram);
+        } else if (file[EI_CLASS] == ELFCLASS64 && fileSize >= sizeof(Elf64_Ehdr)) {
+            if constexpr (sizeof(XLEN_t) >= sizeof(Elf64_Addr)) {
+                load_elf_segments<XLEN_t, Elf64_Ehdr, Elf64_Phdr, Elf64_Shdr, Elf64_Sym>(&image, file, fileSize, fd, ram);
+            } else {
+                image.status = ElfLoadStatus::WrongClass;
+            }
+        }
+    }
+
+    // Guest RAM holds its own references to the file pages it mapped
+    munmap(mapping, fileSize);
+    close(fd);
+    return image;
+}
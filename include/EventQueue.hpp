@@ -0,0 +1,115 @@
+#pragma once
+
+/*
+ * Simulated time, and the things due to happen at points in it. Each event
+ * source (a CLINT hart timer, say) registers once, and then schedules its next
+ * event whenever that changes; scheduling again replaces the old time. Sources
+ * are kept in a min-heap keyed on time, and stale heap entries are skipped
+ * lazily, so scheduling is O(log n) and finding the next event is O(1).
+ *
+ * The point is idling: when every hart is waiting for an interrupt, nothing can
+ * happen until the next event, so the client can jump time straight there
+ * (SkipToNextEvent) rather than spinning harts through their idle loops. If
+ * there is no next event, only the host can wake the guest up (with UART
+ * input, say), so the client should block on that instead.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+class EventQueue {
+
+public:
+
+    static constexpr __uint64_t Never = ~(__uint64_t)0;
+
+private:
+
+    struct Source {
+        std::function<void()> callback;
+        __uint64_t time;
+        __uint64_t generation;
+    };
+
+    struct Entry {
+        __uint64_t time;
+        __uint64_t generation;
+        unsigned int source;
+        bool operator>(const Entry& other) const { return time > other.time; }
+    };
+
+    __uint64_t now = 0;
+    std::vector<Source> sources;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+
+    inline void DropStale() {
+        while (!heap.empty() && heap.top().generation != sources[heap.top().source].generation) {
+            heap.pop();
+        }
+    }
+
+public:
+
+    // Returns the id to schedule the source's events by
+    inline unsigned int Register(std::function<void()> callback) {
+        sources.push_back({ callback, Never, 0 });
+        return sources.size() - 1;
+    }
+
+    inline void Schedule(unsigned int source, __uint64_t time) {
+        Source& s = sources[source];
+        s.generation++;
+        s.time = time;
+        if (time != Never) {
+            heap.push({ time, s.generation, source });
+        }
+    }
+
+    inline void Cancel(unsigned int source) {
+        Schedule(source, Never);
+    }
+
+    inline __uint64_t NextEventTime() {
+        DropStale();
+        return heap.empty() ? Never : heap.top().time;
+    }
+
+    // Moves time forward, running every event due by then in time order.
+    // Events can schedule more events; those run too if they're due.
+    inline void AdvanceTo(__uint64_t time) {
+        for (__uint64_t next = NextEventTime(); next != Never && next <= time; next = NextEventTime()) {
+            Entry entry = heap.top();
+            heap.pop();
+            Source& s = sources[entry.source];
+            if (entry.time > now) {
+                now = entry.time;
+            }
+            s.generation++;
+            s.time = Never;
+            s.callback();
+        }
+        if (time > now) {
+            now = time;
+        }
+    }
+
+    inline void Advance(__uint64_t ticks) {
+        AdvanceTo(now + ticks);
+    }
+
+    // Returns false, leaving time alone, if nothing is scheduled at all
+    inline bool SkipToNextEvent() {
+        __uint64_t next = NextEventTime();
+        if (next == Never) {
+            return false;
+        }
+        AdvanceTo(next);
+        return true;
+    }
+
+    inline __uint64_t Now() { return now; }
+    inline __uint64_t EventTime(unsigned int source) { return sources[source].time; }
+
+};
@@ -0,0 +1,362 @@
+#pragma once
+
+/*
+ * Fast-memory mode. FastMemory reserves one host address window with guest
+ * address 0 at its start, maps RAM into it at the RAM's base address, and
+ * leaves the rest of the window (plus a guard region past the end) PROT_NONE.
+ * The fast load, store and AMO executors below then access guest memory as
+ * plain host memory at window + address: no virtual call, and no trap cause or
+ * transfer size to check afterwards. On RV32 the window covers all 4 GiB, so
+ * there is no check at all; on RV64 one compare against the window size sends
+ * far-away addresses to the slow path.
+ *
+ * Anything that isn't RAM - unmapped holes, devices, the end of RAM - takes a
+ * host SIGSEGV. The handler jumps back out to FastMemory::Run, which re-runs
+ * the faulting instruction with its ordinary executor. The window is armed
+ * only across each fast access; other faults go to the previously installed
+ * handler. The fast executors don't touch the hart until their access has
+ * succeeded, so the re-run starts from the same state, and the ordinary
+ * Transactor path works out the right access fault (with mtval and the pc set
+ * as usual) or carries out the device access.
+ *
+ * The window is guest *physical* memory, so the fast executors are only right
+ * while the hart isn't translating; clients should decode with them only in
+ * M-mode or with paging off. Run's body is unwound by siglongjmp on a fault, so
+ * it must not hold anything that needs destroying, and must pick up from the
+ * HartState when it's re-entered.
+ */
+
+#include <atomic>
+#include <csetjmp>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include <RiscV.hpp>
+#include <HartState.hpp>
+#include <Instructions.hpp>
+#include <RAMTransactor.hpp>
+#include <Transactor.hpp>
+
+// What the current thread's fast executor was doing, for the SIGSEGV handler
+// and Run to unwind and retry it. Kept trivial so it needs no TLS guard.
+struct FastMemoryFault {
+    sigjmp_buf jump;
+    char* window;
+    size_t windowSize;
+    bool armed;
+    __uint32_t encoding;
+    void* state;
+    void* retry; // The slow executor for the instruction
+};
+
+inline thread_local FastMemoryFault fastMemoryFault;
+inline struct sigaction previousSegvAction;
+
+inline void fast_memory_segv_handler(int sig, siginfo_t* info, void* context) {
+    FastMemoryFault& fault = fastMemoryFault;
+    char* address = (char*)info->si_addr;
+    if (fault.armed && address >= fault.window && address < fault.window + fault.windowSize) {
+        fault.armed = false;
+        siglongjmp(fault.jump, 1);
+    }
+    // Not a guest access; hand it to whatever was installed before us
+    if (previousSegvAction.sa_flags & SA_SIGINFO) {
+        previousSegvAction.sa_sigaction(sig, info, context);
+    } else if (previousSegvAction.sa_handler != SIG_DFL && previousSegvAction.sa_handler != SIG_IGN) {
+        previousSegvAction.sa_handler(sig);
+    } else {
+        signal(sig, SIG_DFL); // Returning re-runs the access and dies as usual
+    }
+}
+
+template<typename XLEN_t>
+class FastMemory final : public Transactor<XLEN_t> {
+
+private:
+
+    static constexpr size_t GuardSize = 64 * 1024;
+    static constexpr size_t WindowAlignment = 2 * 1024 * 1024; // For explicit huge pages
+
+    char* reservation;
+    size_t reservationSize;
+    char* window;
+    size_t windowSize; // Addresses below this are served from the window
+    RAMTransactor<XLEN_t> ram;
+    Transactor<XLEN_t>* devices;
+
+    static inline char* Reserve(size_t windowSize, char** reservation, size_t* reservationSize) {
+        *reservationSize = windowSize + GuardSize + WindowAlignment;
+        void* mapping = mmap(nullptr, *reservationSize, PROT_NONE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mapping == MAP_FAILED) {
+            *reservation = nullptr;
+            return nullptr;
+        }
+        *reservation = (char*)mapping;
+        return (char*)(((uintptr_t)mapping + WindowAlignment - 1) & ~(uintptr_t)(WindowAlignment - 1));
+    }
+
+    static inline size_t WindowSizeFor(XLEN_t ramBase, XLEN_t ramSize) {
+        if constexpr (sizeof(XLEN_t) == 4) {
+            return (size_t)1 << 32;
+        } else {
+            return (size_t)ramBase + ramSize;
+        }
+    }
+
+public:
+
+    // Addresses outside RAM go to devices, or fault if there are none.
+    FastMemory(XLEN_t ramBase, XLEN_t ramSize, Transactor<XLEN_t>* devices = nullptr,
+               HugePages hugePages = HugePages::None)
+        : window(Reserve(WindowSizeFor(ramBase, ramSize), &reservation, &reservationSize)),
+          windowSize(window == nullptr ? 0 : WindowSizeFor(ramBase, ramSize)),
+          ram(ramBase, window == nullptr ? 0 : ramSize, hugePages, window == nullptr ? nullptr : window + ramBase),
+          devices(devices) {
+        static std::once_flag handlerInstalled;
+        std::call_once(handlerInstalled, [] {
+            struct sigaction action = {};
+            action.sa_sigaction = fast_memory_segv_handler;
+            action.sa_flags = SA_SIGINFO | SA_NODEFER | SA_ONSTACK;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGSEGV, &action, &previousSegvAction);
+        });
+    }
+
+    // RAM unmaps its own part of the window
+    ~FastMemory() {
+        if (reservation == nullptr) {
+            return;
+        }
+        char* ramStart = window + ram.Base();
+        char* ramEnd = ramStart + ram.Size();
+        if (ram.Host() == nullptr) {
+            ramStart = ramEnd = reservation;
+        }
+        munmap(reservation, ramStart - reservation);
+        munmap(ramEnd, reservation + reservationSize - ramEnd);
+    }
+
+    FastMemory(const FastMemory&) = delete;
+    FastMemory& operator=(const FastMemory&) = delete;
+
+    // The slow path, for ordinary executors and for retries after a fault
+    inline Transaction<XLEN_t> Read(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        if (devices == nullptr || startAddress - ram.Base() < ram.Size()) {
+            return ram.Read(startAddress, size, buf);
+        }
+        return devices->Read(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Write(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        if (devices == nullptr || startAddress - ram.Base() < ram.Size()) {
+            return ram.Write(startAddress, size, buf);
+        }
+        return devices->Write(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Fetch(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        if (devices == nullptr || startAddress - ram.Base() < ram.Size()) {
+            return ram.Fetch(startAddress, size, buf);
+        }
+        return devices->Fetch(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> CompareAndSwap(XLEN_t startAddress, XLEN_t size, char* expected, char* desired) override {
+        if (devices == nullptr || startAddress - ram.Base() < ram.Size()) {
+            return ram.CompareAndSwap(startAddress, size, expected, desired);
+        }
+        return devices->CompareAndSwap(startAddress, size, expected, desired);
+    }
+
+    // Where a fast executor accesses address, or nullptr for the slow path.
+    // Past the end of RAM this still points into the window, and faults.
+    inline char* HostAddress(XLEN_t address) {
+        if constexpr (sizeof(XLEN_t) == 4) {
+            return window + address;
+        } else {
+            return address < windowSize ? window + address : nullptr;
+        }
+    }
+
+    // Runs body (usually the client's whole run loop) with fast-memory faults
+    // handled. Returns when body does. Outside Run the window is unknown to the
+    // handler, so any fault in it goes to the previous handler.
+    template<typename Body>
+    inline void Run(Body body) {
+        FastMemoryFault& fault = fastMemoryFault;
+        fault.armed = false;
+        fault.window = window;
+        fault.windowSize = reservationSize - (window - reservation);
+        while (true) {
+            if (sigsetjmp(fault.jump, 0) == 0) {
+                body();
+                break;
+            }
+            DecodedInstruction<XLEN_t> retry = (DecodedInstruction<XLEN_t>)fault.retry;
+            HartState<XLEN_t>* state = (HartState<XLEN_t>*)fault.state;
+            fault.retry = nullptr;
+            fault.state = nullptr;
+            retry(fault.encoding, state, this);
+        }
+        fault.window = nullptr;
+        fault.windowSize = 0;
+    }
+
+    inline RAMTransactor<XLEN_t>* RAM() { return &ram; }
+    inline char* Window() { return window; }
+
+};
+
+// Arms the window for the access that follows, noting down how to redo the
+// instruction if it faults. Only that access is covered: anything else that
+// faults in the window, such as the client's own code, goes to the previous
+// handler rather than re-running an access that already completed.
+template<typename XLEN_t, DecodedInstruction<XLEN_t> slow>
+inline void fast_memory_retry_with(__uint32_t encoding, HartState<XLEN_t> *state) {
+    FastMemoryFault& fault = fastMemoryFault;
+    fault.encoding = encoding;
+    fault.state = state;
+    fault.retry = (void*)slow;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    fault.armed = true;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+// Disarms the window once the access is done.
+inline void fast_memory_access_done() {
+    FastMemoryFault& fault = fastMemoryFault;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    fault.armed = false;
+    fault.retry = nullptr;
+    fault.state = nullptr;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+template<typename XLEN_t, typename MEM_TYPE_t, bool ignore_immediate>
+inline void ex_load_fast(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    constexpr DecodedInstruction<XLEN_t> slow = ex_load_generic<XLEN_t, MEM_TYPE_t, ignore_immediate>;
+    if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
+        slow(encoding, state, mem);
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __int32_t imm = 0;
+    if constexpr (!ignore_immediate)
+        imm = swizzle<__uint32_t, ExtendBits::Sign, I_IMM>(encoding);
+    char* host = static_cast<FastMemory<XLEN_t>*>(mem)->HostAddress(state->regs[rs1] + imm);
+    if (host == nullptr) [[unlikely]] {
+        slow(encoding, state, mem);
+        return;
+    }
+    fast_memory_retry_with<XLEN_t, slow>(encoding, state);
+    MEM_TYPE_t read_value;
+    memcpy(&read_value, host, sizeof(MEM_TYPE_t));
+    fast_memory_access_done();
+    state->regs[rd] = read_value;
+    state->regs[0] = 0;
+    state->pc += inst_length(encoding);
+}
+
+template<typename XLEN_t, typename MEM_TYPE_t>
+inline void ex_store_fast(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    constexpr DecodedInstruction<XLEN_t> slow = ex_store_generic<XLEN_t, MEM_TYPE_t>;
+    if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
+        slow(encoding, state, mem);
+        return;
+    }
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    __int32_t imm = swizzle<__uint32_t, S_IMM>(encoding);
+    char* host = static_cast<FastMemory<XLEN_t>*>(mem)->HostAddress(state->regs[rs1] + imm);
+    if (host == nullptr) [[unlikely]] {
+        slow(encoding, state, mem);
+        return;
+    }
+    fast_memory_retry_with<XLEN_t, slow>(encoding, state);
+    MEM_TYPE_t write_value = state->regs[rs2] & (MEM_TYPE_t)~0;
+    memcpy(host, &write_value, sizeof(MEM_TYPE_t));
+    fast_memory_access_done();
+    state->pc += inst_length(encoding);
+}
+
+// Both halves of the AMO happen before rd is written, so a fault on either
+// leaves the hart untouched. Like the slow path, this isn't atomic across
+// host threads yet.
+template<typename XLEN_t, typename MEM_TYPE_t, typename Operation>
+inline void ex_amo_fast(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    constexpr DecodedInstruction<XLEN_t> slow = ex_amo_generic<XLEN_t, MEM_TYPE_t, Operation>;
+    if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
+        slow(encoding, state, mem);
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    char* host = static_cast<FastMemory<XLEN_t>*>(mem)->HostAddress(state->regs[rs1]);
+    if (host == nullptr) [[unlikely]] {
+        slow(encoding, state, mem);
+        return;
+    }
+    fast_memory_retry_with<XLEN_t, slow>(encoding, state);
+    MEM_TYPE_t mem_value;
+    memcpy(&mem_value, host, sizeof(MEM_TYPE_t));
+    Operation operation;
+    MEM_TYPE_t new_value = operation(mem_value, state->regs[rs2]);
+    memcpy(host, &new_value, sizeof(MEM_TYPE_t));
+    fast_memory_access_done();
+    state->regs[rd] = mem_value;
+    state->regs[0] = 0;
+    state->pc += 4;
+}
+
+// Swaps a decoded instruction's executor for its fast-memory variant, if it
+// has one. Clients apply this on top of decode_instruction while the hart's
+// memory accesses are untranslated, and must then pass a FastMemory as the
+// Transactor.
+template<typename XLEN_t>
+inline Instruction<XLEN_t> with_fast_memory(Instruction<XLEN_t> decoded) {
+    static const std::pair<DecodedInstruction<XLEN_t>, DecodedInstruction<XLEN_t>> variants[] = {
+        { ex_load_generic<XLEN_t, __int8_t, false>,   ex_load_fast<XLEN_t, __int8_t, false> },
+        { ex_load_generic<XLEN_t, __int16_t, false>,  ex_load_fast<XLEN_t, __int16_t, false> },
+        { ex_load_generic<XLEN_t, __int32_t, false>,  ex_load_fast<XLEN_t, __int32_t, false> },
+        { ex_load_generic<XLEN_t, __int64_t, false>,  ex_load_fast<XLEN_t, __int64_t, false> },
+        { ex_load_generic<XLEN_t, __uint8_t, false>,  ex_load_fast<XLEN_t, __uint8_t, false> },
+        { ex_load_generic<XLEN_t, __uint16_t, false>, ex_load_fast<XLEN_t, __uint16_t, false> },
+        { ex_load_generic<XLEN_t, __uint32_t, false>, ex_load_fast<XLEN_t, __uint32_t, false> },
+        { ex_store_generic<XLEN_t, __uint8_t>,  ex_store_fast<XLEN_t, __uint8_t> },
+        { ex_store_generic<XLEN_t, __uint16_t>, ex_store_fast<XLEN_t, __uint16_t> },
+        { ex_store_generic<XLEN_t, __uint32_t>, ex_store_fast<XLEN_t, __uint32_t> },
+        { ex_store_generic<XLEN_t, __uint64_t>, ex_store_fast<XLEN_t, __uint64_t> },
+        { ex_amo_generic<XLEN_t, __uint32_t, std::plus<XLEN_t>>,    ex_amo_fast<XLEN_t, __uint32_t, std::plus<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint64_t, std::plus<XLEN_t>>,    ex_amo_fast<XLEN_t, __uint64_t, std::plus<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint32_t, lhs<XLEN_t>>,          ex_amo_fast<XLEN_t, __uint32_t, lhs<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint64_t, lhs<XLEN_t>>,          ex_amo_fast<XLEN_t, __uint64_t, lhs<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint32_t, std::bit_xor<XLEN_t>>, ex_amo_fast<XLEN_t, __uint32_t, std::bit_xor<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint64_t, std::bit_xor<XLEN_t>>, ex_amo_fast<XLEN_t, __uint64_t, std::bit_xor<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint32_t, std::bit_or<XLEN_t>>,  ex_amo_fast<XLEN_t, __uint32_t, std::bit_or<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint64_t, std::bit_or<XLEN_t>>,  ex_amo_fast<XLEN_t, __uint64_t, std::bit_or<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint32_t, std::bit_and<XLEN_t>>, ex_amo_fast<XLEN_t, __uint32_t, std::bit_and<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint64_t, std::bit_and<XLEN_t>>, ex_amo_fast<XLEN_t, __uint64_t, std::bit_and<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __int32_t, min<XLEN_t>>,           ex_amo_fast<XLEN_t, __int32_t, min<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __int64_t, min<XLEN_t>>,           ex_amo_fast<XLEN_t, __int64_t, min<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __int32_t, max<XLEN_t>>,           ex_amo_fast<XLEN_t, __int32_t, max<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __int64_t, max<XLEN_t>>,           ex_amo_fast<XLEN_t, __int64_t, max<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint32_t, min<XLEN_t>>,          ex_amo_fast<XLEN_t, __uint32_t, min<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint64_t, min<XLEN_t>>,          ex_amo_fast<XLEN_t, __uint64_t, min<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint32_t, max<XLEN_t>>,          ex_amo_fast<XLEN_t, __uint32_t, max<XLEN_t>> },
+        { ex_amo_generic<XLEN_t, __uint64_t, max<XLEN_t>>,          ex_amo_fast<XLEN_t, __uint64_t, max<XLEN_t>> },
+    };
+    for (const auto& [slow, fast] : variants) {
+        if (decoded.executionFunction == slow) {
+            return { fast, decoded.disassemblyFunction };
+        }
+    }
+    return decoded;
+}
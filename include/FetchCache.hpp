@@ -0,0 +1,162 @@
+#pragma once
+
+/*
+ * Instruction fetch for a client's run loop, caching the host pointer to the
+ * page the pc is on. A Translation already says which run of virtual addresses
+ * it holds for (virtPageStart to validThrough); clamped to where that run sits
+ * inside RAM, it's a stretch of host memory that sequential fetches can just
+ * read from, without translating or going through a Transactor. Fetches from
+ * outside RAM (a boot ROM on a bus, say) take the slow path every time.
+ *
+ * The hart's PMP is checked when the run is filled, and the run is also cut
+ * down to the PMP region the pc is in, so it never covers memory the hart may
+ * not execute. RAM doesn't watch fetches, so reading it directly skips nothing
+ * that mem->Fetch would have done for RAM.
+ *
+ * A 32-bit instruction may straddle a page boundary, in which case its second
+ * half is fetched (and translated) on its own, and faults with its own
+ * address. The cached page stays valid until the client reports something that
+ * could change translation or PMP: a satp, pmpcfg or pmpaddr write, a
+ * privilege change or a fence.
+ */
+
+#include <cstdint>
+#include <cstring>
+
+#include <RiscV.hpp>
+#include <HartState.hpp>
+#include <PMP.hpp>
+#include <RAMTransactor.hpp>
+#include <Transactor.hpp>
+#include <Translator.hpp>
+
+template<typename XLEN_t>
+class FetchCache {
+
+private:
+
+    HartState<XLEN_t>* state;
+    Translator<XLEN_t>* translator;
+    RAMTransactor<XLEN_t>* ram;
+    Transactor<XLEN_t>* mem;
+
+    // The cached run is [first, first + size); a four-byte read starting at pc
+    // is inside it if pc - first < fastSpan (size - 3, or 0 if empty).
+    XLEN_t first = 0;
+    XLEN_t size = 0;
+    XLEN_t fastSpan = 0;
+    const char* host = nullptr;
+
+    // Translates address and caches what it can of its page. Returns the trap
+    // from translation, PMP, or fetching two bytes outside RAM.
+    inline RISCV::TrapCause FetchHalf(XLEN_t address, __uint16_t* half) {
+        if (address - first < size) [[likely]] {
+            memcpy(half, host + (address - first), sizeof(__uint16_t));
+            return RISCV::TrapCause::NONE;
+        }
+        Translation<XLEN_t> translation = translator->TranslateFetch(address);
+        if (translation.generatedTrap != RISCV::TrapCause::NONE) {
+            return translation.generatedTrap;
+        }
+        if (!state->pmp.template Allows<IOVerb::Fetch>(translation.translated, sizeof(__uint16_t), state->privilegeMode)) {
+            Invalidate();
+            return RISCV::TrapCause::INSTRUCTION_ACCESS_FAULT;
+        }
+        const char* hostAddress = ram->HostPointer(translation.translated);
+        if (hostAddress == nullptr) {
+            Invalidate();
+            Transaction<XLEN_t> transaction = mem->Fetch(translation.translated, sizeof(__uint16_t), (char*)half);
+            if (transaction.trapCause == RISCV::TrapCause::NONE && transaction.transferredSize != sizeof(__uint16_t)) {
+                return RISCV::TrapCause::INSTRUCTION_ACCESS_FAULT;
+            }
+            return transaction.trapCause;
+        }
+        // The translated run, cut down to the part that's backed by RAM and
+        // inside the PMP region
+        XLEN_t ramBefore = translation.translated - ram->Base();
+        XLEN_t ramAfter = ram->Size() - 1 - ramBefore;
+        __uint64_t regionStart, regionEnd;
+        state->pmp.Extent(translation.translated, state->privilegeMode, &regionStart, &regionEnd);
+        __uint64_t pmpBefore = translation.translated - regionStart;
+        __uint64_t pmpAfter = regionEnd - 1 - translation.translated;
+        XLEN_t before = address - translation.virtPageStart;
+        XLEN_t after = translation.validThrough - address;
+        before = before < ramBefore ? before : ramBefore;
+        after = after < ramAfter ? after : ramAfter;
+        before = before < pmpBefore ? before : pmpBefore;
+        after = after < pmpAfter ? after : pmpAfter;
+        first = address - before;
+        size = before + after + 1;
+        fastSpan = size < 4 ? 0 : size - 3;
+        host = hostAddress - before;
+        memcpy(half, hostAddress, sizeof(__uint16_t));
+        return RISCV::TrapCause::NONE;
+    }
+
+public:
+
+    // mem serves fetches from outside ram; state's PMP and privilege govern
+    // fetches from inside it
+    FetchCache(HartState<XLEN_t>* state, Translator<XLEN_t>* translator, RAMTransactor<XLEN_t>* ram, Transactor<XLEN_t>* mem)
+        : state(state), translator(translator), ram(ram), mem(mem) {
+    }
+
+    // Fetches the encoding at pc. On a trap, faultAddress is the address of
+    // the half of the instruction that couldn't be fetched, for mtval.
+    inline RISCV::TrapCause Fetch(XLEN_t pc, __uint32_t* encoding, XLEN_t* faultAddress) {
+        if (pc - first < fastSpan) [[likely]] {
+            memcpy(encoding, host + (pc - first), sizeof(__uint32_t));
+            if ((*encoding & 0b11) != 0b11) {
+                *encoding &= 0xffff;
+            }
+            return RISCV::TrapCause::NONE;
+        }
+        __uint16_t low, high;
+        RISCV::TrapCause cause = FetchHalf(pc, &low);
+        if (cause != RISCV::TrapCause::NONE) {
+            *faultAddress = pc;
+            return cause;
+        }
+        if ((low & 0b11) != 0b11) {
+            *encoding = low;
+            return RISCV::TrapCause::NONE;
+        }
+        cause = FetchHalf(pc + 2, &high);
+        if (cause != RISCV::TrapCause::NONE) {
+            *faultAddress = pc + 2;
+            return cause;
+        }
+        *encoding = ((__uint32_t)high << 16) | low;
+        return RISCV::TrapCause::NONE;
+    }
+
+    // For when the hart changes translation modes, e.g. from MMUSet::Fetch()
+    inline void SetTranslator(Translator<XLEN_t>* newTranslator) {
+        translator = newTranslator;
+        Invalidate();
+    }
+
+    inline void Invalidate() {
+        first = 0;
+        size = 0;
+        fastSpan = 0;
+        host = nullptr;
+    }
+
+    // Clients pass on the hart's callbacks; anything that can change what the
+    // pc translates to, or whether it may be executed, drops the cached page.
+    inline void Notify(HartCallbackArgument argument) {
+        switch (argument) {
+            case HartCallbackArgument::ChangedPrivilege:
+            case HartCallbackArgument::ChangedSATP:
+            case HartCallbackArgument::ChangedPMP:
+            case HartCallbackArgument::RequestedVMfence:
+            case HartCallbackArgument::RequestedIfence:
+                Invalidate();
+                break;
+            default:
+                break;
+        }
+    }
+
+};
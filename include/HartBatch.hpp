@@ -0,0 +1,514 @@
+#pragma once
+
+/*
+ * Batch mode: K independent harts stepped in lockstep, for fuzzing and
+ * regression farms that run the same program over and over on different data.
+ * The batch keeps the harts' integer registers and pcs structure-of-arrays, one
+ * host vector of K lanes per register, using GCC/Clang vector extensions like
+ * VectorKernels does, so one batch executor runs an instruction for every lane
+ * at once with AVX-512, AVX2 or SSE2 (or NEON) depending on the build.
+ *
+ * Each step picks the lowest pc among the running lanes and executes the
+ * instruction there for every lane that's at that pc with the same encoding;
+ * the rest wait. Lanes that branch apart are so split into groups, and taking
+ * the lowest pc first lets the groups catch each other up where the paths meet
+ * again, as at the end of an if/else or a loop.
+ *
+ * Batch executors cover the common integer ALU ops, jumps, branches, loads and
+ * stores. Anything else, and any load or store that isn't to its lane's RAM,
+ * runs the ordinary executor on that lane's HartState, so traps, CSRs and
+ * callbacks all work as usual; only slower. Those lanes' registers are written
+ * back to their HartState first and picked up again after. Executors that the
+ * batch has no vector form for include slt, sra and shifts by register; those
+ * give the same results either way, just on the scalar path.
+ *
+ * Lanes must not be translating, since loads, stores and fetches go straight
+ * to their RAMTransactor, and the batch doesn't take interrupts: clients that
+ * need them Detach the lane and run it on their own loop.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include <RiscV.hpp>
+#include <DecodedInstruction.hpp>
+#include <HartState.hpp>
+#include <ISA.hpp>
+#include <Instructions.hpp>
+#include <RAMTransactor.hpp>
+#include <RiscVDecoder.hpp>
+#include <Transactor.hpp>
+
+// K lanes of T, one host vector (or a few, for large K)
+template<typename T, unsigned int K>
+struct BatchVector {
+    typedef T type __attribute__((vector_size(K * sizeof(T))));
+};
+
+template<typename XLEN_t, unsigned int K, typename ISA = DefaultISA>
+class HartBatch {
+
+    static_assert(K != 0 && K <= 64 && (K & (K - 1)) == 0, "K is a power of two, at most 64");
+
+public:
+
+    typedef std::make_signed_t<XLEN_t> SXLEN_t;
+    typedef typename BatchVector<XLEN_t, K>::type Lanes;
+    typedef typename BatchVector<SXLEN_t, K>::type LaneMask;
+
+    // The lanes' registers, valid between Syncs while they're attached
+    Lanes regs[RISCV::NumRegs] = {};
+    Lanes pc = {};
+
+private:
+
+    typedef void (*BatchExecutor)(__uint32_t encoding, HartBatch* batch, const LaneMask& mask);
+
+    struct Lane {
+        HartState<XLEN_t>* state = nullptr;
+        RAMTransactor<XLEN_t>* ram = nullptr;
+        Transactor<XLEN_t>* mem = nullptr;
+    };
+
+    struct Decoded {
+        BatchExecutor batch; // nullptr if the instruction has no batch form
+        DecodedInstruction<XLEN_t> scalar;
+        __uint32_t canonical;
+    };
+
+    // The last instruction seen at each of a few pcs, to skip the hash lookup
+    struct Recent {
+        XLEN_t pc;
+        __uint32_t encoding;
+        const Decoded* decoded;
+    };
+    static constexpr unsigned int RecentSize = 256;
+
+    Lane lanes[K];
+    __uint64_t attached = 0;
+    LaneMask running = {};
+    unsigned int runningCount = 0;
+    bool sharedRAM = true;
+    __uint32_t extensionsVector;
+    RISCV::XlenMode mxlen;
+    std::unordered_map<__uint32_t, Decoded> decoded;
+    Recent recent[RecentSize] = {};
+
+    inline void Spill(unsigned int lane) {
+        HartState<XLEN_t>* state = lanes[lane].state;
+        for (unsigned int reg = 0; reg < RISCV::NumRegs; reg++) {
+            state->regs[reg] = regs[reg][lane];
+        }
+        state->pc = pc[lane];
+    }
+
+    inline void Fill(unsigned int lane) {
+        HartState<XLEN_t>* state = lanes[lane].state;
+        for (unsigned int reg = 0; reg < RISCV::NumRegs; reg++) {
+            regs[reg][lane] = state->regs[reg];
+        }
+        pc[lane] = state->pc;
+    }
+
+    // Runs an ordinary executor for one lane
+    inline void Scalar(unsigned int lane, DecodedInstruction<XLEN_t> executor, __uint32_t encoding) {
+        Spill(lane);
+        executor(encoding, lanes[lane].state, lanes[lane].mem);
+        // Lanes share the thread's host FP flags
+        lanes[lane].state->FlushFloatFlags();
+        Fill(lane);
+    }
+
+    // Fetches the raw encoding at address from a lane's RAM, or its Transactor
+    // for anything outside it.
+    inline RISCV::TrapCause Fetch(unsigned int lane, XLEN_t address, __uint32_t* encoding) {
+        const char* host = lanes[lane].ram->HostPointer(address);
+        const char* end = lanes[lane].ram->HostPointer(address + 3);
+        if (host != nullptr && end == host + 3) [[likely]] {
+            memcpy(encoding, host, sizeof(*encoding));
+            if ((*encoding & 0b11) != 0b11) {
+                *encoding &= 0xffff;
+            }
+            return RISCV::TrapCause::NONE;
+        }
+        __uint16_t half;
+        for (unsigned int part = 0; part < 2; part++) {
+            Transaction<XLEN_t> transaction = lanes[lane].mem->Fetch(address + part * 2, sizeof(half), (char*)&half);
+            if (transaction.trapCause != RISCV::TrapCause::NONE) {
+                return transaction.trapCause;
+            }
+            if (transaction.transferredSize != sizeof(half)) {
+                return RISCV::TrapCause::INSTRUCTION_ACCESS_FAULT;
+            }
+            *encoding = part == 0 ? half : *encoding | (__uint32_t)half << 16;
+            if ((half & 0b11) != 0b11 && part == 0) {
+                break;
+            }
+        }
+        return RISCV::TrapCause::NONE;
+    }
+
+    inline const Decoded& Decode(__uint32_t encoding) {
+        auto found = decoded.find(encoding);
+        if (found != decoded.end()) [[likely]] {
+            return found->second;
+        }
+        Instruction<XLEN_t> instruction;
+        if constexpr (ISA::Fixed) {
+            instruction = decode_instruction<XLEN_t, ISA>(encoding, extensionsVector);
+        } else {
+            instruction = decode_instruction<XLEN_t>(encoding, extensionsVector, mxlen);
+        }
+        Decoded entry = { Vectorize(instruction.executionFunction), instruction.executionFunction,
+                          canonical_encoding(encoding, mxlen) };
+        return decoded.emplace(encoding, entry).first->second;
+    }
+
+    inline const Decoded& Lookup(XLEN_t address, __uint32_t encoding) {
+        Recent& entry = recent[(address >> 1) & (RecentSize - 1)];
+        if (entry.decoded == nullptr || entry.pc != address || entry.encoding != encoding) [[unlikely]] {
+            entry = { address, encoding, &Decode(encoding) };
+        }
+        return *entry.decoded;
+    }
+
+    inline void CheckSharedRAM() {
+        sharedRAM = true;
+        RAMTransactor<XLEN_t>* first = nullptr;
+        for (unsigned int lane = 0; lane < K; lane++) {
+            if (attached & ((__uint64_t)1 << lane)) {
+                first = first != nullptr ? first : lanes[lane].ram;
+                sharedRAM = sharedRAM && lanes[lane].ram == first;
+            }
+        }
+    }
+
+    // A lane that's fetched something other than its group's instruction, or
+    // can't fetch at all, steps on its own.
+    inline void Step(unsigned int lane, XLEN_t address, RISCV::TrapCause cause, __uint32_t encoding) {
+        if (cause != RISCV::TrapCause::NONE) {
+            Spill(lane);
+            lanes[lane].state->RaiseException(cause, address);
+            Fill(lane);
+            return;
+        }
+        const Decoded& instruction = Decode(encoding);
+        Scalar(lane, instruction.scalar, instruction.canonical);
+    }
+
+    static inline void Write(HartBatch* batch, __uint32_t rd, const LaneMask& mask, const Lanes& value) {
+        batch->regs[rd] = mask ? value : batch->regs[rd];
+        batch->regs[0] = Lanes{};
+    }
+
+    static inline void Advance(HartBatch* batch, const LaneMask& mask, __uint32_t encoding) {
+        batch->pc = mask ? batch->pc + (XLEN_t)inst_length(encoding) : batch->pc;
+    }
+
+    // Operation is std::plus<> and friends, which apply to host vectors as
+    // they are; comparisons give -1 per true lane, so are masked down to 1.
+    template<typename Operation, bool rhs_immediate>
+    static inline void ExOp(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+        __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+        __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+        __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, I_IMM>(encoding);
+        Lanes rhs = rhs_immediate ? (Lanes{} + (XLEN_t)imm) : batch->regs[rs2];
+        Operation operation;
+        Lanes result = (Lanes)operation(batch->regs[rs1], rhs);
+        if constexpr (std::is_same_v<Operation, std::less<>>) {
+            result &= 1;
+        }
+        Write(batch, rd, mask, result);
+        Advance(batch, mask, encoding);
+    }
+
+    // Shift immediates are in range for any encoding that decodes as one
+    template<bool left>
+    static inline void ExShiftImmediate(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+        __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+        __uint32_t shamt = swizzle<__uint32_t, ExtendBits::Zero, I_IMM>(encoding) & (sizeof(XLEN_t)*8 - 1);
+        Write(batch, rd, mask, left ? batch->regs[rs1] << shamt : batch->regs[rs1] >> shamt);
+        Advance(batch, mask, encoding);
+    }
+
+    template<bool add_pc>
+    static inline void ExUpperImmediate(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+        __uint32_t imm = swizzle<__uint32_t, U_IMM>(encoding);
+        Write(batch, rd, mask, (add_pc ? batch->pc : Lanes{}) + (XLEN_t)imm);
+        Advance(batch, mask, encoding);
+    }
+
+    static inline void ExJal(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+        __int32_t imm = swizzle<__uint32_t, J_IMM>(encoding);
+        Lanes target = batch->pc + (XLEN_t)imm;
+        Write(batch, rd, mask, batch->pc + (XLEN_t)inst_length(encoding));
+        batch->pc = mask ? target : batch->pc;
+    }
+
+    static inline void ExJalr(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+        __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+        SXLEN_t imm = (__int32_t)swizzle<__uint32_t, ExtendBits::Sign, I_IMM>(encoding);
+        Lanes target = (batch->regs[rs1] + (XLEN_t)imm) & ~(XLEN_t)1;
+        Write(batch, rd, mask, batch->pc + (XLEN_t)inst_length(encoding));
+        batch->pc = mask ? target : batch->pc;
+    }
+
+    template<typename Comparison, bool is_signed>
+    static inline void ExBranch(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+        __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+        __int32_t imm = swizzle<__uint32_t, B_IMM>(encoding);
+        Comparison compare;
+        LaneMask taken;
+        if constexpr (is_signed) {
+            taken = compare((LaneMask)batch->regs[rs1], (LaneMask)batch->regs[rs2]);
+        } else {
+            taken = compare(batch->regs[rs1], batch->regs[rs2]);
+        }
+        Lanes offset = taken ? (Lanes{} + (XLEN_t)imm) : (Lanes{} + (XLEN_t)inst_length(encoding));
+        batch->pc = mask ? batch->pc + offset : batch->pc;
+    }
+
+    // Addresses are computed for the whole group; the accesses themselves are
+    // one RAMTransactor call per lane, which keeps its code and watch tracking.
+    template<typename MEM_TYPE_t>
+    static inline void ExLoad(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+        __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+        __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, I_IMM>(encoding);
+        Lanes addresses = batch->regs[rs1] + (XLEN_t)imm;
+        Lanes values = {};
+        LaneMask loaded = mask;
+        for (unsigned int lane = 0; lane < K; lane++) {
+            if (!mask[lane]) {
+                continue;
+            }
+            MEM_TYPE_t value;
+            Transaction<XLEN_t> transaction = batch->lanes[lane].ram->Read(addresses[lane], sizeof(value), (char*)&value);
+            if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(value)) [[unlikely]] {
+                loaded[lane] = 0;
+                continue;
+            }
+            values[lane] = (XLEN_t)value;
+        }
+        Write(batch, rd, loaded, values);
+        Advance(batch, loaded, encoding);
+        Retry<ex_load_generic<XLEN_t, MEM_TYPE_t, false>>(encoding, batch, mask & ~loaded);
+    }
+
+    template<typename MEM_TYPE_t>
+    static inline void ExStore(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+        __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+        __int32_t imm = swizzle<__uint32_t, S_IMM>(encoding);
+        Lanes addresses = batch->regs[rs1] + (XLEN_t)imm;
+        LaneMask stored = mask;
+        for (unsigned int lane = 0; lane < K; lane++) {
+            if (!mask[lane]) {
+                continue;
+            }
+            MEM_TYPE_t value = batch->regs[rs2][lane] & (MEM_TYPE_t)~0;
+            Transaction<XLEN_t> transaction = batch->lanes[lane].ram->Write(addresses[lane], sizeof(value), (char*)&value);
+            if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(value)) [[unlikely]] {
+                stored[lane] = 0;
+            }
+        }
+        Advance(batch, stored, encoding);
+        Retry<ex_store_generic<XLEN_t, MEM_TYPE_t>>(encoding, batch, mask & ~stored);
+    }
+
+    // Accesses that miss RAM go through the lane's Transactor, on the ordinary
+    // path, to reach a device or raise the access fault. RAMTransactor checks
+    // bounds before touching anything, so these lanes are unchanged so far.
+    template<DecodedInstruction<XLEN_t> slow>
+    static inline void Retry(__uint32_t encoding, HartBatch* batch, const LaneMask& missed) {
+        for (unsigned int lane = 0; lane < K; lane++) {
+            if (missed[lane]) [[unlikely]] {
+                batch->Scalar(lane, slow, encoding);
+            }
+        }
+    }
+
+    static inline void ExHint(__uint32_t encoding, HartBatch* batch, const LaneMask& mask) {
+        Advance(batch, mask, encoding);
+    }
+
+    // The batch form of a scalar executor, if it has one
+    static inline BatchExecutor Vectorize(DecodedInstruction<XLEN_t> scalar) {
+        static const std::pair<DecodedInstruction<XLEN_t>, BatchExecutor> variants[] = {
+            { ex_hint<XLEN_t>, ExHint },
+            { ex_op_generic<XLEN_t, XLEN_t, std::plus<XLEN_t>, false>,    ExOp<std::plus<>, false> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::plus<XLEN_t>, true>,     ExOp<std::plus<>, true> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::minus<XLEN_t>, false>,   ExOp<std::minus<>, false> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::bit_and<XLEN_t>, false>, ExOp<std::bit_and<>, false> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::bit_and<XLEN_t>, true>,  ExOp<std::bit_and<>, true> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::bit_or<XLEN_t>, false>,  ExOp<std::bit_or<>, false> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::bit_or<XLEN_t>, true>,   ExOp<std::bit_or<>, true> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::bit_xor<XLEN_t>, false>, ExOp<std::bit_xor<>, false> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::bit_xor<XLEN_t>, true>,  ExOp<std::bit_xor<>, true> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::less<XLEN_t>, false>,    ExOp<std::less<>, false> },
+            { ex_op_generic<XLEN_t, XLEN_t, std::less<XLEN_t>, true>,     ExOp<std::less<>, true> },
+            { ex_op_generic<XLEN_t, SXLEN_t, std::multiplies<XLEN_t>, false>, ExOp<std::multiplies<>, false> },
+            { ex_op_generic<XLEN_t, XLEN_t, left_shift<XLEN_t>, true>,    ExShiftImmediate<true> },
+            { ex_op_generic<XLEN_t, XLEN_t, right_shift<XLEN_t>, true>,   ExShiftImmediate<false> },
+            { ex_upper_immediate_generic<XLEN_t, false>, ExUpperImmediate<false> },
+            { ex_upper_immediate_generic<XLEN_t, true>,  ExUpperImmediate<true> },
+            { ex_jal<XLEN_t>,  ExJal },
+            { ex_jalr<XLEN_t>, ExJalr },
+            { ex_branch_generic<XLEN_t, std::equal_to<XLEN_t>>,               ExBranch<std::equal_to<>, false> },
+            { ex_branch_generic<XLEN_t, std::not_equal_to<XLEN_t>>,           ExBranch<std::not_equal_to<>, false> },
+            { ex_branch_generic<XLEN_t, std::less<SXLEN_t>>,                  ExBranch<std::less<>, true> },
+            { ex_branch_generic<XLEN_t, std::greater_equal<SXLEN_t>>,         ExBranch<std::greater_equal<>, true> },
+            { ex_branch_generic<XLEN_t, std::less<XLEN_t>>,                   ExBranch<std::less<>, false> },
+            { ex_branch_generic<XLEN_t, std::greater_equal<XLEN_t>>,          ExBranch<std::greater_equal<>, false> },
+            { ex_load_generic<XLEN_t, __int8_t, false>,   ExLoad<__int8_t> },
+            { ex_load_generic<XLEN_t, __int16_t, false>,  ExLoad<__int16_t> },
+            { ex_load_generic<XLEN_t, __int32_t, false>,  ExLoad<__int32_t> },
+            { ex_load_generic<XLEN_t, __uint8_t, false>,  ExLoad<__uint8_t> },
+            { ex_load_generic<XLEN_t, __uint16_t, false>, ExLoad<__uint16_t> },
+            { ex_store_generic<XLEN_t, __uint8_t>,  ExStore<__uint8_t> },
+            { ex_store_generic<XLEN_t, __uint16_t>, ExStore<__uint16_t> },
+            { ex_store_generic<XLEN_t, __uint32_t>, ExStore<__uint32_t> },
+        };
+        for (const auto& [scalar_executor, batch_executor] : variants) {
+            if (scalar == scalar_executor) {
+                return batch_executor;
+            }
+        }
+        if constexpr (sizeof(XLEN_t) == 8) {
+            if (scalar == ex_load_generic<XLEN_t, __int64_t, false>) return ExLoad<__int64_t>;
+            if (scalar == ex_load_generic<XLEN_t, __uint32_t, false>) return ExLoad<__uint32_t>;
+            if (scalar == ex_store_generic<XLEN_t, __uint64_t>) return ExStore<__uint64_t>;
+        }
+        return nullptr;
+    }
+
+public:
+
+    HartBatch(__uint32_t extensionsVector, RISCV::XlenMode mxlen)
+        : extensionsVector(extensionsVector), mxlen(mxlen) {
+    }
+
+    HartBatch(const HartBatch&) = delete;
+    HartBatch& operator=(const HartBatch&) = delete;
+
+    // Every lane decodes with the same extensions and MXLEN
+    inline void Configure(__uint32_t newExtensionsVector, RISCV::XlenMode newMxlen) {
+        extensionsVector = newExtensionsVector;
+        mxlen = newMxlen;
+        std::fill(std::begin(recent), std::end(recent), Recent{});
+        decoded.clear();
+    }
+
+    // Takes over state's registers and pc until Detach. Instructions are
+    // fetched and loads and stores made from ram, and anything outside it goes
+    // through mem (ram itself if not given), as does every scalar executor.
+    inline void Attach(unsigned int lane, HartState<XLEN_t>* state, RAMTransactor<XLEN_t>* ram,
+                       Transactor<XLEN_t>* mem = nullptr) {
+        Detach(lane);
+        lanes[lane] = { state, ram, mem != nullptr ? mem : ram };
+        Fill(lane);
+        attached |= (__uint64_t)1 << lane;
+        CheckSharedRAM();
+        Resume(lane);
+    }
+
+    // Hands the lane's registers and pc back to its HartState
+    inline void Detach(unsigned int lane) {
+        if (!(attached & ((__uint64_t)1 << lane))) {
+            return;
+        }
+        Stop(lane);
+        Spill(lane);
+        attached &= ~((__uint64_t)1 << lane);
+        lanes[lane] = {};
+        CheckSharedRAM();
+    }
+
+    // Stops a lane running, say from its HartState's callback when its
+    // program's done, though it stays attached; Resume starts it again.
+    inline void Stop(unsigned int lane) {
+        if (running[lane]) {
+            running[lane] = 0;
+            runningCount--;
+        }
+    }
+
+    inline void Resume(unsigned int lane) {
+        if (!running[lane] && (attached & ((__uint64_t)1 << lane))) {
+            running[lane] = -1;
+            runningCount++;
+        }
+    }
+
+    inline bool Running(unsigned int lane) { return running[lane]; }
+
+    // Writes every attached lane's registers and pc back to its HartState
+    inline void Sync() {
+        for (unsigned int lane = 0; lane < K; lane++) {
+            if (attached & ((__uint64_t)1 << lane)) {
+                Spill(lane);
+            }
+        }
+    }
+
+    // Runs up to steps group steps, or until every lane has stopped. Returns
+    // the number of steps taken.
+    inline __uint64_t Run(__uint64_t steps) {
+        __uint64_t taken = 0;
+        for (; taken < steps && runningCount != 0; taken++) {
+            Lanes candidates = running ? pc : ~Lanes{};
+            XLEN_t lowest = candidates[0];
+            for (unsigned int lane = 1; lane < K; lane++) {
+                lowest = candidates[lane] < lowest ? candidates[lane] : lowest;
+            }
+            LaneMask group = (pc == lowest) & running;
+            unsigned int leader = 0;
+            while (!group[leader]) {
+                leader++;
+            }
+            __uint32_t encoding = 0;
+            RISCV::TrapCause cause = Fetch(leader, lowest, &encoding);
+            if (cause != RISCV::TrapCause::NONE) [[unlikely]] {
+                Step(leader, lowest, cause, encoding);
+                continue;
+            }
+            const Decoded& instruction = Lookup(lowest, encoding);
+            if (!sharedRAM) [[unlikely]] {
+                for (unsigned int lane = leader + 1; lane < K; lane++) {
+                    if (!group[lane] || lanes[lane].ram == lanes[leader].ram) {
+                        continue;
+                    }
+                    __uint32_t own = 0;
+                    RISCV::TrapCause ownCause = Fetch(lane, lowest, &own);
+                    if (ownCause != RISCV::TrapCause::NONE || own != encoding) {
+                        group[lane] = 0;
+                        Step(lane, lowest, ownCause, own);
+                    }
+                }
+            }
+            if (instruction.batch != nullptr) [[likely]] {
+                instruction.batch(instruction.canonical, this, group);
+                continue;
+            }
+            for (unsigned int lane = 0; lane < K; lane++) {
+                if (group[lane]) {
+                    Scalar(lane, instruction.scalar, instruction.canonical);
+                }
+            }
+        }
+        return taken;
+    }
+
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+/*
+ * Deterministic SMP: any number of harts interleaved on one host thread, in a
+ * fixed order, so that every run of the same images goes exactly the same way.
+ * Each hart's run loop is a C++20 coroutine that steps its hart, instruction by
+ * instruction, and suspends back to the scheduler when its quantum is up.
+ * Switching harts is then a coroutine suspend and resume, about the cost of a
+ * function return, rather than unwinding out of a client's run loop and back
+ * in. Step is the client's "run one instruction" (fetch, decode, execute, take
+ * interrupts) for a given HartState, and is inlined into the loop.
+ *
+ * A hart also gives up the rest of its quantum when it waits for an interrupt
+ * (it's then skipped until one is pending for it) or fails a store
+ * conditional, since its lock is likely held by a hart that isn't running.
+ * Clients pass each hart's callbacks to Notify for that. Harts aren't switched
+ * out between an LR and its SC if it comes within a few instructions of the
+ * end of the quantum; when they are switched, their reservation goes, since
+ * another hart may store to it meanwhile. Each hart's host FP flags are
+ * flushed into its fflags before it's switched out.
+ */
+
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+
+#include <HartState.hpp>
+
+enum class SchedulerStop { Stopped, AllWaiting };
+
+template<typename XLEN_t, typename Step>
+class HartScheduler {
+
+private:
+
+    // How far past its quantum a hart may run to finish an LR/SC sequence; a
+    // constrained LR/SC loop is at most 16 instructions.
+    static constexpr unsigned int ReservationGrace = 16;
+
+    struct Task {
+        struct promise_type {
+            Task get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    struct Hart {
+        HartState<XLEN_t>* state;
+        Step step;
+        bool yield = false;
+        bool waiting = false;
+        Task task = {};
+    };
+
+    std::deque<Hart> harts;
+    __uint64_t quantum;
+    Hart* current = nullptr;
+    std::size_t next = 0;
+    bool stopping = false;
+
+    Task Loop(Hart* hart) {
+        HartState<XLEN_t>* state = hart->state;
+        while (true) {
+            for (__uint64_t count = quantum; count != 0 && !hart->yield; count--) {
+                hart->step(state);
+            }
+            for (unsigned int count = ReservationGrace; count != 0 && state->reserved && !hart->yield; count--) {
+                hart->step(state);
+            }
+            state->reserved = false;
+            hart->yield = false;
+            // Host FP flags are per thread, so they go to this hart's fflags
+            // before the next hart runs.
+            state->FlushFloatFlags();
+            co_await std::suspend_always{};
+        }
+    }
+
+    // As for ex_wfi, any locally enabled pending interrupt wakes the hart
+    static inline bool Woken(HartState<XLEN_t>* state) {
+        return (state->mip.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>() &
+                state->mie.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>()) != 0;
+    }
+
+public:
+
+    HartScheduler(__uint64_t quantum) : quantum(quantum) {
+    }
+
+    ~HartScheduler() {
+        for (Hart& hart : harts) {
+            hart.task.handle.destroy();
+        }
+    }
+
+    HartScheduler(const HartScheduler&) = delete;
+    HartScheduler& operator=(const HartScheduler&) = delete;
+
+    // Harts run in the order they're added
+    inline void Add(HartState<XLEN_t>* state, Step step) {
+        harts.push_back({ state, step });
+        harts.back().task = Loop(&harts.back());
+    }
+
+    inline void SetQuantum(__uint64_t instructions) {
+        quantum = instructions;
+    }
+
+    // Runs the harts in turn until Stop, or until every hart is waiting for an
+    // interrupt, in which case the client can skip ahead to the next event
+    // (see EventQueue) and Run again. Picks up where it left off.
+    inline SchedulerStop Run() {
+        stopping = false;
+        std::size_t idle = 0;
+        while (idle < harts.size()) {
+            Hart& hart = harts[next];
+            next = next + 1 == harts.size() ? 0 : next + 1;
+            if (hart.waiting) {
+                if (!Woken(hart.state)) {
+                    idle++;
+                    continue;
+                }
+                hart.waiting = false;
+            }
+            idle = 0;
+            current = &hart;
+            hart.task.handle.resume();
+            current = nullptr;
+            if (stopping) {
+                return SchedulerStop::Stopped;
+            }
+        }
+        return SchedulerStop::AllWaiting;
+    }
+
+    // Stops Run once the current instruction is done. That ends the running
+    // hart's quantum; the next Run carries on from the hart after it.
+    inline void Stop() {
+        stopping = true;
+        if (current != nullptr) {
+            current->yield = true;
+        }
+    }
+
+    // Clients pass on the callbacks of whichever hart is running
+    inline void Notify(HartCallbackArgument argument) {
+        if (current == nullptr) {
+            return;
+        }
+        switch (argument) {
+            case HartCallbackArgument::WaitingForInterrupt:
+                current->waiting = true;
+                current->yield = true;
+                break;
+            case HartCallbackArgument::FailedStoreConditional:
+                current->yield = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    inline HartState<XLEN_t>* Current() { return current != nullptr ? current->state : nullptr; }
+
+};
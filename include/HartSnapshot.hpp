@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+ * Snapshot and reset for fuzzing: Take saves a hart and its RAM, and Restore
+ * puts both back, so each iteration starts from the same state without a new
+ * HartState or a fresh copy of RAM. RAM is restored page by page, only the
+ * pages written since (see RAMTransactor::Snapshot), so a reset costs about
+ * what the iteration touched.
+ *
+ * Caches stay warm across a Restore where they're still right. A DecodeCache
+ * wired to RAMTransactor::TrackCode only loses the pages that were written.
+ * Restore calls the hart back with ChangedMSTATUS and ChangedSATP, and with
+ * ChangedPrivilege and ChangedMISA if those differ from before, so an MMUSet
+ * picks its variants again and a FetchCache drops its page, whose
+ * translation may have come from page tables that were just put back.
+ *
+ * Device state (the CLINT's timers, say) isn't part of the snapshot; clients
+ * reset their devices themselves.
+ */
+
+#include <optional>
+
+#include <RiscV.hpp>
+#include <HartState.hpp>
+#include <HostFloat.hpp>
+#include <RAMTransactor.hpp>
+
+template<typename XLEN_t>
+class HartSnapshot {
+
+private:
+
+    HartState<XLEN_t>* state;
+    RAMTransactor<XLEN_t>* ram;
+    std::optional<HartState<XLEN_t>> saved;
+
+public:
+
+    HartSnapshot(HartState<XLEN_t>* state, RAMTransactor<XLEN_t>* ram)
+        : state(state), ram(ram) {
+    }
+
+    HartSnapshot(const HartSnapshot&) = delete;
+    HartSnapshot& operator=(const HartSnapshot&) = delete;
+
+    ~HartSnapshot() {
+        if (saved.has_value()) {
+            ram->DropSnapshot();
+        }
+    }
+
+    // Run on the hart's host thread, between instructions. writeProtect is
+    // for FastMemory, as for RAMTransactor::Snapshot.
+    inline bool Take(bool writeProtect = false) {
+        if (!ram->Snapshot(writeProtect)) {
+            return false;
+        }
+        state->FlushFloatFlags();
+        saved.emplace(*state);
+        return true;
+    }
+
+    // Returns the number of RAM pages put back
+    inline XLEN_t Restore() {
+        if (!saved.has_value()) {
+            return 0;
+        }
+        HostFloat::TakeFlags(); // The iteration's, not the snapshot's
+        RISCV::PrivilegeMode privilege = state->privilegeMode;
+        __uint32_t extensions = state->misa.extensions;
+        RISCV::XlenMode mxlen = state->misa.mxlen;
+        std::function<void(HartCallbackArgument)> callback = std::move(state->implCallback);
+        *state = *saved;
+        state->implCallback = std::move(callback);
+        XLEN_t restored = ram->Restore();
+        if (state->misa.extensions != extensions || state->misa.mxlen != mxlen) {
+            state->implCallback(HartCallbackArgument::ChangedMISA);
+        }
+        if (state->privilegeMode != privilege) {
+            state->implCallback(HartCallbackArgument::ChangedPrivilege);
+        }
+        state->implCallback(HartCallbackArgument::ChangedMSTATUS);
+        state->implCallback(HartCallbackArgument::ChangedSATP);
+        state->implCallback(HartCallbackArgument::ChangedPMP);
+        return restored;
+    }
+
+    inline bool Taken() { return saved.has_value(); }
+
+};
@@ -1,59 +1,89 @@
 #pragma once
 
+#include <bit>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 
 #include <RiscV.hpp>
+#include <CSRStorage.hpp>
 #include <DecodedInstruction.hpp>
+#include <HostFloat.hpp>
+#include <ISA.hpp>
+#include <PMP.hpp>
+#include <VectorState.hpp>
 
 enum class HartCallbackArgument {
     ChangedPrivilege,
     ChangedMISA,
     ChangedMSTATUS,
     ChangedSATP,
+    ChangedPMP,
     RequestedIfence,
     RequestedVMfence,
-    TookTrap
+    TookTrap,
+    WaitingForInterrupt,
+    HitBreakpoint,
+    FailedStoreConditional
 };
 
+// Harts are cache-line aligned, and so padded out to whole lines: harts in an
+// array, each run by its own host thread, never share a line.
+constexpr std::size_t HartCacheLineSize = 64;
+
 template<typename XLEN_t>
-class HartState {
+class alignas(HartCacheLineSize) HartState {
 
 public:
 
+    // What the hart can ever support; see ISA.hpp. It's DefaultISA rather than
+    // a template parameter because executors take a HartState<XLEN_t>, so a
+    // hart with any other ISA couldn't run them.
+    using ISA = DefaultISA;
+
+    // How some of the CSRs are stored; see CSRStorage.hpp. DefaultCSRs, for the
+    // same reason as the ISA.
+    using CSRs = DefaultCSRs;
+
     // TODO, bug, MIP MIE MIDELEG MEDELEG are MXLEN bits wide, not XLEN... etc.
-    // TODO Maybe move counters and such out of the struct for speed - not used
-    // often, and it's a 24->23 mips perf impact to keep them here! Or pareidolia.
-    // TODO, an experiment with actually good scientific stats comparing packed
-    // bits vs. broken out fields for these registers. First wrap in accessors.
 
+    // Hot: the pc, and the state that instruction execution, translation and
+    // the interrupt check look at all the time, lead the struct; the integer
+    // registers start a line of their own.
     XLEN_t pc;
-
-    XLEN_t regs[RISCV::NumRegs];
     RISCV::PrivilegeMode privilegeMode = RISCV::PrivilegeMode::Machine;
     RISCV::misaReg misa;
-    RISCV::mstatusReg mstatus;
-    RISCV::interruptReg mie, mip;
-    RISCV::causeReg<XLEN_t> mcause, scause, ucause;
+    CSRs::Status<XLEN_t> mstatus;
+    CSRs::Satp<XLEN_t> satp;
+    CSRs::Interrupts<XLEN_t> mie, mip;
+    __uint32_t frm;
+    __uint32_t fflags; // Not including flags still pending on the host FPU
+
+    // The LR reservation. Nothing here watches other harts' stores, so a
+    // client that switches between harts clears it (see HartScheduler).
+    XLEN_t reservation;
+    bool reserved = false;
+
+    alignas(HartCacheLineSize) XLEN_t regs[RISCV::NumRegs];
+    __uint64_t fregs[RISCV::NumRegs];
+
+    // Cold: trap handling state, only touched on traps and CSR accesses. Keep
+    // anything else rarely used (counters, say) down here too; it's cheap to
+    // grow this part of the struct, and not the part above.
+    alignas(HartCacheLineSize) CSRs::Cause<XLEN_t> mcause, scause, ucause;
     RISCV::tvecReg<XLEN_t> mtvec, stvec, utvec;
     XLEN_t mepc, sepc, uepc;
     XLEN_t mtval, stval, utval;
     XLEN_t mscratch, sscratch, uscratch;
     XLEN_t mideleg, medeleg, sideleg, sedeleg; // TODO are these "interruptReg"?
-    RISCV::satpReg<XLEN_t> satp;
-    RISCV::fcsrReg fcsr; // TODO float regs
-    // __uint64_t counters[32];
-    // __uint32_t mcounteren;
-    // __uint32_t scounteren;
-    // __uint32_t mcountinhibit;
-    // XLEN_t hpmevents[32];
-    // RISCV::pmpEntry pmpentry[16];
+    PMP<XLEN_t> pmp;
+    VectorState vector;
 
     std::function<void(HartCallbackArgument)> implCallback;
     void emptyCallback(HartCallbackArgument arg) { return; }
 
     HartState(__uint32_t allSupportedExtensions)
-        : misa(allSupportedExtensions){
+        : misa(allSupportedExtensions & ISA::extensions){
         implCallback = std::bind(&HartState::emptyCallback, this, std::placeholders::_1);
         privilegeMode = RISCV::PrivilegeMode::Machine;
         // TODO just reset instead?
@@ -62,14 +92,19 @@ public:
     void Reset(XLEN_t resetVector) {
 
         pc = resetVector;
+        reserved = false;
 
         for (unsigned int i = 0; i < RISCV::NumRegs; i++) {
             regs[i] = (XLEN_t)0;
+            fregs[i] = 0;
         }
 
         privilegeMode = RISCV::PrivilegeMode::Machine;
         misa.Reset<XLEN_t>();
-        mstatus.Reset<XLEN_t>();
+        mstatus.template Reset<XLEN_t>();
+        if (RISCV::vectorHasExtension(Extensions(), 'F')) {
+            mstatus.fs = (decltype(mstatus.fs))FloatInitial; // So bare-metal code needn't turn the FPU on
+        }
         mie.Reset();
         mip.Reset();
         mcause.Reset();
@@ -92,7 +127,160 @@ public:
         sideleg = 0;
         sedeleg = 0;
         satp.Reset();
-        fcsr.Reset();
+        frm = HostFloat::RoundingMode::RNE;
+        fflags = 0;
+        HostFloat::TakeFlags();
+        vector.Reset();
+        if (RISCV::vectorHasExtension(Extensions(), 'V')) {
+            vector.vs = FloatInitial;
+        }
+        pmp.Reset();
+    }
+
+    // mstatus.FS. While it's Off, F and D instructions and the FP CSRs are
+    // illegal; anything that changes FP state makes it Dirty, which is what
+    // tells an OS the FP registers need saving on a context switch.
+    static constexpr unsigned int FloatOff = 0;
+    static constexpr unsigned int FloatInitial = 1;
+    static constexpr unsigned int FloatDirty = 3;
+
+    inline bool FloatEnabled() {
+        return mstatus.fs != (decltype(mstatus.fs))FloatOff;
+    }
+
+    inline void DirtyFloat() {
+        mstatus.fs = (decltype(mstatus.fs))FloatDirty;
+    }
+
+    // mstatus.VS works the same way for V instructions and the vector CSRs,
+    // and uses the same encoding.
+    inline bool VectorEnabled() {
+        return vector.vs != FloatOff;
+    }
+
+    inline void DirtyVector() {
+        vector.vs = FloatDirty;
+    }
+
+    // VS is bits 10:9 of mstatus and sstatus, and feeds SD along with FS and XS.
+    inline XLEN_t WithVectorStatus(XLEN_t value) {
+        value |= (XLEN_t)vector.vs << 9;
+        if (vector.vs == FloatDirty) {
+            value |= (XLEN_t)1 << (8 * sizeof(XLEN_t) - 1);
+        }
+        return value;
+    }
+
+    inline void WriteVectorStatus(XLEN_t value) {
+        if (RISCV::vectorHasExtension(Extensions(), 'V')) {
+            vector.vs = (value >> 9) & 3;
+        }
+    }
+
+    // Single-precision values are NaN-boxed in the 64-bit float registers. A
+    // single-precision read of a register that isn't properly boxed sees the
+    // canonical NaN instead.
+    template<typename FLOAT_t>
+    inline HostFloat::Bits<FLOAT_t> ReadFloatBits(unsigned int reg) {
+        if constexpr (sizeof(FLOAT_t) == 4) {
+            if ((fregs[reg] >> 32) != 0xffffffff) {
+                return HostFloat::CanonicalNaN<float>;
+            }
+        }
+        return fregs[reg];
+    }
+
+    template<typename FLOAT_t>
+    inline FLOAT_t ReadFloat(unsigned int reg) {
+        return std::bit_cast<FLOAT_t>(ReadFloatBits<FLOAT_t>(reg));
+    }
+
+    template<typename FLOAT_t>
+    inline void WriteFloatBits(unsigned int reg, HostFloat::Bits<FLOAT_t> bits) {
+        if constexpr (sizeof(FLOAT_t) == 4) {
+            fregs[reg] = 0xffffffff00000000 | bits;
+        } else {
+            fregs[reg] = bits;
+        }
+        DirtyFloat();
+    }
+
+    // Arithmetic results are written through here; the host doesn't produce
+    // RISC-V's canonical NaN on its own.
+    template<typename FLOAT_t>
+    inline void WriteFloat(unsigned int reg, FLOAT_t value) {
+        if (value != value) {
+            WriteFloatBits<FLOAT_t>(reg, HostFloat::CanonicalNaN<FLOAT_t>);
+            return;
+        }
+        WriteFloatBits<FLOAT_t>(reg, std::bit_cast<HostFloat::Bits<FLOAT_t>>(value));
+    }
+
+    // Folds flags raised on the host FPU into fflags. Clients that interleave
+    // harts on one host thread must call this before switching away.
+    inline void FlushFloatFlags() {
+        __uint32_t raised = HostFloat::TakeFlags();
+        if (raised != 0) {
+            fflags |= raised;
+            DirtyFloat();
+        }
+    }
+
+    // Whether an instruction may access the CSR now, beyond privilege: the FP
+    // CSRs need mstatus.FS on, and the vector CSRs mstatus.VS.
+    inline bool CSREnabled(RISCV::CSRAddress csrAddress) {
+        switch (csrAddress) {
+            case RISCV::CSRAddress::FFLAGS:
+            case RISCV::CSRAddress::FRM:
+            case RISCV::CSRAddress::FCSR:
+                return FloatEnabled();
+            default:
+                return !VectorState::IsCSR(csrAddress) || VectorEnabled();
+        }
+    }
+
+    // The extensions enabled right now, as far as the ISA allows
+    inline __uint32_t Extensions() {
+        return misa.extensions & ISA::extensions;
+    }
+
+    // The privilege loads and stores are translated and checked at: MPP while
+    // MPRV is set in M-mode, otherwise the current one. Fetches always use the
+    // current privilege.
+    inline RISCV::PrivilegeMode DataPrivilege() {
+        if (mstatus.mprv && privilegeMode == RISCV::PrivilegeMode::Machine) {
+            return mstatus.mpp;
+        }
+        return privilegeMode;
+    }
+
+    // CSRs belonging to modes and extensions the ISA doesn't have read as zero
+    // and ignore writes.
+    static inline bool CSRInISA(RISCV::CSRAddress csrAddress) {
+        switch (csrAddress) {
+            case RISCV::CSRAddress::USTATUS:
+            case RISCV::CSRAddress::UIE:
+            case RISCV::CSRAddress::UTVEC:
+            case RISCV::CSRAddress::USCRATCH:
+            case RISCV::CSRAddress::UEPC:
+            case RISCV::CSRAddress::UCAUSE:
+            case RISCV::CSRAddress::UTVAL:
+            case RISCV::CSRAddress::UIP:
+                return isa_allows<ISA>('N');
+            case RISCV::CSRAddress::FFLAGS:
+            case RISCV::CSRAddress::FRM:
+            case RISCV::CSRAddress::FCSR:
+                return isa_allows<ISA>('F');
+            default:
+                break;
+        }
+        if (RISCV::csrRequiredPrivilege(csrAddress) == RISCV::PrivilegeMode::Supervisor) {
+            return isa_allows<ISA>('S');
+        }
+        if (VectorState::IsCSR(csrAddress)) {
+            return isa_allows<ISA>('V');
+        }
+        return true;
     }
 
     // Note, I think that any hardwiring has to happen on notify, not in reg.
@@ -135,29 +323,43 @@ public:
 
         if (csrAddress >= RISCV::CSRAddress::PMPADDR0 &&
             csrAddress <= RISCV::CSRAddress::PMPADDR15) {
-            // unsigned int pmpEntryID = csrAddress - RISCV::CSRAddress::PMPADDR0;
-            // TODO pmp address
+            unsigned int pmpEntryID = csrAddress - RISCV::CSRAddress::PMPADDR0;
+            if constexpr (Writing) {
+                pmp.WriteAddress(pmpEntryID, *value);
+                implCallback(HartCallbackArgument::ChangedPMP);
+            } else {
+                *value = pmp.ReadAddress(pmpEntryID);
+            }
         }
 
         if (csrAddress >= RISCV::CSRAddress::PMPCFG0 &&
             csrAddress <= RISCV::CSRAddress::PMPCFG3) {
-            // TODO four pmp entries at once
+            unsigned int pmpCfgID = csrAddress - RISCV::CSRAddress::PMPCFG0;
+            if constexpr (Writing) {
+                pmp.WriteConfig(pmpCfgID, *value);
+                implCallback(HartCallbackArgument::ChangedPMP);
+            } else {
+                *value = pmp.ReadConfig(pmpCfgID);
+            }
         }
     }
 
     inline XLEN_t ReadCSR(RISCV::CSRAddress csrAddress) {
+        if (!CSRInISA(csrAddress)) {
+            return 0;
+        }
         switch (csrAddress) {
             case RISCV::CSRAddress::MISA: return misa.Read<XLEN_t>(); break;
             case RISCV::CSRAddress::SATP: return satp.Read(); break;
-            case RISCV::CSRAddress::MSTATUS: return mstatus.Read<XLEN_t, RISCV::PrivilegeMode::Machine>(); break;
-            case RISCV::CSRAddress::SSTATUS: return mstatus.Read<XLEN_t, RISCV::PrivilegeMode::Supervisor>(); break;
-            case RISCV::CSRAddress::USTATUS: return mstatus.Read<XLEN_t, RISCV::PrivilegeMode::User>(); break;
-            case RISCV::CSRAddress::MIE: return mie.Read<XLEN_t, RISCV::PrivilegeMode::Machine>(); break;
-            case RISCV::CSRAddress::SIE: return mie.Read<XLEN_t, RISCV::PrivilegeMode::Supervisor>(); break;
-            case RISCV::CSRAddress::UIE: return mie.Read<XLEN_t, RISCV::PrivilegeMode::User>(); break;
-            case RISCV::CSRAddress::MIP: return mip.Read<XLEN_t, RISCV::PrivilegeMode::Machine>(); break;
-            case RISCV::CSRAddress::SIP: return mip.Read<XLEN_t, RISCV::PrivilegeMode::Supervisor>(); break;
-            case RISCV::CSRAddress::UIP: return mip.Read<XLEN_t, RISCV::PrivilegeMode::User>(); break;
+            case RISCV::CSRAddress::MSTATUS: return WithVectorStatus(mstatus.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>()); break;
+            case RISCV::CSRAddress::SSTATUS: return WithVectorStatus(mstatus.template Read<XLEN_t, RISCV::PrivilegeMode::Supervisor>()); break;
+            case RISCV::CSRAddress::USTATUS: return mstatus.template Read<XLEN_t, RISCV::PrivilegeMode::User>(); break;
+            case RISCV::CSRAddress::MIE: return mie.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>(); break;
+            case RISCV::CSRAddress::SIE: return mie.template Read<XLEN_t, RISCV::PrivilegeMode::Supervisor>(); break;
+            case RISCV::CSRAddress::UIE: return mie.template Read<XLEN_t, RISCV::PrivilegeMode::User>(); break;
+            case RISCV::CSRAddress::MIP: return mip.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>(); break;
+            case RISCV::CSRAddress::SIP: return mip.template Read<XLEN_t, RISCV::PrivilegeMode::Supervisor>(); break;
+            case RISCV::CSRAddress::UIP: return mip.template Read<XLEN_t, RISCV::PrivilegeMode::User>(); break;
             case RISCV::CSRAddress::MTVEC: return mtvec.Read(); break;
             case RISCV::CSRAddress::MSCRATCH: return mscratch; break;
             case RISCV::CSRAddress::MEPC: return mepc; break;
@@ -181,9 +383,9 @@ public:
             case RISCV::CSRAddress::MVENDORID: break;
             case RISCV::CSRAddress::MARCHID: break;
             case RISCV::CSRAddress::MIMPID: break;
-            case RISCV::CSRAddress::FFLAGS: break;
-            case RISCV::CSRAddress::FRM: break;
-            case RISCV::CSRAddress::FCSR: break;
+            case RISCV::CSRAddress::FFLAGS: FlushFloatFlags(); return fflags; break;
+            case RISCV::CSRAddress::FRM: return frm; break;
+            case RISCV::CSRAddress::FCSR: FlushFloatFlags(); return (frm << 5) | fflags; break;
             case RISCV::CSRAddress::SCOUNTEREN: break;
             case RISCV::CSRAddress::MCOUNTEREN: break;
             case RISCV::CSRAddress::MCOUNTINHIBIT: break;
@@ -197,6 +399,9 @@ public:
             case RISCV::CSRAddress::DSCRATCH1: break;
             case RISCV::CSRAddress::INVALID_CSR: break;
             default:
+                if (VectorState::IsCSR(csrAddress)) {
+                    return vector.ReadCSR<XLEN_t>(csrAddress);
+                }
                 XLEN_t value;
                 BankedCSR<false>(csrAddress, &value);
                 return value;
@@ -207,9 +412,13 @@ public:
     }
 
     inline void WriteCSR(RISCV::CSRAddress csrAddress, XLEN_t value) {
+        if (!CSRInISA(csrAddress)) {
+            return;
+        }
         switch (csrAddress) {
             case RISCV::CSRAddress::MISA:
                 misa.Write<XLEN_t>(value);
+                misa.extensions &= ISA::extensions;
                 implCallback(HartCallbackArgument::ChangedMISA);
                 break;
             case RISCV::CSRAddress::SATP:
@@ -217,23 +426,25 @@ public:
                 implCallback(HartCallbackArgument::ChangedSATP);
                 break;
             case RISCV::CSRAddress::MSTATUS:
-                mstatus.Write<XLEN_t, RISCV::PrivilegeMode::Machine>(value);
+                mstatus.template Write<XLEN_t, RISCV::PrivilegeMode::Machine>(value);
+                WriteVectorStatus(value);
                 implCallback(HartCallbackArgument::ChangedMSTATUS);
                 break;
             case RISCV::CSRAddress::SSTATUS:
-                mstatus.Write<XLEN_t, RISCV::PrivilegeMode::Supervisor>(value);
+                mstatus.template Write<XLEN_t, RISCV::PrivilegeMode::Supervisor>(value);
+                WriteVectorStatus(value);
                 implCallback(HartCallbackArgument::ChangedMSTATUS);
                 break;
             case RISCV::CSRAddress::USTATUS:
-                mstatus.Write<XLEN_t, RISCV::PrivilegeMode::User>(value);
+                mstatus.template Write<XLEN_t, RISCV::PrivilegeMode::User>(value);
                 implCallback(HartCallbackArgument::ChangedMSTATUS);
                 break;
-            case RISCV::CSRAddress::MIE: mie.Write<XLEN_t, RISCV::PrivilegeMode::Machine>(value); break;
-            case RISCV::CSRAddress::SIE: mie.Write<XLEN_t, RISCV::PrivilegeMode::Supervisor>(value); break;
-            case RISCV::CSRAddress::UIE: mie.Write<XLEN_t, RISCV::PrivilegeMode::User>(value); break;
-            case RISCV::CSRAddress::MIP: mip.Write<XLEN_t, RISCV::PrivilegeMode::Machine>(value); break;
-            case RISCV::CSRAddress::SIP: mip.Write<XLEN_t, RISCV::PrivilegeMode::Supervisor>(value); break;
-            case RISCV::CSRAddress::UIP: mip.Write<XLEN_t, RISCV::PrivilegeMode::User>(value); break;
+            case RISCV::CSRAddress::MIE: mie.template Write<XLEN_t, RISCV::PrivilegeMode::Machine>(value); break;
+            case RISCV::CSRAddress::SIE: mie.template Write<XLEN_t, RISCV::PrivilegeMode::Supervisor>(value); break;
+            case RISCV::CSRAddress::UIE: mie.template Write<XLEN_t, RISCV::PrivilegeMode::User>(value); break;
+            case RISCV::CSRAddress::MIP: mip.template Write<XLEN_t, RISCV::PrivilegeMode::Machine>(value); break;
+            case RISCV::CSRAddress::SIP: mip.template Write<XLEN_t, RISCV::PrivilegeMode::Supervisor>(value); break;
+            case RISCV::CSRAddress::UIP: mip.template Write<XLEN_t, RISCV::PrivilegeMode::User>(value); break;
             case RISCV::CSRAddress::MTVEC: mtvec.Write(value); break;
             case RISCV::CSRAddress::MSCRATCH: mscratch = value; break;
             case RISCV::CSRAddress::MEPC: mepc = value; break;
@@ -257,9 +468,21 @@ public:
             case RISCV::CSRAddress::MVENDORID: break; // TODO all the others
             case RISCV::CSRAddress::MARCHID: break;
             case RISCV::CSRAddress::MIMPID: break;
-            case RISCV::CSRAddress::FFLAGS: break;
-            case RISCV::CSRAddress::FRM: break;
-            case RISCV::CSRAddress::FCSR: break;
+            case RISCV::CSRAddress::FFLAGS:
+                HostFloat::TakeFlags();
+                fflags = value & 0x1f;
+                DirtyFloat();
+                break;
+            case RISCV::CSRAddress::FRM:
+                frm = value & 0x7;
+                DirtyFloat();
+                break;
+            case RISCV::CSRAddress::FCSR:
+                HostFloat::TakeFlags();
+                fflags = value & 0x1f;
+                frm = (value >> 5) & 0x7;
+                DirtyFloat();
+                break;
             case RISCV::CSRAddress::SCOUNTEREN: break;
             case RISCV::CSRAddress::MCOUNTEREN: break;
             case RISCV::CSRAddress::MCOUNTINHIBIT: break;
@@ -273,6 +496,11 @@ public:
             case RISCV::CSRAddress::DSCRATCH1: break;
             case RISCV::CSRAddress::INVALID_CSR: break;
             default:
+                if (VectorState::IsCSR(csrAddress)) {
+                    vector.WriteCSR<XLEN_t>(csrAddress, value);
+                    DirtyVector();
+                    break;
+                }
                 BankedCSR<true>(csrAddress, &value);
                 break;
         }
@@ -285,7 +513,7 @@ public:
         }
 
         RISCV::PrivilegeMode targetPrivilege = RISCV::DestinedPrivilegeForCause<XLEN_t>(
-            cause, medeleg, sedeleg, misa.extensions);
+            cause, medeleg, sedeleg, Extensions());
         TakeTrap<false>(cause, targetPrivilege, tval);
 
         implCallback(HartCallbackArgument::TookTrap);
@@ -298,8 +526,8 @@ public:
         XLEN_t interruptsForU = 0;
 
         // TODO do this without bits, just use raw values. Faster...
-        XLEN_t mipBits = mip.Read<XLEN_t, RISCV::PrivilegeMode::Machine>();
-        XLEN_t mieBits = mie.Read<XLEN_t, RISCV::PrivilegeMode::Machine>();
+        XLEN_t mipBits = mip.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>();
+        XLEN_t mieBits = mie.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>();
 
         for (unsigned int bit = 0; bit < 8*sizeof(XLEN_t); bit++) {
 
@@ -311,7 +539,7 @@ public:
             // Figure out the destined privilege level for the interrupt
             RISCV::PrivilegeMode destinedPrivilege =
                 RISCV::DestinedPrivilegeForCause<XLEN_t>(
-                    (RISCV::TrapCause)bit, mideleg, sideleg, misa.extensions);
+                    (RISCV::TrapCause)bit, mideleg, sideleg, Extensions());
 
             // Set the interrupt's bit in the correct mask for its privilege
             if (destinedPrivilege == RISCV::PrivilegeMode::Machine) {
@@ -431,7 +659,10 @@ public:
             mstatus.mie = mstatus.mpie;
             privilegeMode = mstatus.mpp;
             mstatus.mpie = true;
-            if (RISCV::vectorHasExtension(misa.extensions, 'U')) {
+            if (privilegeMode != RISCV::PrivilegeMode::Machine) {
+                mstatus.mprv = false;
+            }
+            if (RISCV::vectorHasExtension(Extensions(), 'U')) {
                 mstatus.mpp = RISCV::PrivilegeMode::User;
             } else {
                 mstatus.mpp = RISCV::PrivilegeMode::Machine;
@@ -441,7 +672,10 @@ public:
             mstatus.sie = mstatus.spie;
             privilegeMode = mstatus.spp;
             mstatus.spie = true;
-            if (RISCV::vectorHasExtension(misa.extensions, 'U')) {
+            if (privilegeMode != RISCV::PrivilegeMode::Machine) {
+                mstatus.mprv = false;
+            }
+            if (RISCV::vectorHasExtension(Extensions(), 'U')) {
                 mstatus.spp = RISCV::PrivilegeMode::User;
             } else {
                 mstatus.spp = RISCV::PrivilegeMode::Machine;
@@ -0,0 +1,320 @@
+#pragma once
+
+/*
+ * Glue between guest F/D instructions and the host FPU. Guest arithmetic runs
+ * as plain host float/double operations, so the two things that need care are
+ * the rounding mode and the exception flags.
+ *
+ * The host rounding mode is only reloaded when the mode an instruction asks
+ * for differs from the one already loaded on this thread. Exception flags are
+ * left to accumulate in the host status register, and are only folded into the
+ * guest's fflags when something reads them (see TakeFlags).
+ *
+ * Because both live in per-thread host state, a client that runs several harts
+ * on one thread must call HartState::FlushFloatFlags before switching harts,
+ * and host code that does its own float math between guest instructions will
+ * leak flags into the guest.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cfenv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace HostFloat {
+
+enum RoundingMode : __uint32_t { RNE = 0, RTZ = 1, RDN = 2, RUP = 3, RMM = 4, DYN = 7 };
+enum Flag : __uint32_t { NX = 1 << 0, UF = 1 << 1, OF = 1 << 2, DZ = 1 << 3, NV = 1 << 4 };
+
+template<typename FLOAT_t>
+using Bits = std::conditional_t<sizeof(FLOAT_t) == 4, __uint32_t, __uint64_t>;
+
+template<typename FLOAT_t>
+inline constexpr Bits<FLOAT_t> CanonicalNaN = sizeof(FLOAT_t) == 4 ? 0x7fc00000 : 0x7ff8000000000000;
+
+template<typename FLOAT_t>
+inline constexpr Bits<FLOAT_t> QuietBit = sizeof(FLOAT_t) == 4 ? 1 << 22 : (Bits<FLOAT_t>)1 << 51;
+
+template<typename FLOAT_t>
+inline bool IsSignalingNaN(FLOAT_t value) {
+    return value != value && !(std::bit_cast<Bits<FLOAT_t>>(value) & QuietBit<FLOAT_t>);
+}
+
+// The mode last loaded into this thread's FPU. Threads start out in RNE.
+inline thread_local __uint32_t loadedRoundingMode = RoundingMode::RNE;
+
+// Returns false for the reserved modes, which make the instruction illegal.
+// RMM has no host equivalent, so it loads RNE, and instructions move ties away
+// from zero themselves (see ConvertTiesAway, NarrowTiesAway, AddTiesAway).
+inline bool UseRoundingMode(__uint32_t rm) {
+    if (rm == loadedRoundingMode) [[likely]] {
+        return true;
+    }
+    if (rm > RoundingMode::RMM) {
+        return false;
+    }
+#if defined(__SSE2__)
+    static constexpr __uint32_t mxcsrRC[] = { 0b00, 0b11, 0b01, 0b10, 0b00 };
+    _mm_setcsr((_mm_getcsr() & ~(0b11 << 13)) | (mxcsrRC[rm] << 13));
+#else
+    static constexpr int fenvRound[] = { FE_TONEAREST, FE_TOWARDZERO, FE_DOWNWARD, FE_UPWARD, FE_TONEAREST };
+    std::fesetround(fenvRound[rm]);
+#endif
+    loadedRoundingMode = rm;
+    return true;
+}
+
+// Converts an integer rounding to nearest, ties away from zero, by rounding its
+// magnitude by hand, so the host conversion itself is always exact. Adds NX to
+// flags if the result is inexact.
+template<typename FLOAT_t, typename INT_t>
+inline FLOAT_t ConvertTiesAway(INT_t value, __uint32_t* flags) {
+    bool negative = false;
+    __uint64_t magnitude = (__uint64_t)value;
+    if constexpr (std::is_signed_v<INT_t>) {
+        negative = value < 0;
+        magnitude = negative ? -(__uint64_t)(__int64_t)value : (__uint64_t)value;
+    }
+    unsigned int length = std::bit_width(magnitude);
+    if (length <= (unsigned int)std::numeric_limits<FLOAT_t>::digits) {
+        return (FLOAT_t)value;
+    }
+    unsigned int dropped = length - std::numeric_limits<FLOAT_t>::digits;
+    __uint64_t low = magnitude & (((__uint64_t)1 << dropped) - 1);
+    FLOAT_t result = (FLOAT_t)(magnitude - low);
+    if (low >= (__uint64_t)1 << (dropped - 1)) {
+        result += (FLOAT_t)((__uint64_t)1 << dropped);
+    }
+    if (low != 0) {
+        *flags |= Flag::NX;
+    }
+    return negative ? -result : result;
+}
+
+// Narrows a double to a float rounding to nearest, ties away from zero. Every
+// float and every midpoint between two floats is a double, so after the host's
+// round to nearest even, a tie shows as the value lying exactly halfway to the
+// next float, and is moved away from zero. The host must be in RNE.
+inline float NarrowTiesAway(double value) {
+    float nearest = (float)value;
+    if (!std::isfinite(nearest) || (double)nearest == value) {
+        return nearest;
+    }
+    float neighbour = std::nextafter(nearest, value > nearest ? std::numeric_limits<float>::infinity()
+                                                              : -std::numeric_limits<float>::infinity());
+    bool tie = 2 * std::fabs(value - (double)nearest) == std::fabs((double)neighbour - (double)nearest);
+    return tie && std::fabs(value) > std::fabs((double)nearest) ? neighbour : nearest;
+}
+
+// Arithmetic under RMM runs on the host in RNE, which only differs on ties. For
+// add, sub, mul and div the host can recover the exact residual of its own
+// result (TwoSum, or an FMA), and a residual of exactly half an ulp towards the
+// next value away from zero is a tie. The FMAs, whose residual doesn't fit in
+// one float, and results too close to underflow for the residual to be exact,
+// take a soft path instead. The host must be in RNE.
+
+// Results at least this large leave room below them for an exact residual.
+template<typename FLOAT_t>
+inline constexpr FLOAT_t ResidualFloor = std::bit_cast<FLOAT_t>(
+    (Bits<FLOAT_t>)(1 + 2 * std::numeric_limits<FLOAT_t>::digits) << (std::numeric_limits<FLOAT_t>::digits - 1));
+
+// Given the host's nonzero, finite RNE result of an operation whose exact value
+// is nearest + residual / scale, moves ties one step away from zero. The step
+// is taken on the bits, so no flags are raised.
+template<typename FLOAT_t>
+inline FLOAT_t AwayFromTie(FLOAT_t nearest, FLOAT_t residual, FLOAT_t scale) {
+    FLOAT_t neighbour = std::bit_cast<FLOAT_t>(std::bit_cast<Bits<FLOAT_t>>(nearest) + 1);
+    return 2 * residual == (neighbour - nearest) * scale ? neighbour : nearest;
+}
+
+// Splits a finite, nonzero value into value == significand * 2^exponent.
+template<typename FLOAT_t>
+inline void Decompose(FLOAT_t value, __uint64_t* significand, int* exponent) {
+    constexpr int digits = std::numeric_limits<FLOAT_t>::digits;
+    constexpr int lowest = std::numeric_limits<FLOAT_t>::min_exponent - digits;
+    Bits<FLOAT_t> bits = std::bit_cast<Bits<FLOAT_t>>(value);
+    __uint64_t mantissa = bits & (((Bits<FLOAT_t>)1 << (digits - 1)) - 1);
+    int field = (bits >> (digits - 1)) & ((1 << (sizeof(FLOAT_t) * 8 - digits)) - 1);
+    *significand = field != 0 ? mantissa | ((__uint64_t)1 << (digits - 1)) : mantissa;
+    *exponent = field != 0 ? lowest + field - 1 : lowest;
+}
+
+inline int BitWidth(unsigned __int128 value) {
+    __uint64_t high = (__uint64_t)(value >> 64);
+    return high != 0 ? 64 + std::bit_width(high) : std::bit_width((__uint64_t)value);
+}
+
+// Rounds (significand + a fraction, if sticky) * 2^exponent to nearest, ties
+// away from zero, adding NX, UF and OF to flags as the spec asks, with
+// tininess detected after rounding. The significand must be nonzero.
+template<typename FLOAT_t>
+inline FLOAT_t RoundTiesAway(bool negative, unsigned __int128 significand, int exponent, bool sticky, __uint32_t* flags) {
+    constexpr int digits = std::numeric_limits<FLOAT_t>::digits;
+    constexpr int lowest = std::numeric_limits<FLOAT_t>::min_exponent - digits;
+    Bits<FLOAT_t> sign = negative ? (Bits<FLOAT_t>)1 << (sizeof(FLOAT_t) * 8 - 1) : 0;
+    int shift = 128 - BitWidth(significand);
+    significand <<= shift;
+    exponent -= shift;
+    int leading = exponent + 127;
+    if (leading >= std::numeric_limits<FLOAT_t>::max_exponent) {
+        *flags |= Flag::OF | Flag::NX;
+        return std::bit_cast<FLOAT_t>(sign | std::bit_cast<Bits<FLOAT_t>>(std::numeric_limits<FLOAT_t>::infinity()));
+    }
+    int lsb = std::max(leading - (digits - 1), lowest);
+    int dropped = lsb - exponent;
+    unsigned __int128 kept = 0;
+    bool inexact = true;
+    if (dropped < 128) {
+        kept = (significand >> dropped) + ((significand >> (dropped - 1)) & 1);
+        inexact = sticky || (significand & (((unsigned __int128)1 << dropped) - 1)) != 0;
+    } else if (dropped == 128) {
+        kept = 1;
+    }
+    if (inexact) {
+        // Below the smallest normal, unless rounding with an unbounded exponent
+        // would have carried up to it.
+        bool tiny = leading < std::numeric_limits<FLOAT_t>::min_exponent - 1 &&
+                    !(leading == std::numeric_limits<FLOAT_t>::min_exponent - 2 &&
+                      (significand >> (127 - digits)) == ((unsigned __int128)1 << (digits + 1)) - 1);
+        *flags |= Flag::NX | (tiny ? (__uint32_t)Flag::UF : 0);
+    }
+    // A carry out of the significand lands in the exponent field, as it should.
+    Bits<FLOAT_t> bits = ((Bits<FLOAT_t>)(lsb - lowest) << (digits - 1)) + (Bits<FLOAT_t>)kept;
+    Bits<FLOAT_t> infinity = std::bit_cast<Bits<FLOAT_t>>(std::numeric_limits<FLOAT_t>::infinity());
+    if (bits >= infinity) {
+        *flags |= Flag::OF | Flag::NX;
+        bits = infinity;
+    }
+    return std::bit_cast<FLOAT_t>(sign | bits);
+}
+
+template<typename FLOAT_t>
+inline FLOAT_t AddTiesAway(FLOAT_t lhs, FLOAT_t rhs) {
+    FLOAT_t sum = lhs + rhs;
+    if (!std::isfinite(sum) || sum == 0) {
+        return sum;
+    }
+    FLOAT_t rhsPart = sum - lhs;
+    FLOAT_t residual = (lhs - (sum - rhsPart)) + (rhs - rhsPart);
+    return AwayFromTie(sum, residual, (FLOAT_t)1);
+}
+
+template<typename FLOAT_t>
+inline FLOAT_t MulTiesAway(FLOAT_t lhs, FLOAT_t rhs, __uint32_t* flags) {
+    FLOAT_t product = lhs * rhs;
+    if (!std::isfinite(lhs) || !std::isfinite(rhs) || lhs == 0 || rhs == 0 || !std::isfinite(product)) {
+        return product;
+    }
+    if (std::fabs(product) < ResidualFloor<FLOAT_t>) [[unlikely]] {
+        __uint64_t lhsSignificand, rhsSignificand;
+        int lhsExponent, rhsExponent;
+        Decompose(lhs, &lhsSignificand, &lhsExponent);
+        Decompose(rhs, &rhsSignificand, &rhsExponent);
+        return RoundTiesAway<FLOAT_t>(std::signbit(lhs) != std::signbit(rhs),
+                                      (unsigned __int128)lhsSignificand * rhsSignificand,
+                                      lhsExponent + rhsExponent, false, flags);
+    }
+    return AwayFromTie(product, std::fma(lhs, rhs, -product), (FLOAT_t)1);
+}
+
+template<typename FLOAT_t>
+inline FLOAT_t DivTiesAway(FLOAT_t lhs, FLOAT_t rhs, __uint32_t* flags) {
+    FLOAT_t quotient = lhs / rhs;
+    if (!std::isfinite(lhs) || !std::isfinite(rhs) || lhs == 0 || !std::isfinite(quotient)) {
+        return quotient;
+    }
+    if (std::fabs(quotient) < ResidualFloor<FLOAT_t> || std::fabs(lhs) < ResidualFloor<FLOAT_t>) [[unlikely]] {
+        __uint64_t lhsSignificand, rhsSignificand;
+        int lhsExponent, rhsExponent;
+        Decompose(lhs, &lhsSignificand, &lhsExponent);
+        Decompose(rhs, &rhsSignificand, &rhsExponent);
+        int shift = 127 - std::bit_width(lhsSignificand);
+        unsigned __int128 numerator = (unsigned __int128)lhsSignificand << shift;
+        return RoundTiesAway<FLOAT_t>(std::signbit(lhs) != std::signbit(rhs), numerator / rhsSignificand,
+                                      lhsExponent - shift - rhsExponent, numerator % rhsSignificand != 0, flags);
+    }
+    return AwayFromTie(quotient, std::fma(-quotient, rhs, lhs), rhs);
+}
+
+// Soft FMA: the product is exact in 128 bits, and the addend is lined up with
+// it, folding anything shifted out into a sticky bit. Special operands and
+// zero products have no ties, so they go to the host.
+template<typename FLOAT_t>
+inline FLOAT_t FmaTiesAway(FLOAT_t lhs, FLOAT_t rhs, FLOAT_t addend, __uint32_t* flags) {
+    if (!std::isfinite(lhs) || !std::isfinite(rhs) || !std::isfinite(addend) || lhs == 0 || rhs == 0) {
+        return std::fma(lhs, rhs, addend);
+    }
+    if (addend == 0) {
+        return MulTiesAway(lhs, rhs, flags);
+    }
+    __uint64_t lhsSignificand, rhsSignificand, addendSignificand;
+    int lhsExponent, rhsExponent, addendExponent;
+    Decompose(lhs, &lhsSignificand, &lhsExponent);
+    Decompose(rhs, &rhsSignificand, &rhsExponent);
+    Decompose(addend, &addendSignificand, &addendExponent);
+    // Both terms start with their leading bit at 125, leaving room for a carry.
+    unsigned __int128 big = (unsigned __int128)lhsSignificand * rhsSignificand;
+    int bigExponent = lhsExponent + rhsExponent;
+    bool bigNegative = std::signbit(lhs) != std::signbit(rhs);
+    int shift = 126 - BitWidth(big);
+    big <<= shift;
+    bigExponent -= shift;
+    unsigned __int128 small = addendSignificand;
+    int smallExponent = addendExponent;
+    bool smallNegative = std::signbit(addend);
+    shift = 126 - BitWidth(small);
+    small <<= shift;
+    smallExponent -= shift;
+    if (smallExponent > bigExponent || (smallExponent == bigExponent && small > big)) {
+        std::swap(big, small);
+        std::swap(bigExponent, smallExponent);
+        std::swap(bigNegative, smallNegative);
+    }
+    int distance = bigExponent - smallExponent;
+    bool sticky = false;
+    if (distance >= 128) {
+        small = 0;
+        sticky = true;
+    } else if (distance > 0) {
+        sticky = (small & (((unsigned __int128)1 << distance) - 1)) != 0;
+        small >>= distance;
+    }
+    // A sticky fraction on the subtrahend borrows one from the difference.
+    unsigned __int128 sum = bigNegative == smallNegative ? big + small : big - small - sticky;
+    if (sum == 0) {
+        return 0;
+    }
+    return RoundTiesAway<FLOAT_t>(bigNegative, sum, bigExponent, sticky, flags);
+}
+
+// Collects the flags raised by host operations since the last call, in fflags
+// bit order, and clears them on the host.
+inline __uint32_t TakeFlags() {
+#if defined(__SSE2__)
+    __uint32_t mxcsr = _mm_getcsr();
+    _mm_setcsr(mxcsr & ~0x3f);
+    return ((mxcsr & 0x01) ? (__uint32_t)Flag::NV : 0) |
+           ((mxcsr & 0x04) ? (__uint32_t)Flag::DZ : 0) |
+           ((mxcsr & 0x08) ? (__uint32_t)Flag::OF : 0) |
+           ((mxcsr & 0x10) ? (__uint32_t)Flag::UF : 0) |
+           ((mxcsr & 0x20) ? (__uint32_t)Flag::NX : 0);
+#else
+    int raised = std::fetestexcept(FE_ALL_EXCEPT);
+    std::feclearexcept(FE_ALL_EXCEPT);
+    return ((raised & FE_INVALID) ? (__uint32_t)Flag::NV : 0) |
+           ((raised & FE_DIVBYZERO) ? (__uint32_t)Flag::DZ : 0) |
+           ((raised & FE_OVERFLOW) ? (__uint32_t)Flag::OF : 0) |
+           ((raised & FE_UNDERFLOW) ? (__uint32_t)Flag::UF : 0) |
+           ((raised & FE_INEXACT) ? (__uint32_t)Flag::NX : 0);
+#endif
+}
+
+} // namespace HostFloat
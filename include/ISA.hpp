@@ -0,0 +1,55 @@
+#pragma once
+
+/*
+ * Compile-time ISA descriptors. By default HartKit supports whatever misa and
+ * the client's extensions vector say, deciding at run time. A FixedISA fixes
+ * MXLEN and the most a hart can have at compile time instead: the decoder (see
+ * the two-argument decode_instruction) and HartState's trap routing and CSR
+ * handling AND the run-time extensions with the ISA's, so whatever it leaves
+ * out folds away, along with the executors only it would have referenced.
+ *
+ * HartState's ISA is DefaultISA: AnyISA, or whatever HARTKIT_ISA names when
+ * that's defined, e.g.
+ *
+ *     -DHARTKIT_ISA='FixedISA<RISCV::XlenMode::XL32, isa_extensions("IMCU")>'
+ *
+ * for an RV32IMC core with M and U modes. It isn't a template parameter of
+ * HartState, since the executors all take the one HartState<XLEN_t>; defining
+ * HARTKIT_ISA is the only way to fix the ISA.
+ */
+
+#include <cstdint>
+
+#include <RiscV.hpp>
+
+// Extension letters to a misa-style bit vector
+constexpr __uint32_t isa_extensions(const char* letters) {
+    __uint32_t extensions = 0;
+    for (; *letters != '\0'; letters++) {
+        extensions |= (__uint32_t)1 << (*letters - 'A');
+    }
+    return extensions;
+}
+
+struct AnyISA {
+    static constexpr bool Fixed = false;
+    static constexpr __uint32_t extensions = ~(__uint32_t)0;
+};
+
+template<RISCV::XlenMode MXLEN, __uint32_t Extensions>
+struct FixedISA {
+    static constexpr bool Fixed = true;
+    static constexpr RISCV::XlenMode mxlen = MXLEN;
+    static constexpr __uint32_t extensions = Extensions;
+};
+
+template<typename ISA>
+constexpr bool isa_allows(char extension) {
+    return ISA::extensions & ((__uint32_t)1 << (extension - 'A'));
+}
+
+#ifdef HARTKIT_ISA
+using DefaultISA = HARTKIT_ISA;
+#else
+using DefaultISA = AnyISA;
+#endif
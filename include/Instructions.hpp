@@ -5,8 +5,13 @@
 #include <RiscV.hpp>
 
 #include <HartState.hpp>
+#include <HostFloat.hpp>
 #include <Transactor.hpp>
 
+#include <bit>
+#include <cmath>
+#include <functional>
+#include <limits>
 #include <type_traits>
 
 #define RD           ExtendBits::Zero, 11, 7
@@ -17,6 +22,8 @@
 #define B_IMM        ExtendBits::Sign, 31, 31, 7, 7, 30, 25, 11, 8, 1
 #define U_IMM        ExtendBits::Zero, 31, 12, 12
 #define J_IMM        ExtendBits::Sign, 31, 31, 19, 12, 20, 20, 30, 21, 1
+#define RS3          ExtendBits::Zero, 31, 27
+#define FP_RM        ExtendBits::Zero, 14, 12
 
 #define CR_RD_RS1    ExtendBits::Zero, 11, 7
 #define CR_RS2       ExtendBits::Zero, 6, 2
@@ -48,10 +55,72 @@ struct right_shift { constexpr T operator()(const T& lhs, const T& rhs) const {
 template< class T = void >
 struct lhs { constexpr T operator()(const T& lhs, const T& rhs) const { return lhs; } };
 template< class T = void >
+struct rhs { constexpr T operator()(const T& lhs, const T& rhs) const { return rhs; } };
+template< class T = void >
+struct not_rhs { constexpr T operator()(const T& lhs, const T& rhs) const { return ~rhs; } };
+template< class T = void >
 struct min { constexpr T operator()(const T& lhs, const T& rhs) const { return (lhs < rhs) ? lhs : rhs; } };
 template< class T = void >
 struct max { constexpr T operator()(const T& lhs, const T& rhs) const { return (lhs > rhs) ? lhs : rhs; } };
 
+// Bit-manipulation operations. These are written with <bit> and plain
+// operators so that, built with -mbmi -mlzcnt -mpopcnt (or -march=native), each
+// lowers to the matching single host instruction: lzcnt, tzcnt, popcnt, rol,
+// ror, andn, bswap and lea for the shift-adds. Shift and bit-index amounts
+// only use the low log2(width) bits, so immediates can be passed through
+// with their funct bits still attached.
+template< class T = void >
+struct and_not { constexpr T operator()(const T& lhs, const T& rhs) const { return lhs & ~rhs; } };
+template< class T = void >
+struct or_not { constexpr T operator()(const T& lhs, const T& rhs) const { return lhs | ~rhs; } };
+template< class T = void >
+struct xnor { constexpr T operator()(const T& lhs, const T& rhs) const { return ~(lhs ^ rhs); } };
+template< class T = void >
+struct rotate_left { constexpr T operator()(const T& lhs, const T& rhs) const { return std::rotl(lhs, rhs & (sizeof(T)*8 - 1)); } };
+template< class T = void >
+struct rotate_right { constexpr T operator()(const T& lhs, const T& rhs) const { return std::rotr(lhs, rhs & (sizeof(T)*8 - 1)); } };
+template< class T = void >
+struct count_leading_zeros { constexpr T operator()(const T& lhs, const T& rhs) const { return std::countl_zero(lhs); } };
+template< class T = void >
+struct count_trailing_zeros { constexpr T operator()(const T& lhs, const T& rhs) const { return std::countr_zero(lhs); } };
+template< class T = void >
+struct population_count { constexpr T operator()(const T& lhs, const T& rhs) const { return std::popcount(lhs); } };
+template< class T, class FROM_t >
+struct sign_extend { constexpr T operator()(const T& lhs, const T& rhs) const { return (std::make_signed_t<T>)(FROM_t)lhs; } };
+template< class T = void >
+struct zero_extend_half { constexpr T operator()(const T& lhs, const T& rhs) const { return lhs & 0xffff; } };
+template< class T = void >
+struct byte_reverse {
+    constexpr T operator()(const T& lhs, const T& rhs) const {
+        if constexpr (sizeof(T) == 4) return __builtin_bswap32(lhs);
+        else return __builtin_bswap64(lhs);
+    }
+};
+template< class T = void >
+struct or_combine_bytes {
+    constexpr T operator()(const T& lhs, const T& rhs) const {
+        constexpr T low7 = (T)0x7f7f7f7f7f7f7f7f;
+        T high = (((lhs & low7) + low7) | lhs) & ~low7;
+        return (high >> 7) * 0xff;
+    }
+};
+template< class T, unsigned int shamt, bool unsigned_word >
+struct shift_add {
+    constexpr T operator()(const T& lhs, const T& rhs) const {
+        return ((unsigned_word ? (lhs & 0xffffffff) : lhs) << shamt) + rhs;
+    }
+};
+template< class T = void >
+struct shift_left_unsigned_word { constexpr T operator()(const T& lhs, const T& rhs) const { return (lhs & 0xffffffff) << (rhs & (sizeof(T)*8 - 1)); } };
+template< class T = void >
+struct bit_clear { constexpr T operator()(const T& lhs, const T& rhs) const { return lhs & ~((T)1 << (rhs & (sizeof(T)*8 - 1))); } };
+template< class T = void >
+struct bit_set { constexpr T operator()(const T& lhs, const T& rhs) const { return lhs | ((T)1 << (rhs & (sizeof(T)*8 - 1))); } };
+template< class T = void >
+struct bit_invert { constexpr T operator()(const T& lhs, const T& rhs) const { return lhs ^ ((T)1 << (rhs & (sizeof(T)*8 - 1))); } };
+template< class T = void >
+struct bit_extract { constexpr T operator()(const T& lhs, const T& rhs) const { return (lhs >> (rhs & (sizeof(T)*8 - 1))) & 1; } };
+
 // https://ctrpeach.io/posts/cpp20-string-literal-template-parameters/
 template<size_t N>
 struct StringLiteral {
@@ -61,9 +130,31 @@ struct StringLiteral {
     char value[N];
 };
 
+// Compressed encodings are expanded by the decoder into their 32-bit
+// equivalents, but keep 0b01 in the quadrant bits rather than 0b11. Executors
+// that serve both forms step the pc by this instead of a literal 4.
+inline constexpr __uint32_t inst_length(__uint32_t encoding) {
+    return 2 + (encoding & 0b10);
+}
+
+// What an illegal-instruction trap reports in mtval. An expanded compressed
+// encoding isn't what the guest fetched, and a reserved one can't be told
+// apart from an expansion, so anything not in the 32-bit quadrant reports 0,
+// as the spec allows.
+inline constexpr __uint32_t inst_tval(__uint32_t encoding) {
+    return (encoding & 0b11) == 0b11 ? encoding : 0;
+}
+
 template<typename XLEN_t>
 inline void ex_illegal(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+    state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+}
+
+// Patched over a decoded instruction at a debugger breakpoint. It leaves the
+// pc alone, so the hart stops just before the real instruction.
+template<typename XLEN_t>
+inline void ex_breakpoint(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    state->implCallback(HartCallbackArgument::HitBreakpoint);
 }
 
 template<StringLiteral mnemonic>
@@ -128,6 +219,13 @@ inline void print_csr_instr(__uint32_t encoding, std::ostream* out) {
     }
 }
 
+template<StringLiteral mnemonic>
+inline void print_unary_instr(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    *out << mnemonic.value << " " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << std::endl;
+}
+
 template<StringLiteral mnemonic>
 inline void print_just_mnemonic(__uint32_t encoding, std::ostream* out) {
     *out << mnemonic.value << std::endl;
@@ -140,10 +238,15 @@ inline void print_jal(__uint32_t encoding, std::ostream* out) {
     *out << "jal " << RISCV::regName(rd) << ", " << imm << std::endl;
 }
 
+template<typename XLEN_t>
+inline void ex_hint(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    state->pc += inst_length(encoding);
+}
+
 template<typename XLEN_t, typename OperandType, typename Operation, bool rhs_immediate>
 inline void ex_op_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
     if constexpr (sizeof(OperandType) > sizeof(XLEN_t)) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
         return;
     }
     __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
@@ -160,7 +263,7 @@ inline void ex_op_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transac
     }
     state->regs[rd] = rd_value;
     state->regs[0] = 0;
-    state->pc += 4;
+    state->pc += inst_length(encoding);
 }
 
 template<typename XLEN_t, typename ComparisonOp>
@@ -169,7 +272,7 @@ inline void ex_branch_generic(__uint32_t encoding, HartState<XLEN_t> *state, Tra
     __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
     __int32_t imm = swizzle<__uint32_t, B_IMM>(encoding);
     ComparisonOp compare;
-    state->pc += compare(state->regs[rs1], state->regs[rs2]) ? imm : 4;
+    state->pc += compare(state->regs[rs1], state->regs[rs2]) ? (XLEN_t)imm : (XLEN_t)inst_length(encoding);
 }
 
 template<typename XLEN_t, bool add_pc>
@@ -178,14 +281,14 @@ inline void ex_upper_immediate_generic(__uint32_t encoding, HartState<XLEN_t> *s
     __uint32_t imm = swizzle<__uint32_t, U_IMM>(encoding);
     state->regs[rd] = (add_pc ? state->pc : 0) + imm;
     state->regs[0] = 0;
-    state->pc += 4;
+    state->pc += inst_length(encoding);
 }
 
 template<typename XLEN_t>
 inline void ex_jal(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
     __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
     __int32_t imm = swizzle<__uint32_t, J_IMM>(encoding);
-    state->regs[rd] = state->pc + 4;
+    state->regs[rd] = state->pc + inst_length(encoding);
     state->regs[0] = 0;
     state->pc = state->pc + imm;
 }
@@ -197,17 +300,17 @@ inline void ex_jalr(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XL
     __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
     __int32_t imm = (__int32_t)swizzle<__uint32_t, ExtendBits::Sign, I_IMM>(encoding);
     SXLEN_t imm_value = imm;
-    imm_value &= ~(XLEN_t)1;
-    state->regs[rd] = state->pc + 4;
+    XLEN_t target = (state->regs[rs1] + imm_value) & ~(XLEN_t)1;
+    state->regs[rd] = state->pc + inst_length(encoding);
     state->regs[0] = 0;
-    state->pc = state->regs[rs1] + imm_value;
+    state->pc = target;
 }
 
 // TODO endianness-agnostic impl; for now host and RV being both LE save us
 template<typename XLEN_t, typename MEM_TYPE_t, bool ignore_immediate>
 inline void ex_load_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
     if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
         return;
     }
     __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
@@ -224,13 +327,13 @@ inline void ex_load_generic(__uint32_t encoding, HartState<XLEN_t> *state, Trans
     }
     state->regs[rd] = read_value;
     state->regs[0] = 0;
-    state->pc += 4;
+    state->pc += inst_length(encoding);
 }
 
 template<typename XLEN_t, typename MEM_TYPE_t>
 inline void ex_store_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
     if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
         return;
     }
     __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
@@ -243,30 +346,67 @@ inline void ex_store_generic(__uint32_t encoding, HartState<XLEN_t> *state, Tran
         state->RaiseException(transaction.trapCause, write_addr);
         return;
     }
+    state->pc += inst_length(encoding);
+}
+
+template<typename XLEN_t, typename MEM_TYPE_t>
+inline void ex_lr(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    MEM_TYPE_t read_value;
+    XLEN_t read_address = state->regs[rs1];
+    Transaction<XLEN_t> transaction = mem->Read(read_address, sizeof(MEM_TYPE_t), (char*)&read_value);
+    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(MEM_TYPE_t)) {
+        state->RaiseException(transaction.trapCause, read_address);
+        return;
+    }
+    state->reservation = read_address;
+    state->reserved = true;
+    state->regs[rd] = read_value;
+    state->regs[0] = 0;
     state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_scw(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+// Succeeds only with a reservation on the same address, and uses it up either
+// way. Failures call back, so a scheduler can let whoever holds the lock run.
+template<typename XLEN_t, typename MEM_TYPE_t>
+inline void ex_sc(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
     __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
     __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
     __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
-    XLEN_t tmp = state->regs[rs2];
     XLEN_t write_address = state->regs[rs1];
-    XLEN_t write_size = 4;
-    Transaction<XLEN_t> transaction = mem->Write(write_address, write_size, (char*)&tmp);
-    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != write_size) {
+    bool reserved = state->reserved && state->reservation == write_address;
+    state->reserved = false;
+    if (!reserved) {
+        state->regs[rd] = 1;
+        state->regs[0] = 0;
+        state->pc += 4;
+        state->implCallback(HartCallbackArgument::FailedStoreConditional);
+        return;
+    }
+    MEM_TYPE_t write_value = state->regs[rs2] & (MEM_TYPE_t)~0;
+    Transaction<XLEN_t> transaction = mem->Write(write_address, sizeof(MEM_TYPE_t), (char*)&write_value);
+    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(MEM_TYPE_t)) {
         state->RaiseException(transaction.trapCause, write_address);
         return;
     }
-    state->regs[rd] = 0; // NOTE, zero means sc succeeded - for now it always does!
+    state->regs[rd] = 0;
+    state->regs[0] = 0;
     state->pc += 4;
 }
 
 template<typename XLEN_t, typename MEM_TYPE_t, typename Operation>
 inline void ex_amo_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
     if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
         return;
     }
     __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
@@ -315,8 +455,8 @@ inline void ex_ebreak(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<
 template<typename XLEN_t, bool sets_bits, bool clears_bits, bool rs1_is_immediate>
 inline void ex_csr_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
     RISCV::CSRAddress csr = (RISCV::CSRAddress)swizzle<__uint32_t, ExtendBits::Zero, I_IMM>(encoding);
-    if (state->privilegeMode < RISCV::csrRequiredPrivilege(csr)) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+    if (state->privilegeMode < RISCV::csrRequiredPrivilege(csr) || !state->CSREnabled(csr)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
         return;
     }
     __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
@@ -334,7 +474,7 @@ inline void ex_csr_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transa
     if constexpr (clears_bits) csrValue = ~csrValue & regVal;
     if (write_required) {
         if (RISCV::csrIsReadOnly(csr)) {
-            state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+            state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
             return;
         }
         state->WriteCSR(csr, regVal);
@@ -344,7 +484,20 @@ inline void ex_csr_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transa
 
 template<typename XLEN_t>
 inline void ex_wfi(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    state->pc += 4; // NOP for now. TODO something smarter with the hart's interrupt pins
+    // With mstatus.TW set, below M-mode, WFI would wait forever as far as the
+    // hart is concerned, so it traps straight away
+    if (state->mstatus.tw && state->privilegeMode < RISCV::PrivilegeMode::Machine) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    state->pc += 4;
+    // Any locally enabled pending interrupt wakes the hart, even one that is
+    // globally disabled. Otherwise, let the client skip ahead to the next event.
+    XLEN_t pending = state->mip.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>() &
+                     state->mie.template Read<XLEN_t, RISCV::PrivilegeMode::Machine>();
+    if (pending == 0) {
+        state->implCallback(HartCallbackArgument::WaitingForInterrupt);
+    }
 }
 
 // TODO URET is only provided if user-mode traps are supported, and should raise an illegal encodingruction otherwise.
@@ -354,7 +507,7 @@ inline void ex_wfi(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLE
 template<typename XLEN_t, RISCV::PrivilegeMode from_mode>
 inline void ex_trap_return(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
     if (state->privilegeMode < from_mode) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
         return;
     }
     state->template ReturnFromTrap<from_mode>();
@@ -366,467 +519,433 @@ inline void ex_sfencevma(__uint32_t encoding, HartState<XLEN_t> *state, Transact
     state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_caddi4spn(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CIW_RDX>(encoding)+8;
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Zero, 10, 7, 12, 11, 5, 5, 6, 6, 2>(encoding);
-    state->regs[rd] = state->regs[2] + imm;
-    state->regs[0] = 0;
-    state->pc += 2;
+template<typename T>
+inline constexpr const char* type_letters() {
+    if constexpr (std::is_same_v<T, float>) return "s";
+    else if constexpr (std::is_same_v<T, double>) return "d";
+    else if constexpr (std::is_same_v<T, __int32_t>) return "w";
+    else if constexpr (std::is_same_v<T, __uint32_t>) return "wu";
+    else if constexpr (std::is_same_v<T, __int64_t>) return "l";
+    else return "lu";
 }
 
-template<typename XLEN_t>
-inline void print_caddi4spn(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CIW_RDX>(encoding)+8;
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Zero, 10, 7, 12, 11, 5, 5, 6, 6, 2>(encoding);
-    *out << "(C.ADDI4SPN) addi " << RISCV::regName(rd) << ", " << RISCV::regName(2) << ", " << imm << std::endl;
+template<StringLiteral mnemonic, typename FLOAT_t, unsigned int num_sources>
+inline void print_fp_instr(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    __uint32_t rs3 = swizzle<__uint32_t, RS3>(encoding);
+    *out << mnemonic.value << "." << type_letters<FLOAT_t>() << " f" << rd << ", f" << rs1;
+    if constexpr (num_sources > 1) *out << ", f" << rs2;
+    if constexpr (num_sources > 2) *out << ", f" << rs3;
+    *out << std::endl;
 }
 
-// TODO maybe combine cl and cs ?
-template<typename XLEN_t, typename MEM_TYPE_t>
-inline void ex_cl_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    if constexpr (sizeof(MEM_TYPE_t) > sizeof(XLEN_t)) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
-        return;
-    }
-    __uint32_t rd = swizzle<__uint32_t, CL_RDX>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CL_RS1X>(encoding)+8;
-    __int32_t imm;
-    if constexpr (sizeof(MEM_TYPE_t) >= 16) imm = swizzle<__uint32_t, ExtendBits::Zero, 10, 10, 5, 6, 12, 11, 4>(encoding);
-    else if constexpr (sizeof(MEM_TYPE_t) >= 8) imm = swizzle<__uint32_t, ExtendBits::Zero, 6, 5, 12, 10, 3>(encoding);
-    else imm = swizzle<__uint32_t, ExtendBits::Zero, 5, 5, 12, 10, 6, 6, 2>(encoding);
-    MEM_TYPE_t mem_value;
-    XLEN_t read_address = state->regs[rs1] + imm;
-    Transaction<XLEN_t> transaction = mem->Read(read_address, sizeof(MEM_TYPE_t), (char*)&mem_value);
-    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(MEM_TYPE_t)) {
-        state->RaiseException(transaction.trapCause, read_address);
-        return;
-    }
-    state->regs[rd] = mem_value;
-    state->regs[0] = 0;
-    state->pc += 2;
+template<StringLiteral mnemonic, typename FLOAT_t>
+inline void print_fp_compare_instr(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    *out << mnemonic.value << "." << type_letters<FLOAT_t>() << " " << RISCV::regName(rd) << ", f" << rs1 << ", f" << rs2 << std::endl;
 }
 
-template<typename XLEN_t, typename MEM_TYPE_t, StringLiteral mnemonic>
-inline void print_cl_generic(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CL_RDX>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CL_RS1X>(encoding)+8;
-    __int32_t imm;
-    if constexpr (sizeof(MEM_TYPE_t) >= 16) imm = swizzle<__uint32_t, ExtendBits::Zero, 10, 10, 5, 6, 12, 11, 4>(encoding);
-    else if constexpr (sizeof(MEM_TYPE_t) >= 8) imm = swizzle<__uint32_t, ExtendBits::Zero, 6, 5, 12, 10, 3>(encoding);
-    else imm = swizzle<__uint32_t, ExtendBits::Zero, 5, 5, 12, 10, 6, 6, 2>(encoding);
-    *out << mnemonic.value << " " << RISCV::regName(rd) << ",(" << imm << ")" << RISCV::regName(rs1) << std::endl;
+template<typename TO_t, typename FROM_t>
+inline void print_fcvt(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    *out << "fcvt." << type_letters<TO_t>() << "." << type_letters<FROM_t>() << " ";
+    if constexpr (std::is_floating_point_v<TO_t>) *out << "f" << rd; else *out << RISCV::regName(rd);
+    *out << ", ";
+    if constexpr (std::is_floating_point_v<FROM_t>) *out << "f" << rs1; else *out << RISCV::regName(rs1);
+    *out << std::endl;
 }
 
-template<typename XLEN_t, typename MEM_TYPE_t>
-inline void ex_cs_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    if constexpr (sizeof(MEM_TYPE_t) > sizeof(XLEN_t)) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
-        return;
-    }
-    __uint32_t rs1 = swizzle<__uint32_t, CS_RS1X>(encoding)+8;
-    __uint32_t rs2 = swizzle<__uint32_t, CS_RS2X>(encoding)+8;
-    __int32_t imm;
-    if constexpr (sizeof(MEM_TYPE_t) >= 16) imm = swizzle<__uint32_t, ExtendBits::Zero, 10, 10, 5, 6, 12, 11, 4>(encoding);
-    else if constexpr (sizeof(MEM_TYPE_t) >= 8) imm = swizzle<__uint32_t, ExtendBits::Zero, 6, 5, 12, 10, 3>(encoding);
-    else imm = swizzle<__uint32_t, ExtendBits::Zero, 5, 5, 12, 10, 6, 6, 2>(encoding);
-    XLEN_t write_addr = state->regs[rs1] + imm;
-    Transaction<XLEN_t> transaction = mem->Write(write_addr, sizeof(MEM_TYPE_t), (char*)&state->regs[rs2]);
-    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(MEM_TYPE_t)) {
-        state->RaiseException(transaction.trapCause, write_addr);
-        return;
+template<StringLiteral mnemonic, bool rd_is_float>
+inline void print_fp_move_instr(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    if constexpr (rd_is_float) {
+        *out << mnemonic.value << " f" << rd << ", " << RISCV::regName(rs1) << std::endl;
+    } else {
+        *out << mnemonic.value << " " << RISCV::regName(rd) << ", f" << rs1 << std::endl;
     }
-    state->pc += 2;
-}
-
-template<typename XLEN_t, typename MEM_TYPE_t, StringLiteral mnemonic>
-inline void print_cs_generic(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rs1 = swizzle<__uint32_t, CS_RS1X>(encoding)+8;
-    __uint32_t rs2 = swizzle<__uint32_t, CS_RS2X>(encoding)+8;
-    __int32_t imm;
-    if constexpr (sizeof(MEM_TYPE_t) >= 16) imm = swizzle<__uint32_t, ExtendBits::Zero, 10, 10, 5, 6, 12, 11, 4>(encoding);
-    else if constexpr (sizeof(MEM_TYPE_t) >= 8) imm = swizzle<__uint32_t, ExtendBits::Zero, 6, 5, 12, 10, 3>(encoding);
-    else imm = swizzle<__uint32_t, ExtendBits::Zero, 5, 5, 12, 10, 6, 6, 2>(encoding);
-    *out << mnemonic.value << " " << RISCV::regName(rs2) << ",(" << imm << ")" << RISCV::regName(rs1) << std::endl;
-}
-
-template<typename XLEN_t>
-inline void ex_caddi(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __uint32_t rs1 = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __int32_t imm = (__int32_t)swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 2>(encoding);
-    XLEN_t rs1_value = state->regs[rs1];
-    XLEN_t rd_value = rs1_value + imm;
-    state->regs[rd] = rd_value;
-    state->regs[0] = 0;
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_caddi(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __uint32_t rs1 = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __int32_t imm = (__int32_t)swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 2>(encoding);
-    *out << "(C.ADDI) addi " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << imm << std::endl;
-}
-
-template<typename XLEN_t>
-inline void ex_caddi16sp(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __int32_t imm = (__int32_t)swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 4, 3, 5, 5, 2, 2, 6, 6, 4>(encoding);
-    state->regs[2] += imm;
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_caddi16sp(__uint32_t encoding, std::ostream* out) {
-    __int32_t imm = (__int32_t)swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 4, 3, 5, 5, 2, 2, 6, 6, 4>(encoding);
-    *out << "(C.ADDI16SP) addi " << RISCV::regName(2) << ", " << RISCV::regName(2) << ", " << imm << std::endl;
-}
-
-template<typename XLEN_t>
-inline void ex_cjal(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 8, 8, 10, 9, 6, 6, 7, 7, 2, 2, 11, 11, 5, 3, 1>(encoding);
-    state->regs[1] = state->pc + 2;
-    state->pc += imm;
-}
-
-template<typename XLEN_t>
-inline void print_cjal(__uint32_t encoding, std::ostream* out) {
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 8, 8, 10, 9, 6, 6, 7, 7, 2, 2, 11, 11, 5, 3, 1>(encoding);
-    *out << "(C.JAL) jal " << RISCV::regName(1) << ", " << imm << std::endl;
-}
-
-template<typename XLEN_t>
-inline void ex_cli(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 2>(encoding);
-    state->regs[rd] = imm;
-    state->regs[0] = 0;
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_cli(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 2>(encoding);
-    *out << "(C.LI) addi " << RISCV::regName(rd) << ", " << RISCV::regName(0) << ", " << imm << std::endl;
-}
-
-template<typename XLEN_t>
-inline void ex_clui(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __uint32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 2, 12>(encoding);
-    state->regs[rd] = imm;
-    state->regs[0] = 0;
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_clui(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __uint32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 2, 12>(encoding);
-    *out << "(C.LUI) lui " << RISCV::regName(rd) << ", " << (imm >> 12) << std::endl;
-}
-
-template<typename XLEN_t, typename Operation>
-inline void ex_ca_format_op(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CA_RDX_RS1X>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CA_RDX_RS1X>(encoding)+8;
-    __uint32_t rs2 = swizzle<__uint32_t, CA_RS2X>(encoding)+8;
-    Operation operation;
-    state->regs[rd] = operation(state->regs[rs1], state->regs[rs2]);
-    state->regs[0] = 0;
-    state->pc += 2;
-}
-
-template<StringLiteral mnemonic>
-inline void print_ca_format_instr(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CA_RDX_RS1X>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CA_RDX_RS1X>(encoding)+8;
-    __uint32_t rs2 = swizzle<__uint32_t, CA_RS2X>(encoding)+8;
-    *out << mnemonic.value << " " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << RISCV::regName(rs2) << std::endl;
-}
-
-template<typename XLEN_t>
-inline void ex_cj(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 8, 8, 10, 9, 6, 6, 7, 7, 2, 2, 11, 11, 5, 3, 1>(encoding);
-    __uint32_t rd = 0;
-    state->regs[rd] = state->pc + 2;
-    state->regs[0] = 0;
-    state->pc += imm;
-}
-
-template<typename XLEN_t>
-inline void print_cj(__uint32_t encoding, std::ostream* out) {
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 8, 8, 10, 9, 6, 6, 7, 7, 2, 2, 11, 11, 5, 3, 1>(encoding);
-    __uint32_t rd = 0;
-    *out << "(C.J) jal " << RISCV::regName(rd) << ", " << imm << std::endl;
 }
 
-template<typename XLEN_t>
-inline void ex_cbeqz(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 5, 2, 2, 11, 10, 4, 3, 1>(encoding);
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    state->pc += state->regs[rs1] ? 2 : imm;
-}
-
-template<typename XLEN_t>
-inline void print_cbeqz(__uint32_t encoding, std::ostream* out) {
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 5, 2, 2, 11, 10, 4, 3, 1>(encoding);
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    *out << "(C.BEQZ) beq " << RISCV::regName(rs1) << ", " << RISCV::regName(0) << ", " << imm << std::endl;
-}
-
-template<typename XLEN_t>
-inline void ex_cbnez(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 5, 2, 2, 11, 10, 4, 3, 1>(encoding);
-    state->pc += state->regs[rs1] ? imm : 2;
+template<typename FLOAT_t>
+inline void print_fp_load_instr(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, I_IMM>(encoding);
+    *out << "fl" << (sizeof(FLOAT_t) == 4 ? "w" : "d") << " f" << rd << ",(" << imm << ")" << RISCV::regName(rs1) << std::endl;
 }
 
-template<typename XLEN_t>
-inline void print_cbnez(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 6, 5, 2, 2, 11, 10, 4, 3, 1>(encoding);
-    *out << "(C.BNEZ) bne " << RISCV::regName(rs1) << ", " << RISCV::regName(0) << ", " << imm << std::endl;
+template<typename FLOAT_t>
+inline void print_fp_store_instr(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    __int32_t imm = swizzle<__uint32_t, S_IMM>(encoding);
+    *out << "fs" << (sizeof(FLOAT_t) == 4 ? "w" : "d") << " f" << rs2 << ",(" << imm << ")" << RISCV::regName(rs1) << std::endl;
 }
 
+// Resolves the instruction's rm field against frm and loads it into the host
+// FPU if it isn't already there. Returns false for reserved rounding modes.
+// Under RMM the host runs in RNE, and the executor moves ties away from zero.
 template<typename XLEN_t>
-inline void ex_candi(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    typedef std::make_signed_t<XLEN_t> SXLEN_t;
-    __uint32_t rd = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __int32_t imm = swizzle<__int32_t, ExtendBits::Sign, 12, 12, 6, 2>(encoding);
-    XLEN_t rs1_value = state->regs[rs1];
-    SXLEN_t imm_value_signed = imm;
-    XLEN_t imm_value = *(XLEN_t*)&imm_value_signed;
-    XLEN_t rd_value = rs1_value & imm_value;
-    state->regs[rd] = rd_value;
-    state->regs[0] = 0;
-    state->pc += 2;
+inline bool fp_use_rounding_mode(__uint32_t encoding, HartState<XLEN_t> *state) {
+    __uint32_t rm = swizzle<__uint32_t, FP_RM>(encoding);
+    if (rm == HostFloat::RoundingMode::DYN) {
+        rm = state->frm;
+    }
+    return HostFloat::UseRoundingMode(rm);
 }
 
+// Every F and D instruction is illegal while mstatus.FS is Off.
 template<typename XLEN_t>
-inline void print_candi(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __int32_t imm = swizzle<__int32_t, ExtendBits::Sign, 12, 12, 6, 2>(encoding);
-    *out << "(C.ANDI) andi " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << imm << std::endl;
+inline bool fp_enabled(__uint32_t encoding, HartState<XLEN_t> *state) {
+    if (!state->FloatEnabled()) [[unlikely]] {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return false;
+    }
+    return true;
 }
 
-template<typename XLEN_t>
-inline void ex_clwsp(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    typedef std::make_signed_t<XLEN_t> SXLEN_t;
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __uint32_t rs1 = 2;
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Zero, 3, 2, 12, 12, 6, 4, 2>(encoding);
-    __uint32_t word;
-    XLEN_t rs1_value = state->regs[rs1];
-    SXLEN_t imm_value = imm;
-    XLEN_t read_address = rs1_value + imm_value;
-    XLEN_t read_size = 4;
-    Transaction<XLEN_t> transaction = mem->Read(read_address, read_size, (char*)&word);
-    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != read_size) {
+template<typename XLEN_t, typename FLOAT_t>
+inline void ex_fp_load_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __int32_t imm = swizzle<__uint32_t, ExtendBits::Sign, I_IMM>(encoding);
+    HostFloat::Bits<FLOAT_t> read_value;
+    XLEN_t read_address = state->regs[rs1] + imm;
+    Transaction<XLEN_t> transaction = mem->Read(read_address, sizeof(FLOAT_t), (char*)&read_value);
+    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(FLOAT_t)) {
         state->RaiseException(transaction.trapCause, read_address);
         return;
     }
-    state->regs[rd] = word;
-    state->regs[0] = 0;
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_clwsp(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Zero, 3, 2, 12, 12, 6, 4, 2>(encoding);
-    *out << "(C.LWSP) lw " << RISCV::regName(rd) << ",(" << imm << ")" << RISCV::regName(2) << std::endl;
+    state->template WriteFloatBits<FLOAT_t>(rd, read_value);
+    state->pc += inst_length(encoding);
 }
 
-template<typename XLEN_t, typename MEM_TYPE_t>
-inline void ex_cs_sp(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    if constexpr (sizeof(XLEN_t) < sizeof(MEM_TYPE_t)) {
-        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, encoding);
+template<typename XLEN_t, typename FLOAT_t>
+inline void ex_fp_store_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
         return;
     }
-    __uint32_t rs2 = swizzle<__uint32_t, CSS_RS2>(encoding);
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Zero, 8, 7, 12, 9, 2>(encoding);
-    XLEN_t write_addr = state->regs[2] + imm;
-    MEM_TYPE_t write_value = state->regs[rs2] & ~(MEM_TYPE_t)0;
-    Transaction<XLEN_t> transaction = mem->Write(write_addr, sizeof(MEM_TYPE_t), (char*)&write_value);
-    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(MEM_TYPE_t)) {
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    __int32_t imm = swizzle<__uint32_t, S_IMM>(encoding);
+    XLEN_t write_addr = state->regs[rs1] + imm;
+    HostFloat::Bits<FLOAT_t> write_value = state->fregs[rs2];
+    Transaction<XLEN_t> transaction = mem->Write(write_addr, sizeof(FLOAT_t), (char*)&write_value);
+    if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(FLOAT_t)) {
         state->RaiseException(transaction.trapCause, write_addr);
         return;
     }
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_cswsp(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rs1 = 2;
-    __uint32_t rs2 = swizzle<__uint32_t, CSS_RS2>(encoding);
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Zero, 8, 7, 12, 9, 2>(encoding);
-    *out << "(C.SWSP) sw " << RISCV::regName(rs2) << ",(" << imm << ")" << RISCV::regName(rs1) << std::endl;
+    state->pc += inst_length(encoding);
 }
 
-template<typename XLEN_t>
-inline void print_csdsp(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rs1 = 2;
-    __uint32_t rs2 = swizzle<__uint32_t, CSS_RS2>(encoding);
-    __int32_t imm = swizzle<__uint32_t, ExtendBits::Zero, 8, 7, 12, 9, 2>(encoding);
-    *out << "(C.SDSP) sw " << RISCV::regName(rs2) << ",(" << imm << ")" << RISCV::regName(rs1) << std::endl;
+template<typename XLEN_t, typename FLOAT_t, typename Operation>
+inline void ex_fp_op_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    if (!fp_use_rounding_mode(encoding, state)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    FLOAT_t lhs = state->template ReadFloat<FLOAT_t>(rs1);
+    FLOAT_t rhs = state->template ReadFloat<FLOAT_t>(rs2);
+    FLOAT_t result;
+    if (HostFloat::loadedRoundingMode == HostFloat::RoundingMode::RMM) [[unlikely]] {
+        if constexpr (std::is_same_v<Operation, std::plus<FLOAT_t>>) {
+            result = HostFloat::AddTiesAway(lhs, rhs);
+        } else if constexpr (std::is_same_v<Operation, std::minus<FLOAT_t>>) {
+            result = HostFloat::AddTiesAway(lhs, -rhs);
+        } else if constexpr (std::is_same_v<Operation, std::multiplies<FLOAT_t>>) {
+            result = HostFloat::MulTiesAway(lhs, rhs, &state->fflags);
+        } else {
+            static_assert(std::is_same_v<Operation, std::divides<FLOAT_t>>);
+            result = HostFloat::DivTiesAway(lhs, rhs, &state->fflags);
+        }
+    } else {
+        Operation operation;
+        result = operation(lhs, rhs);
+    }
+    state->template WriteFloat<FLOAT_t>(rd, result);
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_cjalr(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    typedef std::make_signed_t<XLEN_t> SXLEN_t;
-    __int32_t imm = 0;
-    __uint32_t rd = 1;
-    __uint32_t rs1 = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    XLEN_t rs1_value = state->regs[rs1];
-    SXLEN_t imm_value = imm;
-    imm_value &= ~(XLEN_t)1;
-    state->regs[rd] = state->pc + 2;
-    state->regs[0] = 0;
-    state->pc = rs1_value + imm_value;
+template<typename XLEN_t, typename FLOAT_t>
+inline void ex_fp_sqrt(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    // A square root is never exactly halfway between two floats, so RMM rounds
+    // just as RNE does.
+    if (!fp_use_rounding_mode(encoding, state)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    state->template WriteFloat<FLOAT_t>(rd, std::sqrt(state->template ReadFloat<FLOAT_t>(rs1)));
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void print_cjalr(__uint32_t encoding, std::ostream* out) {
-    __int32_t imm = 0;
-    __uint32_t rd = 1;
-    __uint32_t rs1 = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    *out << "(C.JALR) jalr " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << imm << std::endl;
+// Negating the product and addend before the fused op is exact, so all four
+// R4-type instructions map onto one host FMA.
+template<typename XLEN_t, typename FLOAT_t, bool negate_product, bool negate_addend>
+inline void ex_fp_fma_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    if (!fp_use_rounding_mode(encoding, state)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    __uint32_t rs3 = swizzle<__uint32_t, RS3>(encoding);
+    FLOAT_t lhs = state->template ReadFloat<FLOAT_t>(rs1);
+    FLOAT_t rhs = state->template ReadFloat<FLOAT_t>(rs2);
+    FLOAT_t addend = state->template ReadFloat<FLOAT_t>(rs3);
+    if constexpr (negate_product) lhs = -lhs;
+    if constexpr (negate_addend) addend = -addend;
+    if (HostFloat::loadedRoundingMode == HostFloat::RoundingMode::RMM) [[unlikely]] {
+        state->template WriteFloat<FLOAT_t>(rd, HostFloat::FmaTiesAway(lhs, rhs, addend, &state->fflags));
+    } else {
+        state->template WriteFloat<FLOAT_t>(rd, std::fma(lhs, rhs, addend));
+    }
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_cjr(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    typedef std::make_signed_t<XLEN_t> SXLEN_t;
-    __uint32_t rs1 = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __int32_t imm = 0;
-    __uint32_t rd = 0;
-    XLEN_t rs1_value = state->regs[rs1];
-    SXLEN_t imm_value = imm;
-    imm_value &= ~(XLEN_t)1;
-    state->regs[rd] = state->pc + 2;
-    state->regs[0] = 0;
-    state->pc = rs1_value + imm_value;
+// Sign injection works on raw bits and never raises flags. The three flavours
+// take the sign from rs2, its inverse, or its xor with rs1's sign.
+template<typename XLEN_t, typename FLOAT_t, typename SignOperation>
+inline void ex_fp_sgnj_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    constexpr HostFloat::Bits<FLOAT_t> sign_mask = (HostFloat::Bits<FLOAT_t>)1 << (sizeof(FLOAT_t)*8-1);
+    HostFloat::Bits<FLOAT_t> lhs = state->template ReadFloatBits<FLOAT_t>(rs1);
+    HostFloat::Bits<FLOAT_t> rhs = state->template ReadFloatBits<FLOAT_t>(rs2);
+    SignOperation operation;
+    HostFloat::Bits<FLOAT_t> sign = operation(lhs, rhs) & sign_mask;
+    state->template WriteFloatBits<FLOAT_t>(rd, (lhs & ~sign_mask) | sign);
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void print_cjr(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rs1 = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __int32_t imm = 0;
-    __uint32_t rd = 0;
-    *out << "(C.JR) jalr " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << imm << std::endl;
+template<typename XLEN_t, typename FLOAT_t, bool is_max>
+inline void ex_fp_minmax_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    FLOAT_t lhs = state->template ReadFloat<FLOAT_t>(rs1);
+    FLOAT_t rhs = state->template ReadFloat<FLOAT_t>(rs2);
+    if (HostFloat::IsSignalingNaN(lhs) || HostFloat::IsSignalingNaN(rhs)) {
+        state->fflags |= HostFloat::Flag::NV;
+        state->DirtyFloat();
+    }
+    FLOAT_t result;
+    if (std::isnan(lhs)) {
+        result = rhs; // Canonical NaN if both are NaN, by way of WriteFloat
+    } else if (std::isnan(rhs)) {
+        result = lhs;
+    } else if (lhs == rhs) {
+        // Only distinguishes -0.0 from +0.0
+        result = (std::signbit(lhs) != is_max) ? lhs : rhs;
+    } else {
+        result = ((lhs < rhs) != is_max) ? lhs : rhs;
+    }
+    state->template WriteFloat<FLOAT_t>(rd, result);
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_cadd(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CR_RD_RS1>(encoding);
-    __uint32_t rs1 = swizzle<__uint32_t, CR_RD_RS1>(encoding);
-    __uint32_t rs2 = swizzle<__uint32_t, CR_RS2>(encoding);
-    XLEN_t rs1_value = state->regs[rs1];
-    XLEN_t rs2_value = state->regs[rs2];
-    XLEN_t rd_value = rs1_value + rs2_value;
-    state->regs[rd] = rd_value;
+// FEQ is a quiet comparison, while FLT and FLE signal on any NaN operand.
+template<typename XLEN_t, typename FLOAT_t, typename ComparisonOp, bool signaling>
+inline void ex_fp_compare_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    FLOAT_t lhs = state->template ReadFloat<FLOAT_t>(rs1);
+    FLOAT_t rhs = state->template ReadFloat<FLOAT_t>(rs2);
+    if (std::isnan(lhs) || std::isnan(rhs)) {
+        if (signaling || HostFloat::IsSignalingNaN(lhs) || HostFloat::IsSignalingNaN(rhs)) {
+            state->fflags |= HostFloat::Flag::NV;
+            state->DirtyFloat();
+        }
+        state->regs[rd] = 0;
+    } else {
+        ComparisonOp compare;
+        state->regs[rd] = compare(lhs, rhs);
+    }
     state->regs[0] = 0;
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_cadd(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CR_RD_RS1>(encoding);
-    __uint32_t rs1 = swizzle<__uint32_t, CR_RD_RS1>(encoding);
-    __uint32_t rs2 = swizzle<__uint32_t, CR_RS2>(encoding);
-    *out << "(C.ADD) add " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << RISCV::regName(rs2) << std::endl;
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_cmv(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CR_RD_RS1>(encoding);
-    __uint32_t rs2 = swizzle<__uint32_t, CR_RS2>(encoding);
-    state->regs[rd] = state->regs[rs2];
+// The host conversion instructions don't saturate the way RISC-V requires, so
+// round in the current mode first and range-check the result ourselves.
+template<typename XLEN_t, typename FLOAT_t, typename INT_t>
+inline void ex_fp_to_int(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    if constexpr (sizeof(INT_t) > sizeof(XLEN_t)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    if (!fp_use_rounding_mode(encoding, state)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    FLOAT_t value = state->template ReadFloat<FLOAT_t>(rs1);
+    FLOAT_t rounded = HostFloat::loadedRoundingMode == HostFloat::RoundingMode::RMM ? std::round(value) : std::nearbyint(value);
+    constexpr FLOAT_t lower = std::is_signed_v<INT_t> ? (FLOAT_t)std::numeric_limits<INT_t>::min() : 0;
+    constexpr FLOAT_t upper = (FLOAT_t)2 * (FLOAT_t)(std::numeric_limits<INT_t>::max() / 2 + 1);
+    INT_t result;
+    if (std::isnan(value) || rounded >= upper) {
+        state->fflags |= HostFloat::Flag::NV;
+        state->DirtyFloat();
+        result = std::numeric_limits<INT_t>::max();
+    } else if (rounded < lower) {
+        state->fflags |= HostFloat::Flag::NV;
+        state->DirtyFloat();
+        result = std::numeric_limits<INT_t>::min();
+    } else {
+        result = (INT_t)rounded;
+        if (rounded != value) {
+            state->fflags |= HostFloat::Flag::NX;
+            state->DirtyFloat();
+        }
+    }
+    // Even the unsigned 32-bit results are sign extended into rd
+    state->regs[rd] = (std::make_signed_t<XLEN_t>)(std::make_signed_t<INT_t>)result;
     state->regs[0] = 0;
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_cmv(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CR_RD_RS1>(encoding);
-    __uint32_t rs1 = 0;
-    __uint32_t rs2 = swizzle<__uint32_t, CR_RS2>(encoding);
-    *out << "(C.MV) add " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << RISCV::regName(rs2) << std::endl;
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_cslli(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t imm = swizzle<__uint32_t, CI_SHAMT>(encoding);
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __uint32_t rs1 = rd;
-    if constexpr (sizeof(XLEN_t) == 16) imm = imm == 0 ? 64 : imm;
-    XLEN_t rs1_value = state->regs[rs1];
-    XLEN_t rd_value = rs1_value << imm;
-    state->regs[rd] = rd_value;
-    state->regs[0] = 0;
-    state->pc += 2;
+template<typename XLEN_t, typename FLOAT_t, typename INT_t>
+inline void ex_int_to_fp(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    if constexpr (sizeof(INT_t) > sizeof(XLEN_t)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    if (!fp_use_rounding_mode(encoding, state)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    INT_t value = (INT_t)state->regs[rs1];
+    if (HostFloat::loadedRoundingMode == HostFloat::RoundingMode::RMM) {
+        state->template WriteFloat<FLOAT_t>(rd, HostFloat::ConvertTiesAway<FLOAT_t>(value, &state->fflags));
+    } else {
+        state->template WriteFloat<FLOAT_t>(rd, (FLOAT_t)value);
+    }
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void print_cslli(__uint32_t encoding, std::ostream* out) {
-    __uint32_t imm = swizzle<__uint32_t, CI_SHAMT>(encoding);
-    __uint32_t rd = swizzle<__uint32_t, CI_RD_RS1>(encoding);
-    __uint32_t rs1 = rd;
-    *out << "(C.SLLI) slli " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << imm << std::endl;
+template<typename XLEN_t, typename TO_t, typename FROM_t>
+inline void ex_fp_convert(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    if (!fp_use_rounding_mode(encoding, state)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    FROM_t value = state->template ReadFloat<FROM_t>(rs1);
+    if constexpr (sizeof(TO_t) < sizeof(FROM_t)) {
+        if (HostFloat::loadedRoundingMode == HostFloat::RoundingMode::RMM) {
+            state->template WriteFloat<TO_t>(rd, HostFloat::NarrowTiesAway(value));
+            state->pc += 4;
+            return;
+        }
+    }
+    state->template WriteFloat<TO_t>(rd, (TO_t)value);
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_csrli(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t imm = swizzle<__uint32_t, CB_SHAMT>(encoding);
-    if constexpr (sizeof(XLEN_t) == 16) imm = imm == 0 ? 64 : imm;
-    XLEN_t rs1_value = state->regs[rs1];
-    XLEN_t rd_value = rs1_value >> imm;
-    state->regs[rd] = rd_value;
+// FMV.X.W moves the raw low bits, boxed or not, sign extended to XLEN.
+template<typename XLEN_t, typename FLOAT_t>
+inline void ex_fmv_to_int(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    if constexpr (sizeof(FLOAT_t) > sizeof(XLEN_t)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    HostFloat::Bits<FLOAT_t> bits = state->fregs[rs1];
+    state->regs[rd] = (std::make_signed_t<XLEN_t>)(std::make_signed_t<HostFloat::Bits<FLOAT_t>>)bits;
     state->regs[0] = 0;
-    state->pc += 2;
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void print_csrli(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t imm = swizzle<__uint32_t, CB_SHAMT>(encoding);
-    *out << "(C.SRLI) srli " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << imm << std::endl;
+template<typename XLEN_t, typename FLOAT_t>
+inline void ex_fmv_from_int(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    if constexpr (sizeof(FLOAT_t) > sizeof(XLEN_t)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    state->template WriteFloatBits<FLOAT_t>(rd, (HostFloat::Bits<FLOAT_t>)state->regs[rs1]);
+    state->pc += 4;
 }
 
-template<typename XLEN_t>
-inline void ex_csrai(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
-    __uint32_t rd = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t imm = swizzle<__uint32_t, CB_SHAMT>(encoding);
-    if constexpr (sizeof(XLEN_t) == 16) imm = imm == 0 ? 64 : imm;
-    XLEN_t rs1_value = state->regs[rs1];
-    __uint16_t imm_value = imm;
-    XLEN_t rd_value = rs1_value >> imm_value;
-    // Spec says: the original sign bit is copied into the vacated upper bits
-    if (rs1_value & ((XLEN_t)1 << ((sizeof(XLEN_t)*8)-1)))
-        rd_value |= (XLEN_t)((1 << imm_value)-1) << ((sizeof(XLEN_t)*8)-imm_value);
-    state->regs[rd] = rd_value;
+template<typename XLEN_t, typename FLOAT_t>
+inline void ex_fclass(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!fp_enabled(encoding, state)) {
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    FLOAT_t value = state->template ReadFloat<FLOAT_t>(rs1);
+    bool negative = std::signbit(value);
+    unsigned int bit;
+    switch (std::fpclassify(value)) {
+    case FP_INFINITE: bit = negative ? 0 : 7; break;
+    case FP_NORMAL: bit = negative ? 1 : 6; break;
+    case FP_SUBNORMAL: bit = negative ? 2 : 5; break;
+    case FP_ZERO: bit = negative ? 3 : 4; break;
+    default: bit = HostFloat::IsSignalingNaN(value) ? 8 : 9; break;
+    }
+    state->regs[rd] = 1 << bit;
     state->regs[0] = 0;
-    state->pc += 2;
-}
-
-template<typename XLEN_t>
-inline void print_csrai(__uint32_t encoding, std::ostream* out) {
-    __uint32_t rd = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t rs1 = swizzle<__uint32_t, CB_RDX_RS1X>(encoding)+8;
-    __uint32_t imm = swizzle<__uint32_t, CB_SHAMT>(encoding);
-    *out << "(C.SRAI) srai " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << imm << std::endl;
+    state->pc += 4;
 }
 
 template<typename XLEN_t> Instruction<XLEN_t> inst_illegal { ex_illegal<XLEN_t>, print_just_mnemonic<"illegal"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_unimplemented { ex_unimplemented<XLEN_t>, print_just_mnemonic<"unimplemented"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_hint { ex_hint<XLEN_t>, print_just_mnemonic<"nop"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_add    { ex_op_generic<XLEN_t, XLEN_t,                     std::plus<XLEN_t>,       false>, print_r_type_instr<"add"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_addw   { ex_op_generic<XLEN_t, __uint32_t,                 std::plus<XLEN_t>,       false>, print_r_type_instr<"addw"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_addi   { ex_op_generic<XLEN_t, XLEN_t,                     std::plus<XLEN_t>,       true>,  print_i_type_instr<"addi", false> };
@@ -863,6 +982,46 @@ template<typename XLEN_t> Instruction<XLEN_t> inst_div    { ex_op_generic<XLEN_t
 template<typename XLEN_t> Instruction<XLEN_t> inst_divu   { ex_op_generic<XLEN_t, XLEN_t,                     std::divides<XLEN_t>,    false>, print_i_type_instr<"divu", false> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_rem    { ex_op_generic<XLEN_t, std::make_signed_t<XLEN_t>, std::modulus<XLEN_t>,    false>, print_i_type_instr<"rem", false> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_remu   { ex_op_generic<XLEN_t, XLEN_t,                     std::modulus<XLEN_t>,    false>, print_i_type_instr<"remu", false> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sh1add    { ex_op_generic<XLEN_t, XLEN_t,                     shift_add<XLEN_t, 1, false>,          false>, print_r_type_instr<"sh1add"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sh2add    { ex_op_generic<XLEN_t, XLEN_t,                     shift_add<XLEN_t, 2, false>,          false>, print_r_type_instr<"sh2add"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sh3add    { ex_op_generic<XLEN_t, XLEN_t,                     shift_add<XLEN_t, 3, false>,          false>, print_r_type_instr<"sh3add"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_adduw     { ex_op_generic<XLEN_t, XLEN_t,                     shift_add<XLEN_t, 0, true>,           false>, print_r_type_instr<"add.uw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sh1adduw  { ex_op_generic<XLEN_t, XLEN_t,                     shift_add<XLEN_t, 1, true>,           false>, print_r_type_instr<"sh1add.uw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sh2adduw  { ex_op_generic<XLEN_t, XLEN_t,                     shift_add<XLEN_t, 2, true>,           false>, print_r_type_instr<"sh2add.uw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sh3adduw  { ex_op_generic<XLEN_t, XLEN_t,                     shift_add<XLEN_t, 3, true>,           false>, print_r_type_instr<"sh3add.uw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_slliuw    { ex_op_generic<XLEN_t, XLEN_t,                     shift_left_unsigned_word<XLEN_t>,     true>,  print_i_type_instr<"slli.uw", true> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_andn      { ex_op_generic<XLEN_t, XLEN_t,                     and_not<XLEN_t>,                      false>, print_r_type_instr<"andn"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_orn       { ex_op_generic<XLEN_t, XLEN_t,                     or_not<XLEN_t>,                       false>, print_r_type_instr<"orn"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_xnor      { ex_op_generic<XLEN_t, XLEN_t,                     xnor<XLEN_t>,                         false>, print_r_type_instr<"xnor"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_clz       { ex_op_generic<XLEN_t, XLEN_t,                     count_leading_zeros<XLEN_t>,          true>,  print_unary_instr<"clz"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_clzw      { ex_op_generic<XLEN_t, __uint32_t,                 count_leading_zeros<__uint32_t>,      true>,  print_unary_instr<"clzw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_ctz       { ex_op_generic<XLEN_t, XLEN_t,                     count_trailing_zeros<XLEN_t>,         true>,  print_unary_instr<"ctz"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_ctzw      { ex_op_generic<XLEN_t, __uint32_t,                 count_trailing_zeros<__uint32_t>,     true>,  print_unary_instr<"ctzw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_cpop      { ex_op_generic<XLEN_t, XLEN_t,                     population_count<XLEN_t>,             true>,  print_unary_instr<"cpop"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_cpopw     { ex_op_generic<XLEN_t, __uint32_t,                 population_count<__uint32_t>,         true>,  print_unary_instr<"cpopw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_max       { ex_op_generic<XLEN_t, XLEN_t,                     max<std::make_signed_t<XLEN_t>>,      false>, print_r_type_instr<"max"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_maxu      { ex_op_generic<XLEN_t, XLEN_t,                     max<XLEN_t>,                          false>, print_r_type_instr<"maxu"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_min       { ex_op_generic<XLEN_t, XLEN_t,                     min<std::make_signed_t<XLEN_t>>,      false>, print_r_type_instr<"min"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_minu      { ex_op_generic<XLEN_t, XLEN_t,                     min<XLEN_t>,                          false>, print_r_type_instr<"minu"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sextb     { ex_op_generic<XLEN_t, XLEN_t,                     sign_extend<XLEN_t, __int8_t>,        true>,  print_unary_instr<"sext.b"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sexth     { ex_op_generic<XLEN_t, XLEN_t,                     sign_extend<XLEN_t, __int16_t>,       true>,  print_unary_instr<"sext.h"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_zexth     { ex_op_generic<XLEN_t, XLEN_t,                     zero_extend_half<XLEN_t>,             false>, print_unary_instr<"zext.h"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_rol       { ex_op_generic<XLEN_t, XLEN_t,                     rotate_left<XLEN_t>,                  false>, print_r_type_instr<"rol"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_rolw      { ex_op_generic<XLEN_t, __uint32_t,                 rotate_left<__uint32_t>,              false>, print_r_type_instr<"rolw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_ror       { ex_op_generic<XLEN_t, XLEN_t,                     rotate_right<XLEN_t>,                 false>, print_r_type_instr<"ror"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_rorw      { ex_op_generic<XLEN_t, __uint32_t,                 rotate_right<__uint32_t>,             false>, print_r_type_instr<"rorw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_rori      { ex_op_generic<XLEN_t, XLEN_t,                     rotate_right<XLEN_t>,                 true>,  print_i_type_instr<"rori", true> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_roriw     { ex_op_generic<XLEN_t, __uint32_t,                 rotate_right<__uint32_t>,             true>,  print_i_type_instr<"roriw", true> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_orcb      { ex_op_generic<XLEN_t, XLEN_t,                     or_combine_bytes<XLEN_t>,             true>,  print_unary_instr<"orc.b"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_rev8      { ex_op_generic<XLEN_t, XLEN_t,                     byte_reverse<XLEN_t>,                 true>,  print_unary_instr<"rev8"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_bclr      { ex_op_generic<XLEN_t, XLEN_t,                     bit_clear<XLEN_t>,                    false>, print_r_type_instr<"bclr"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_bclri     { ex_op_generic<XLEN_t, XLEN_t,                     bit_clear<XLEN_t>,                    true>,  print_i_type_instr<"bclri", true> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_bext      { ex_op_generic<XLEN_t, XLEN_t,                     bit_extract<XLEN_t>,                  false>, print_r_type_instr<"bext"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_bexti     { ex_op_generic<XLEN_t, XLEN_t,                     bit_extract<XLEN_t>,                  true>,  print_i_type_instr<"bexti", true> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_binv      { ex_op_generic<XLEN_t, XLEN_t,                     bit_invert<XLEN_t>,                   false>, print_r_type_instr<"binv"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_binvi     { ex_op_generic<XLEN_t, XLEN_t,                     bit_invert<XLEN_t>,                   true>,  print_i_type_instr<"binvi", true> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_bset      { ex_op_generic<XLEN_t, XLEN_t,                     bit_set<XLEN_t>,                      false>, print_r_type_instr<"bset"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_bseti     { ex_op_generic<XLEN_t, XLEN_t,                     bit_set<XLEN_t>,                      true>,  print_i_type_instr<"bseti", true> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_beq  { ex_branch_generic<XLEN_t, std::equal_to<XLEN_t>>, print_b_type_instr<"beq"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_bne  { ex_branch_generic<XLEN_t, std::not_equal_to<XLEN_t>>, print_b_type_instr<"bne"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_blt  { ex_branch_generic<XLEN_t, std::less<std::make_signed_t<XLEN_t>>>,  print_b_type_instr<"blt"> };
@@ -876,14 +1035,16 @@ template<typename XLEN_t> Instruction<XLEN_t> inst_ld  { ex_load_generic<XLEN_t,
 template<typename XLEN_t> Instruction<XLEN_t> inst_lbu { ex_load_generic<XLEN_t, __uint8_t,  false>, print_load_instr<XLEN_t, __uint8_t,  true> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_lhu { ex_load_generic<XLEN_t, __uint16_t, false>, print_load_instr<XLEN_t, __uint16_t, true> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_lwu { ex_load_generic<XLEN_t, __uint32_t, false>, print_load_instr<XLEN_t, __uint32_t, true> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_lrw { ex_load_generic<XLEN_t, __int32_t,  true>,  print_r_type_instr<"lrw"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_lrd { ex_load_generic<XLEN_t, __int64_t,  true>,  print_r_type_instr<"lrd"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_lq  { ex_load_generic<XLEN_t, __uint128_t, false>, print_load_instr<XLEN_t, __uint128_t, false> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_lrw { ex_lr<XLEN_t, __int32_t>, print_r_type_instr<"lrw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_lrd { ex_lr<XLEN_t, __int64_t>, print_r_type_instr<"lrd"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_sb  { ex_store_generic<XLEN_t, __uint8_t>,  print_store_instr<XLEN_t, __uint8_t> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_sh  { ex_store_generic<XLEN_t, __uint16_t>, print_store_instr<XLEN_t, __uint16_t> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_sw  { ex_store_generic<XLEN_t, __uint32_t>, print_store_instr<XLEN_t, __uint32_t> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_sd  { ex_store_generic<XLEN_t, __uint64_t>, print_store_instr<XLEN_t, __uint64_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_scw { ex_scw<XLEN_t>, print_r_type_instr<"scw"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_scd { ex_unimplemented<XLEN_t>, print_r_type_instr<"scd"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_sq  { ex_store_generic<XLEN_t, __uint128_t>, print_store_instr<XLEN_t, __uint128_t> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_scw { ex_sc<XLEN_t, __uint32_t>, print_r_type_instr<"scw"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_scd { ex_sc<XLEN_t, __uint64_t>, print_r_type_instr<"scd"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_amoaddw  { ex_amo_generic<XLEN_t, __uint32_t, std::plus<XLEN_t>>, print_r_type_instr<"amoadd.w"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_amoaddd  { ex_amo_generic<XLEN_t, __uint64_t, std::plus<XLEN_t>>, print_r_type_instr<"amoadd.d"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_amoswapw { ex_amo_generic<XLEN_t, __uint32_t, lhs<XLEN_t>>, print_r_type_instr<"amoswap.w"> };
@@ -916,39 +1077,33 @@ template<typename XLEN_t> Instruction<XLEN_t> inst_csrrc  { ex_csr_generic<XLEN_
 template<typename XLEN_t> Instruction<XLEN_t> inst_csrrwi { ex_csr_generic<XLEN_t, false, false, true>,   print_csr_instr<"csrrwi", true> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_csrrsi { ex_csr_generic<XLEN_t, true,  false, true>,   print_csr_instr<"csrrsi", true> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_csrrci { ex_csr_generic<XLEN_t, false, true,  true>,   print_csr_instr<"csrrci", true> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_caddi4spn { ex_caddi4spn<XLEN_t>, print_caddi4spn<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_caddi { ex_caddi<XLEN_t>, print_caddi<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cjal { ex_cjal<XLEN_t>, print_cjal<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cli { ex_cli<XLEN_t>, print_cli<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_clui { ex_clui<XLEN_t>, print_clui<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_caddi16sp { ex_caddi16sp<XLEN_t>, print_caddi16sp<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cadd { ex_cadd<XLEN_t>, print_cadd<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_csub { ex_ca_format_op<XLEN_t, std::minus<XLEN_t>>, print_ca_format_instr<"(C.SUB) sub"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cxor { ex_ca_format_op<XLEN_t, std::bit_xor<XLEN_t>>, print_ca_format_instr<"(C.XOR) xor"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cor { ex_ca_format_op<XLEN_t, std::bit_or<XLEN_t>>, print_ca_format_instr<"(C.OR) or"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cand { ex_ca_format_op<XLEN_t, std::bit_and<XLEN_t>>, print_ca_format_instr<"(C.AND) and"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cj { ex_cj<XLEN_t>, print_cj<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cbeqz { ex_cbeqz<XLEN_t>, print_cbeqz<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cbnez { ex_cbnez<XLEN_t>, print_cbnez<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_candi { ex_candi<XLEN_t>, print_candi<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cslli { ex_cslli<XLEN_t>, print_cslli<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_csw { ex_cs_generic<XLEN_t, __uint32_t>, print_cs_generic<XLEN_t, __uint32_t, "(C.SW) sw"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_csd { ex_cs_generic<XLEN_t, __uint64_t>, print_cs_generic<XLEN_t, __uint64_t, "(C.SD) sd"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_csq { ex_cs_generic<XLEN_t, __uint128_t>, print_cs_generic<XLEN_t, __uint128_t, "(C.SQ) sq"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_clwsp { ex_clwsp<XLEN_t>, print_clwsp<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_clw { ex_cl_generic<XLEN_t, __uint32_t>, print_cl_generic<XLEN_t, __uint32_t, "(C.LW) lw"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cld { ex_cl_generic<XLEN_t, __uint64_t>, print_cl_generic<XLEN_t, __uint64_t, "(C.LD) ld"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_clq { ex_cl_generic<XLEN_t, __uint128_t>, print_cl_generic<XLEN_t, __uint128_t, "(C.LQ) lq"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cswsp { ex_cs_sp<XLEN_t, __uint32_t>, print_cswsp<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_csdsp { ex_cs_sp<XLEN_t, __uint64_t>, print_csdsp<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cjalr { ex_cjalr<XLEN_t>, print_cjalr<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cjr { ex_cjr<XLEN_t>, print_cjr<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cmv { ex_cmv<XLEN_t>, print_cmv<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_cebreak { ex_ebreak<XLEN_t>, print_just_mnemonic<"(C.EBREAK) ebreak"> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_csrli { ex_csrli<XLEN_t>, print_csrli<XLEN_t> };
-template<typename XLEN_t> Instruction<XLEN_t> inst_csrai { ex_csrai<XLEN_t>, print_csrai<XLEN_t> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_wfi { ex_wfi<XLEN_t>, print_just_mnemonic<"wfi"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_uret { ex_trap_return<XLEN_t, RISCV::PrivilegeMode::User>, print_just_mnemonic<"uret"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_sret { ex_trap_return<XLEN_t, RISCV::PrivilegeMode::Supervisor>, print_just_mnemonic<"sret"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_mret { ex_trap_return<XLEN_t, RISCV::PrivilegeMode::Machine>, print_just_mnemonic<"mret"> };
 template<typename XLEN_t> Instruction<XLEN_t> inst_sfencevma { ex_sfencevma<XLEN_t>, print_just_mnemonic<"sfence.vma"> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fl     { ex_fp_load_generic<XLEN_t, FLOAT_t>,  print_fp_load_instr<FLOAT_t> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fs     { ex_fp_store_generic<XLEN_t, FLOAT_t>, print_fp_store_instr<FLOAT_t> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fadd   { ex_fp_op_generic<XLEN_t, FLOAT_t, std::plus<FLOAT_t>>,       print_fp_instr<"fadd", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fsub   { ex_fp_op_generic<XLEN_t, FLOAT_t, std::minus<FLOAT_t>>,      print_fp_instr<"fsub", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fmul   { ex_fp_op_generic<XLEN_t, FLOAT_t, std::multiplies<FLOAT_t>>, print_fp_instr<"fmul", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fdiv   { ex_fp_op_generic<XLEN_t, FLOAT_t, std::divides<FLOAT_t>>,    print_fp_instr<"fdiv", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fsqrt  { ex_fp_sqrt<XLEN_t, FLOAT_t>, print_fp_instr<"fsqrt", FLOAT_t, 1> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fmadd  { ex_fp_fma_generic<XLEN_t, FLOAT_t, false, false>, print_fp_instr<"fmadd", FLOAT_t, 3> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fmsub  { ex_fp_fma_generic<XLEN_t, FLOAT_t, false, true>,  print_fp_instr<"fmsub", FLOAT_t, 3> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fnmsub { ex_fp_fma_generic<XLEN_t, FLOAT_t, true,  false>, print_fp_instr<"fnmsub", FLOAT_t, 3> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fnmadd { ex_fp_fma_generic<XLEN_t, FLOAT_t, true,  true>,  print_fp_instr<"fnmadd", FLOAT_t, 3> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fsgnj  { ex_fp_sgnj_generic<XLEN_t, FLOAT_t, rhs<HostFloat::Bits<FLOAT_t>>>,          print_fp_instr<"fsgnj", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fsgnjn { ex_fp_sgnj_generic<XLEN_t, FLOAT_t, not_rhs<HostFloat::Bits<FLOAT_t>>>,      print_fp_instr<"fsgnjn", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fsgnjx { ex_fp_sgnj_generic<XLEN_t, FLOAT_t, std::bit_xor<HostFloat::Bits<FLOAT_t>>>, print_fp_instr<"fsgnjx", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fmin   { ex_fp_minmax_generic<XLEN_t, FLOAT_t, false>, print_fp_instr<"fmin", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fmax   { ex_fp_minmax_generic<XLEN_t, FLOAT_t, true>,  print_fp_instr<"fmax", FLOAT_t, 2> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_feq    { ex_fp_compare_generic<XLEN_t, FLOAT_t, std::equal_to<FLOAT_t>,   false>, print_fp_compare_instr<"feq", FLOAT_t> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_flt    { ex_fp_compare_generic<XLEN_t, FLOAT_t, std::less<FLOAT_t>,       true>,  print_fp_compare_instr<"flt", FLOAT_t> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fle    { ex_fp_compare_generic<XLEN_t, FLOAT_t, std::less_equal<FLOAT_t>, true>,  print_fp_compare_instr<"fle", FLOAT_t> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fclass { ex_fclass<XLEN_t, FLOAT_t>, print_fp_compare_instr<"fclass", FLOAT_t> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fmvx   { ex_fmv_to_int<XLEN_t, FLOAT_t>,   print_fp_move_instr<"fmv.x.f", false> };
+template<typename XLEN_t, typename FLOAT_t> Instruction<XLEN_t> inst_fmvf   { ex_fmv_from_int<XLEN_t, FLOAT_t>, print_fp_move_instr<"fmv.f.x", true> };
+template<typename XLEN_t, typename FLOAT_t, typename INT_t> Instruction<XLEN_t> inst_fcvt_to_int   { ex_fp_to_int<XLEN_t, FLOAT_t, INT_t>, print_fcvt<INT_t, FLOAT_t> };
+template<typename XLEN_t, typename FLOAT_t, typename INT_t> Instruction<XLEN_t> inst_fcvt_from_int { ex_int_to_fp<XLEN_t, FLOAT_t, INT_t>, print_fcvt<FLOAT_t, INT_t> };
+template<typename XLEN_t, typename TO_t, typename FROM_t>   Instruction<XLEN_t> inst_fcvt_fp       { ex_fp_convert<XLEN_t, TO_t, FROM_t>,  print_fcvt<TO_t, FROM_t> };
@@ -0,0 +1,191 @@
+#pragma once
+
+/*
+ * Address translation for executors and the fetch path, specialized by mode.
+ * Each MMU is built for one paging mode and one of S or U, fixed at compile
+ * time, and translates every access with TranslationAlgorithm before passing
+ * it downstream; the rest of the hart's state it needs (satp.ppn, MXR, SUM) is
+ * read as it goes. There's no MMU for M-mode or Bare: there, MMUSet hands out
+ * the downstream Transactor itself, and a Translator that's the identity, so
+ * firmware and early boot run with no translation code in the way at all.
+ *
+ * The run loop passes MMUSet::Data() to executors as their Transactor, and
+ * gives MMUSet::Fetch() to its FetchCache. Both can change when the hart's
+ * privilege, mstatus (MPRV and MPP) or satp do, so the client hands those
+ * callbacks to MMUSet::Notify and then picks up the new variants.
+ */
+
+#include <RiscV.hpp>
+#include <HartState.hpp>
+#include <RiscVTranslationAlgorithm.hpp>
+#include <Transactor.hpp>
+#include <Translator.hpp>
+
+template<typename XLEN_t>
+class IdentityTranslator final : public Translator<XLEN_t> {
+
+private:
+
+    static inline Translation<XLEN_t> Identity(XLEN_t address) {
+        return { address, address, (XLEN_t)0, (XLEN_t)~0, RISCV::TrapCause::NONE };
+    }
+
+public:
+
+    inline Translation<XLEN_t> TranslateRead(XLEN_t address) override { return Identity(address); }
+    inline Translation<XLEN_t> TranslateWrite(XLEN_t address) override { return Identity(address); }
+    inline Translation<XLEN_t> TranslateFetch(XLEN_t address) override { return Identity(address); }
+
+};
+
+template<typename XLEN_t, RISCV::PagingMode mode, RISCV::PrivilegeMode privilege>
+class MMU final : public Transactor<XLEN_t>, public Translator<XLEN_t> {
+
+    static_assert(mode != RISCV::PagingMode::Bare && privilege != RISCV::PrivilegeMode::Machine,
+                  "untranslated accesses go straight downstream");
+
+private:
+
+    HartState<XLEN_t>* state;
+    Transactor<XLEN_t>* downstream;
+    Transactor<XLEN_t>* tables;
+    PMP<XLEN_t>* pmp;
+    bool hardwareAD;
+
+    template<IOVerb verb>
+    inline Translation<XLEN_t> Translate(XLEN_t address) {
+        return TranslationAlgorithm<XLEN_t, verb>(
+            address, tables, state->satp.ppn, mode, privilege,
+            state->mstatus.mxr, state->mstatus.sum, pmp, hardwareAD);
+    }
+
+    // Accesses that cross into another page translate each page separately
+    template<IOVerb verb>
+    inline Transaction<XLEN_t> Access(XLEN_t startAddress, XLEN_t size, char* buf) {
+        XLEN_t done = 0;
+        while (done < size) {
+            XLEN_t address = startAddress + done;
+            Translation<XLEN_t> translation = Translate<verb>(address);
+            if (translation.generatedTrap != RISCV::TrapCause::NONE) {
+                return { translation.generatedTrap, done };
+            }
+            XLEN_t chunk = translation.validThrough - address + 1;
+            if (chunk > size - done) {
+                chunk = size - done;
+            }
+            Transaction<XLEN_t> transaction =
+                downstream->template Transact<verb>(translation.translated, chunk, buf + done);
+            done += transaction.transferredSize;
+            if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != chunk) {
+                return { transaction.trapCause, done };
+            }
+        }
+        return { RISCV::TrapCause::NONE, done };
+    }
+
+public:
+
+    MMU(HartState<XLEN_t>* state, Transactor<XLEN_t>* downstream, Transactor<XLEN_t>* tables, PMP<XLEN_t>* pmp,
+        bool hardwareAD)
+        : state(state), downstream(downstream), tables(tables), pmp(pmp), hardwareAD(hardwareAD) {
+    }
+
+    inline Transaction<XLEN_t> Read(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Read>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Write(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Write>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Fetch(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Fetch>(startAddress, size, buf);
+    }
+
+    inline Translation<XLEN_t> TranslateRead(XLEN_t address) override { return Translate<IOVerb::Read>(address); }
+    inline Translation<XLEN_t> TranslateWrite(XLEN_t address) override { return Translate<IOVerb::Write>(address); }
+    inline Translation<XLEN_t> TranslateFetch(XLEN_t address) override { return Translate<IOVerb::Fetch>(address); }
+
+};
+
+template<typename XLEN_t>
+class MMUSet {
+
+private:
+
+    template<RISCV::PagingMode mode>
+    struct ModeMMUs {
+        MMU<XLEN_t, mode, RISCV::PrivilegeMode::Supervisor> supervisor;
+        MMU<XLEN_t, mode, RISCV::PrivilegeMode::User> user;
+    };
+
+    HartState<XLEN_t>* state;
+    Transactor<XLEN_t>* downstream;
+    IdentityTranslator<XLEN_t> identity;
+    ModeMMUs<RISCV::PagingMode::Sv32> sv32;
+    ModeMMUs<RISCV::PagingMode::Sv39> sv39;
+    ModeMMUs<RISCV::PagingMode::Sv48> sv48;
+
+    Transactor<XLEN_t>* data;
+    Translator<XLEN_t>* fetch;
+
+    template<RISCV::PagingMode mode>
+    inline ModeMMUs<mode> Build(Transactor<XLEN_t>* tables, PMP<XLEN_t>* pmp, bool hardwareAD) {
+        return { { state, downstream, tables, pmp, hardwareAD }, { state, downstream, tables, pmp, hardwareAD } };
+    }
+
+    template<typename Base>
+    inline Base* Pick(RISCV::PrivilegeMode privilege, Base* untranslated) {
+        if (privilege == RISCV::PrivilegeMode::Machine) {
+            return untranslated;
+        }
+        bool user = privilege == RISCV::PrivilegeMode::User;
+        switch (state->satp.mode) {
+            case RISCV::PagingMode::Sv32: return user ? static_cast<Base*>(&sv32.user) : static_cast<Base*>(&sv32.supervisor);
+            case RISCV::PagingMode::Sv39: return user ? static_cast<Base*>(&sv39.user) : static_cast<Base*>(&sv39.supervisor);
+            case RISCV::PagingMode::Sv48: return user ? static_cast<Base*>(&sv48.user) : static_cast<Base*>(&sv48.supervisor);
+            default: return untranslated;
+        }
+    }
+
+public:
+
+    // Page tables are read through downstream, or through tables if that's
+    // given, in which case the walk does its own PMP checks. That's for when
+    // downstream is a PMPTransactor, whose checks are for the access itself.
+    // With hardwareAD, walks set PTE A and D bits rather than page faulting.
+    MMUSet(HartState<XLEN_t>* state, Transactor<XLEN_t>* downstream, Transactor<XLEN_t>* tables = nullptr,
+           bool hardwareAD = false)
+        : state(state), downstream(downstream),
+          sv32(Build<RISCV::PagingMode::Sv32>(tables ? tables : downstream, tables ? &state->pmp : nullptr, hardwareAD)),
+          sv39(Build<RISCV::PagingMode::Sv39>(tables ? tables : downstream, tables ? &state->pmp : nullptr, hardwareAD)),
+          sv48(Build<RISCV::PagingMode::Sv48>(tables ? tables : downstream, tables ? &state->pmp : nullptr, hardwareAD)) {
+        Select();
+    }
+
+    MMUSet(const MMUSet&) = delete;
+    MMUSet& operator=(const MMUSet&) = delete;
+
+    // Loads and stores translate at the hart's DataPrivilege; fetches always
+    // use the current privilege.
+    inline void Select() {
+        data = Pick<Transactor<XLEN_t>>(state->DataPrivilege(), downstream);
+        fetch = Pick<Translator<XLEN_t>>(state->privilegeMode, &identity);
+    }
+
+    inline void Notify(HartCallbackArgument argument) {
+        switch (argument) {
+            case HartCallbackArgument::ChangedPrivilege:
+            case HartCallbackArgument::ChangedMSTATUS:
+            case HartCallbackArgument::ChangedSATP:
+                Select();
+                break;
+            default:
+                break;
+        }
+    }
+
+    inline Transactor<XLEN_t>* Data() { return data; }
+    inline Translator<XLEN_t>* Fetch() { return fetch; }
+
+};
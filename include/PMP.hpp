@@ -0,0 +1,247 @@
+#pragma once
+
+/*
+ * Physical memory protection. The sixteen pmpcfg/pmpaddr entries are kept as
+ * the guest wrote them, and compiled on every write into a sorted table of
+ * non-overlapping regions covering the whole physical address space, each with
+ * the permissions that apply there in M-mode and in S/U-mode. Priority between
+ * overlapping entries is resolved at compile time, so a check is a hit on the
+ * last region used or a binary search, never a scan of the entries. M-mode is
+ * only subject to locked entries, so without any it skips the check outright.
+ *
+ * Adjacent regions governed by the same entry are merged, which means an
+ * access is allowed only if it fits inside one region: an access that the
+ * highest-priority entry only partly covers fails, as the spec requires.
+ */
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include <RiscV.hpp>
+#include <IOVerb.hpp>
+#include <Transaction.hpp>
+
+template<typename XLEN_t>
+class PMP {
+
+public:
+
+    static constexpr unsigned int NumEntries = 16;
+
+    enum Config : __uint8_t { R = 0x01, W = 0x02, X = 0x04, A = 0x18, L = 0x80 };
+    enum Matching : __uint8_t { OFF = 0, TOR = 1, NA4 = 2, NAPOT = 3 };
+
+private:
+
+    // pmpaddr holds bits 33:2 (RV32) or 55:2 (RV64) of an address
+    static constexpr __uint64_t AddressMask =
+        sizeof(XLEN_t) == 4 ? 0xffffffff : ((__uint64_t)1 << 54) - 1;
+
+    struct Region {
+        __uint64_t start;
+        __uint64_t end; // Exclusive
+        __uint8_t machinePermissions;
+        __uint8_t lowerPermissions; // S- and U-mode
+    };
+
+    __uint8_t cfg[NumEntries];
+    XLEN_t addr[NumEntries];
+
+    Region regions[2 * NumEntries + 1];
+    unsigned int regionCount;
+    unsigned int lastHit;
+    bool checkMachine;
+
+    inline Matching MatchingOf(unsigned int entry) {
+        return (Matching)((cfg[entry] & A) >> 3);
+    }
+
+    // The byte range [*lo, *hi) an entry matches; empty if it's off
+    inline void Bounds(unsigned int entry, __uint64_t* lo, __uint64_t* hi) {
+        __uint64_t address = (__uint64_t)addr[entry];
+        switch (MatchingOf(entry)) {
+            case TOR:
+                *lo = entry == 0 ? 0 : (__uint64_t)addr[entry - 1] << 2;
+                *hi = address << 2;
+                break;
+            case NA4:
+                *lo = address << 2;
+                *hi = *lo + 4;
+                break;
+            case NAPOT: {
+                // The number of trailing ones gives the size: 8 << ones bytes
+                unsigned int ones = std::countr_one(address);
+                __uint64_t size = (__uint64_t)8 << ones;
+                *lo = (address << 2) & ~(size - 1);
+                *hi = *lo + size;
+                break;
+            }
+            default:
+                *lo = *hi = 0;
+                break;
+        }
+        if (*hi < *lo) {
+            *hi = *lo;
+        }
+    }
+
+    inline void Compile() {
+        __uint64_t lo[NumEntries], hi[NumEntries];
+        __uint64_t points[2 * NumEntries + 2];
+        unsigned int pointCount = 0;
+        points[pointCount++] = 0;
+        points[pointCount++] = ~(__uint64_t)0;
+        checkMachine = false;
+        for (unsigned int entry = 0; entry < NumEntries; entry++) {
+            Bounds(entry, &lo[entry], &hi[entry]);
+            if (lo[entry] == hi[entry]) {
+                continue;
+            }
+            points[pointCount++] = lo[entry];
+            points[pointCount++] = hi[entry];
+            checkMachine |= (cfg[entry] & L) != 0;
+        }
+        std::sort(points, points + pointCount);
+        pointCount = std::unique(points, points + pointCount) - points;
+
+        regionCount = 0;
+        int previousWinner = -2;
+        for (unsigned int point = 0; point + 1 < pointCount; point++) {
+            // Elementary intervals don't straddle any entry's bounds, so the
+            // lowest-numbered entry containing the start wins the whole thing.
+            int winner = -1;
+            for (unsigned int entry = 0; entry < NumEntries; entry++) {
+                if (lo[entry] <= points[point] && points[point] < hi[entry]) {
+                    winner = entry;
+                    break;
+                }
+            }
+            if (winner == previousWinner) {
+                regions[regionCount - 1].end = points[point + 1];
+                continue;
+            }
+            previousWinner = winner;
+            Region& region = regions[regionCount++];
+            region.start = points[point];
+            region.end = points[point + 1];
+            if (winner < 0) {
+                // Nothing matches: M-mode may go anywhere, S/U-mode nowhere
+                region.machinePermissions = R | W | X;
+                region.lowerPermissions = 0;
+            } else {
+                __uint8_t permissions = cfg[winner] & (R | W | X);
+                region.machinePermissions = (cfg[winner] & L) ? permissions : (R | W | X);
+                region.lowerPermissions = permissions;
+            }
+        }
+        lastHit = 0;
+    }
+
+    inline bool Locked(unsigned int entry) {
+        return (cfg[entry] & L) != 0;
+    }
+
+public:
+
+    PMP() {
+        Reset();
+    }
+
+    void Reset() {
+        memset(cfg, 0, sizeof(cfg));
+        memset(addr, 0, sizeof(addr));
+        Compile();
+    }
+
+    template<IOVerb verb>
+    inline bool Allows(__uint64_t address, __uint64_t size, RISCV::PrivilegeMode privilege) {
+        if (privilege == RISCV::PrivilegeMode::Machine && !checkMachine) [[likely]] {
+            return true;
+        }
+        const Region* region = &regions[lastHit];
+        if (address < region->start || address >= region->end) {
+            region = std::upper_bound(regions, regions + regionCount, address,
+                [](__uint64_t a, const Region& r) { return a < r.start; }) - 1;
+            lastHit = region - regions;
+        }
+        if (address + size > region->end || address + size < address) {
+            return false;
+        }
+        __uint8_t permissions = privilege == RISCV::PrivilegeMode::Machine ?
+            region->machinePermissions : region->lowerPermissions;
+        if constexpr (verb == IOVerb::Read) {
+            return permissions & R;
+        } else if constexpr (verb == IOVerb::Write) {
+            return permissions & W;
+        } else {
+            return permissions & X;
+        }
+    }
+
+    // The run of addresses [*start, *end) around address that every check at
+    // this privilege treats alike, for callers that cache the result of one.
+    inline void Extent(__uint64_t address, RISCV::PrivilegeMode privilege, __uint64_t* start, __uint64_t* end) {
+        if (privilege == RISCV::PrivilegeMode::Machine && !checkMachine) {
+            *start = 0;
+            *end = ~(__uint64_t)0;
+            return;
+        }
+        const Region* region = std::upper_bound(regions, regions + regionCount, address,
+            [](__uint64_t a, const Region& r) { return a < r.start; }) - 1;
+        *start = region->start;
+        *end = region->end;
+    }
+
+    template<IOVerb verb>
+    inline RISCV::TrapCause Check(__uint64_t address, __uint64_t size, RISCV::PrivilegeMode privilege) {
+        return Allows<verb>(address, size, privilege) ? RISCV::TrapCause::NONE : AccessFault<verb>();
+    }
+
+    // pmpcfgN holds four entries on RV32; on RV64 only the even ones exist,
+    // holding eight entries each.
+    inline XLEN_t ReadConfig(unsigned int csrIndex) {
+        if (sizeof(XLEN_t) == 8 && (csrIndex & 1)) {
+            return 0;
+        }
+        XLEN_t value = 0;
+        for (unsigned int i = 0; i < sizeof(XLEN_t); i++) {
+            value |= (XLEN_t)cfg[csrIndex * 4 + i] << (8 * i);
+        }
+        return value;
+    }
+
+    inline void WriteConfig(unsigned int csrIndex, XLEN_t value) {
+        if (sizeof(XLEN_t) == 8 && (csrIndex & 1)) {
+            return;
+        }
+        for (unsigned int i = 0; i < sizeof(XLEN_t); i++) {
+            unsigned int entry = csrIndex * 4 + i;
+            if (Locked(entry)) {
+                continue;
+            }
+            __uint8_t entryConfig = (value >> (8 * i)) & (R | W | X | A | L);
+            if ((entryConfig & (R | W)) == W) {
+                entryConfig &= ~W; // W without R is reserved
+            }
+            cfg[entry] = entryConfig;
+        }
+        Compile();
+    }
+
+    inline XLEN_t ReadAddress(unsigned int entry) {
+        return addr[entry];
+    }
+
+    // A locked entry also locks the address below it, if it's TOR
+    inline void WriteAddress(unsigned int entry, XLEN_t value) {
+        if (Locked(entry) ||
+            (entry + 1 < NumEntries && Locked(entry + 1) && MatchingOf(entry + 1) == TOR)) {
+            return;
+        }
+        addr[entry] = value & AddressMask;
+        Compile();
+    }
+
+};
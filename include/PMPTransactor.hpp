@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * A Transactor that checks physical accesses against a hart's PMP before
+ * passing them on. It goes between a client's translation and its physical
+ * memory. Loads and stores are checked at the effective privilege, which is
+ * mstatus.MPP when MPRV is set in M-mode (see HartState::DataPrivilege);
+ * fetches always use the current privilege.
+ */
+
+#include <RiscV.hpp>
+#include <HartState.hpp>
+#include <PMP.hpp>
+#include <Transactor.hpp>
+
+template<typename XLEN_t>
+class PMPTransactor final : public Transactor<XLEN_t> {
+
+private:
+
+    HartState<XLEN_t>* state;
+    Transactor<XLEN_t>* downstream;
+
+    template<IOVerb verb>
+    inline Transaction<XLEN_t> Access(XLEN_t startAddress, XLEN_t size, char* buf) {
+        RISCV::PrivilegeMode privilege = verb == IOVerb::Fetch ? state->privilegeMode : state->DataPrivilege();
+        if (!state->pmp.template Allows<verb>(startAddress, size, privilege)) {
+            return { AccessFault<verb>(), 0 };
+        }
+        return downstream->template Transact<verb>(startAddress, size, buf);
+    }
+
+public:
+
+    PMPTransactor(HartState<XLEN_t>* state, Transactor<XLEN_t>* downstream)
+        : state(state), downstream(downstream) {
+    }
+
+    inline Transaction<XLEN_t> Read(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Read>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Write(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Write>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Fetch(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Fetch>(startAddress, size, buf);
+    }
+
+    // Checked as a store at the data privilege
+    inline Transaction<XLEN_t> CompareAndSwap(XLEN_t startAddress, XLEN_t size, char* expected, char* desired) override {
+        if (!state->pmp.template Allows<IOVerb::Write>(startAddress, size, state->DataPrivilege())) {
+            return { RISCV::TrapCause::STORE_AMO_ACCESS_FAULT, 0 };
+        }
+        return downstream->CompareAndSwap(startAddress, size, expected, desired);
+    }
+
+};
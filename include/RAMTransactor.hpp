@@ -0,0 +1,594 @@
+#pragma once
+
+/*
+ * A reference Transactor for guest RAM. The whole guest physical range is
+ * reserved as one anonymous mapping with MAP_NORESERVE, so nothing is committed
+ * until the guest first touches a page, and a configured-but-untouched 16 GiB
+ * guest costs only address space. Serving an access is a bounds check and a
+ * memcpy against the host mapping.
+ *
+ * Huge pages cut the TLB and page-fault cost of large guests. Transparent huge
+ * pages are just a madvise hint, and only apply on hosts with THP in "madvise"
+ * or "always" mode. Explicit huge pages come from the hugetlbfs pool, which
+ * must have been reserved by the host admin; if the pool can't back the
+ * mapping, this falls back to normal pages rather than failing.
+ *
+ * Watchpoints are kept per page, so accesses pay for them only when they land
+ * on a watched page, and nothing at all while none are set. With FastMemory,
+ * watched pages are protected on the host as well, so its direct loads and
+ * stores fault into the checked path only for those pages.
+ *
+ * Snapshots let fuzzers reset RAM in time proportional to what an iteration
+ * wrote, not to the size of RAM. After Snapshot, the first write to each page
+ * saves a copy of it and marks it dirty, and Restore copies back just the
+ * dirty pages. Copies are kept from one Restore to the next, so pages that
+ * every iteration writes (the stack, say) are only saved once. Under
+ * FastMemory, Snapshot's writeProtect makes clean pages read-only on the host
+ * so that direct stores fault into the checked path and get marked too.
+ */
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include <RiscV.hpp>
+#include <Transactor.hpp>
+
+enum class HugePages { None, Transparent, Explicit };
+
+template<typename XLEN_t>
+class RAMTransactor final : public Transactor<XLEN_t> {
+
+private:
+
+    XLEN_t base;
+    XLEN_t size;
+    char* host = nullptr;
+    HugePages hugePages = HugePages::None;
+
+    // Self-modifying code detection: one bit per 4 KiB page that the client
+    // has decoded code from. Writes that land on one clear its bit and tell the
+    // client, who then drops just that page's decoded instructions.
+    static constexpr unsigned int CodePageShift = 12;
+    std::vector<__uint64_t> codePages;
+    std::function<void(XLEN_t)> codeWritten;
+    bool protectCode = false;
+
+    // Watchpoints: the watched ranges, and a WatchReads/WatchWrites byte per
+    // page that any of them cover. watchPages is empty when nothing's watched.
+    struct WatchedRange {
+        XLEN_t start;
+        XLEN_t end; // Exclusive
+        bool reads;
+        bool writes;
+    };
+    static constexpr __uint8_t WatchReads = 1;
+    static constexpr __uint8_t WatchWrites = 2;
+    std::vector<WatchedRange> watches;
+    std::vector<__uint8_t> watchPages;
+    std::function<void(XLEN_t, XLEN_t, IOVerb)> watchHit;
+    bool protectWatches = false;
+
+    // Snapshots: a bit per page written since the snapshot, those pages in
+    // the order they were first written, and the snapshot's copy of every
+    // page written since it was taken.
+    std::vector<__uint64_t> dirtyPages;
+    std::vector<XLEN_t> dirtyList;
+    std::unordered_map<XLEN_t, std::unique_ptr<char[]>> baseline;
+    bool protectClean = false;
+
+    inline bool IsCode(XLEN_t page) {
+        return !codePages.empty() && (codePages[page / 64] >> (page % 64)) & 1;
+    }
+
+    inline bool IsDirty(XLEN_t page) {
+        return !dirtyPages.empty() && (dirtyPages[page / 64] >> (page % 64)) & 1;
+    }
+
+    inline bool Protecting() {
+        return protectCode || protectWatches || protectClean;
+    }
+
+    // The last page may be short if RAM isn't a whole number of pages
+    inline XLEN_t PageBytes(XLEN_t page) {
+        XLEN_t offset = page << CodePageShift;
+        return size - offset < ((XLEN_t)1 << CodePageShift) ? size - offset : (XLEN_t)1 << CodePageShift;
+    }
+
+    // Sets page's host protection from its code, watch and snapshot flags:
+    // none for a read watch, read-only for a write watch, code or a page clean
+    // since the snapshot, otherwise read-write.
+    inline void Protect(XLEN_t page) {
+        __uint8_t watched = protectWatches && !watchPages.empty() ? watchPages[page] : 0;
+        int protection = PROT_READ | PROT_WRITE;
+        if (watched & WatchReads) {
+            protection = PROT_NONE;
+        } else if ((watched & WatchWrites) || (protectCode && IsCode(page)) || (protectClean && !IsDirty(page))) {
+            protection = PROT_READ;
+        }
+        mprotect(host + (page << CodePageShift), (XLEN_t)1 << CodePageShift, protection);
+    }
+
+    // Opens up the watched pages in [offset, offset + length) for the checked
+    // path to access, and closes them again afterwards.
+    inline void Unprotect(XLEN_t offset, XLEN_t length) {
+        if (!protectWatches || watchPages.empty() || length == 0) [[likely]] {
+            return;
+        }
+        for (XLEN_t page = offset >> CodePageShift; page <= (offset + length - 1) >> CodePageShift; page++) {
+            if (watchPages[page] != 0) {
+                mprotect(host + (page << CodePageShift), (XLEN_t)1 << CodePageShift, PROT_READ | PROT_WRITE);
+            }
+        }
+    }
+
+    inline void Reprotect(XLEN_t offset, XLEN_t length) {
+        if (!protectWatches || watchPages.empty() || length == 0) [[likely]] {
+            return;
+        }
+        for (XLEN_t page = offset >> CodePageShift; page <= (offset + length - 1) >> CodePageShift; page++) {
+            if (watchPages[page] != 0) {
+                Protect(page);
+            }
+        }
+    }
+
+    inline void CheckWatches(XLEN_t startAddress, XLEN_t length, IOVerb verb) {
+        for (const WatchedRange& watch : watches) {
+            bool kind = verb == IOVerb::Write ? watch.writes : watch.reads;
+            if (kind && startAddress < watch.end && watch.start < startAddress + length) {
+                watchHit(startAddress, length, verb);
+                return;
+            }
+        }
+    }
+
+    inline void RebuildWatchPages() {
+        std::vector<__uint8_t> previous;
+        previous.swap(watchPages);
+        if (!watches.empty()) {
+            watchPages.assign((size >> CodePageShift) + 1, 0);
+        }
+        for (const WatchedRange& watch : watches) {
+            for (XLEN_t page = (watch.start - base) >> CodePageShift; page <= (watch.end - 1 - base) >> CodePageShift; page++) {
+                watchPages[page] |= (watch.reads ? WatchReads : 0) | (watch.writes ? WatchWrites : 0);
+            }
+        }
+        if (!protectWatches) {
+            return;
+        }
+        for (XLEN_t page = 0; page < previous.size() || page < watchPages.size(); page++) {
+            __uint8_t was = page < previous.size() ? previous[page] : 0;
+            __uint8_t now = page < watchPages.size() ? watchPages[page] : 0;
+            if (was != now) {
+                Protect(page);
+            }
+        }
+    }
+
+    // Every path that writes RAM calls this first, before opening anything
+    // up, so the snapshot's copy is of the page as it was.
+    inline void Dirty(XLEN_t offset, XLEN_t length) {
+        if (dirtyPages.empty() || length == 0) [[likely]] {
+            return;
+        }
+        for (XLEN_t page = offset >> CodePageShift; page <= (offset + length - 1) >> CodePageShift; page++) {
+            __uint64_t bit = (__uint64_t)1 << (page % 64);
+            if (dirtyPages[page / 64] & bit) {
+                continue;
+            }
+            dirtyPages[page / 64] |= bit;
+            dirtyList.push_back(page);
+            std::unique_ptr<char[]>& saved = baseline[page];
+            if (saved == nullptr) {
+                char* start = host + (page << CodePageShift);
+                if (protectWatches && !watchPages.empty() && (watchPages[page] & WatchReads)) {
+                    mprotect(start, (XLEN_t)1 << CodePageShift, PROT_READ);
+                }
+                saved = std::make_unique<char[]>(PageBytes(page));
+                memcpy(saved.get(), start, PageBytes(page));
+            }
+            if (Protecting()) {
+                Protect(page);
+            }
+        }
+    }
+
+    // Sets every page's host protection afresh, after a change of policy
+    inline void ProtectAll() {
+        mprotect(host, size, protectClean ? PROT_READ : PROT_READ | PROT_WRITE);
+        for (XLEN_t page : dirtyList) {
+            Protect(page);
+        }
+        for (XLEN_t word = 0; word < codePages.size(); word++) {
+            for (__uint64_t bits = codePages[word]; bits != 0; bits &= bits - 1) {
+                Protect(word * 64 + std::countr_zero(bits));
+            }
+        }
+        for (XLEN_t page = 0; page < watchPages.size(); page++) {
+            if (watchPages[page] != 0) {
+                Protect(page);
+            }
+        }
+    }
+
+    inline void InvalidateCode(XLEN_t offset, XLEN_t length) {
+        if (codePages.empty() || length == 0) [[likely]] {
+            return;
+        }
+        for (XLEN_t page = offset >> CodePageShift; page <= (offset + length - 1) >> CodePageShift; page++) {
+            __uint64_t bit = (__uint64_t)1 << (page % 64);
+            if (!(codePages[page / 64] & bit)) {
+                continue;
+            }
+            codePages[page / 64] &= ~bit;
+            if (protectCode) {
+                Protect(page);
+            }
+            codeWritten(base + (page << CodePageShift));
+        }
+    }
+
+    // How many bytes of the access starting at startAddress fall inside RAM.
+    // Accesses that run off the end transfer what they can and fault.
+    inline XLEN_t InBounds(XLEN_t startAddress, XLEN_t accessSize) {
+        XLEN_t offset = startAddress - base;
+        if (startAddress < base || offset >= size) {
+            return 0;
+        }
+        return size - offset < accessSize ? size - offset : accessSize;
+    }
+
+    // Accesses touching a watched page open it up on the host if need be,
+    // and report a hit once they're done.
+    template<IOVerb verb>
+    inline Transaction<XLEN_t> WatchedAccess(XLEN_t startAddress, XLEN_t accessSize, char* buf) {
+        XLEN_t transferable = InBounds(startAddress, accessSize);
+        XLEN_t offset = startAddress - base;
+        if constexpr (verb == IOVerb::Write) {
+            Dirty(offset, transferable);
+            InvalidateCode(offset, transferable);
+        }
+        Unprotect(offset, transferable);
+        if constexpr (verb == IOVerb::Write) {
+            memcpy(host + offset, buf, transferable);
+        } else {
+            memcpy(buf, host + offset, transferable);
+        }
+        Reprotect(offset, transferable);
+        if constexpr (verb != IOVerb::Fetch) {
+            if (transferable != 0) {
+                CheckWatches(startAddress, transferable, verb);
+            }
+        }
+        if (transferable == accessSize) {
+            return { RISCV::TrapCause::NONE, transferable };
+        }
+        return { AccessFault<verb>(), transferable };
+    }
+
+    template<IOVerb verb>
+    inline Transaction<XLEN_t> Access(XLEN_t startAddress, XLEN_t accessSize, char* buf) {
+        if (!watchPages.empty()) [[unlikely]] {
+            return WatchedAccess<verb>(startAddress, accessSize, buf);
+        }
+        XLEN_t transferable = InBounds(startAddress, accessSize);
+        if constexpr (verb == IOVerb::Write) {
+            Dirty(startAddress - base, transferable);
+            InvalidateCode(startAddress - base, transferable);
+            memcpy(host + (startAddress - base), buf, transferable);
+        } else {
+            memcpy(buf, host + (startAddress - base), transferable);
+        }
+        if (transferable == accessSize) [[likely]] {
+            return { RISCV::TrapCause::NONE, transferable };
+        }
+        return { AccessFault<verb>(), transferable };
+    }
+
+public:
+
+    // If placement is given, RAM is mapped there (over whatever was there)
+    // rather than wherever the host likes; FastMemory uses this to put RAM
+    // inside its guard window.
+    RAMTransactor(XLEN_t baseAddress, XLEN_t sizeBytes, HugePages requestedHugePages = HugePages::None,
+                  void* placement = nullptr)
+        : base(baseAddress), size(sizeBytes) {
+
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | (placement != nullptr ? MAP_FIXED : 0);
+        void* mapping = MAP_FAILED;
+
+#if defined(MAP_HUGETLB)
+        if (requestedHugePages == HugePages::Explicit) {
+            mapping = mmap(placement, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            if (mapping != MAP_FAILED) {
+                hugePages = HugePages::Explicit;
+            }
+        }
+#endif
+
+        if (mapping == MAP_FAILED) {
+            mapping = mmap(placement, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        }
+
+        if (mapping == MAP_FAILED) {
+            // Every access will fault; clients can check Host() for nullptr.
+            size = 0;
+            return;
+        }
+
+        host = (char*)mapping;
+
+#if defined(MADV_HUGEPAGE)
+        if (requestedHugePages != HugePages::None && hugePages == HugePages::None) {
+            if (madvise(host, size, MADV_HUGEPAGE) == 0) {
+                hugePages = HugePages::Transparent;
+            }
+        }
+#endif
+    }
+
+    ~RAMTransactor() {
+        if (host != nullptr) {
+            munmap(host, size);
+        }
+    }
+
+    RAMTransactor(const RAMTransactor&) = delete;
+    RAMTransactor& operator=(const RAMTransactor&) = delete;
+
+    inline Transaction<XLEN_t> Read(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Read>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Write(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Write>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Fetch(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Fetch>(startAddress, size, buf);
+    }
+
+    // Aligned words are swapped with a host atomic, so harts on different host
+    // threads can share page tables.
+    inline Transaction<XLEN_t> CompareAndSwap(XLEN_t startAddress, XLEN_t size, char* expected, char* desired) override {
+        if (InBounds(startAddress, size) != size) {
+            return { RISCV::TrapCause::STORE_AMO_ACCESS_FAULT, 0 };
+        }
+        char* target = host + (startAddress - base);
+        Dirty(startAddress - base, size);
+        Unprotect(startAddress - base, size);
+        bool swapped;
+        if (size == 8 && (uintptr_t)target % 8 == 0) {
+            swapped = __atomic_compare_exchange((__uint64_t*)target, (__uint64_t*)expected, (__uint64_t*)desired,
+                                                false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        } else if (size == 4 && (uintptr_t)target % 4 == 0) {
+            swapped = __atomic_compare_exchange((__uint32_t*)target, (__uint32_t*)expected, (__uint32_t*)desired,
+                                                false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+        } else {
+            swapped = memcmp(target, expected, size) == 0;
+            memcpy(swapped ? target : expected, swapped ? desired : target, size);
+        }
+        Reprotect(startAddress - base, size);
+        if (swapped) {
+            InvalidateCode(startAddress - base, size);
+        }
+        if (!watchPages.empty()) [[unlikely]] {
+            CheckWatches(startAddress, size, swapped ? IOVerb::Write : IOVerb::Read);
+        }
+        return { RISCV::TrapCause::NONE, size };
+    }
+
+    // Host view of a guest physical address, or nullptr outside RAM. Loaders
+    // and clients that cache host pointers use this to skip the virtual call.
+    inline char* HostPointer(XLEN_t address) {
+        return InBounds(address, 1) ? host + (address - base) : nullptr;
+    }
+
+    // Hands pages back to the host; they read as zero the next time they're
+    // touched. Both ends are rounded inwards to host page boundaries (2 MiB
+    // ones for explicit huge pages; THP mappings are split as needed).
+    inline void Discard(XLEN_t address, XLEN_t length) {
+        XLEN_t pageSize = hugePages == HugePages::Explicit ? 2 * 1024 * 1024 : 4096;
+        XLEN_t start = (address - base + pageSize - 1) & ~(pageSize - 1);
+        XLEN_t end = (address - base + InBounds(address, length)) & ~(pageSize - 1);
+        if (host != nullptr && end > start) {
+            Dirty(start, end - start);
+            InvalidateCode(start, end - start);
+            madvise(host + start, end - start, MADV_DONTNEED);
+        }
+    }
+
+    // Maps length bytes of fd, from offset, over guest RAM at address, private
+    // and copy-on-write: pages are read in from the file when the guest first
+    // touches them. All three must be host page aligned, and the mapping must
+    // fit in RAM. Returns false if the file can't be mapped there, in which
+    // case the caller has to copy the bytes in instead.
+    inline bool MapFile(XLEN_t address, int fd, off_t offset, XLEN_t length) {
+        if (host == nullptr || hugePages == HugePages::Explicit ||
+            InBounds(address, length) != length ||
+            ((address - base) | offset | length) & (4096 - 1)) {
+            return false;
+        }
+        Dirty(address - base, length);
+        InvalidateCode(address - base, length);
+        void* mapping = mmap(host + (address - base), length, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_FIXED, fd, offset);
+        Reprotect(address - base, length);
+        return mapping != MAP_FAILED;
+    }
+
+    // Zeroes guest RAM. Whole pages are replaced with fresh anonymous ones
+    // rather than written, so they stay uncommitted until touched - and that
+    // also drops any file mapping from MapFile that was there before.
+    inline void Zero(XLEN_t address, XLEN_t length) {
+        length = InBounds(address, length);
+        if (host == nullptr || length == 0) {
+            return;
+        }
+        XLEN_t offset = address - base;
+        Dirty(offset, length);
+        InvalidateCode(offset, length);
+        Unprotect(offset, length);
+        XLEN_t start = (offset + 4096 - 1) & ~(XLEN_t)(4096 - 1);
+        XLEN_t end = (offset + length) & ~(XLEN_t)(4096 - 1);
+        if (hugePages == HugePages::Explicit || end <= start) {
+            memset(host + offset, 0, length);
+        } else {
+            memset(host + offset, 0, start - offset);
+            memset(host + end, 0, offset + length - end);
+            void* mapping = mmap(host + start, end - start, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+            if (mapping == MAP_FAILED) {
+                memset(host + start, 0, end - start);
+            }
+        }
+        Reprotect(offset, length);
+    }
+
+    // Turns on self-modifying code detection. codeWritten gets the guest
+    // address of each code page that is written to, once per MarkCode. With
+    // writeProtect, code pages are also made read-only on the host, so that
+    // stores which bypass Write (FastMemory's) fault into the slow path and get
+    // caught there too. That needs 4 KiB host pages; it fails with explicit
+    // huge pages.
+    inline bool TrackCode(std::function<void(XLEN_t)> callback, bool writeProtect = false) {
+        if (writeProtect && hugePages == HugePages::Explicit) {
+            return false;
+        }
+        ForgetCode();
+        codePages.assign(((size >> CodePageShift) + 64) / 64, 0);
+        codeWritten = callback;
+        protectCode = writeProtect;
+        return true;
+    }
+
+    // Clients call this when they decode (and keep) an instruction at address
+    inline void MarkCode(XLEN_t address) {
+        XLEN_t offset = address - base;
+        if (codePages.empty() || address < base || offset >= size) {
+            return;
+        }
+        XLEN_t page = offset >> CodePageShift;
+        __uint64_t bit = (__uint64_t)1 << (page % 64);
+        if (codePages[page / 64] & bit) [[likely]] {
+            return;
+        }
+        codePages[page / 64] |= bit;
+        if (protectCode) {
+            Protect(page);
+        }
+    }
+
+    // For after the client drops its whole code cache anyway
+    inline void ForgetCode() {
+        for (XLEN_t word = 0; word < codePages.size(); word++) {
+            __uint64_t bits = codePages[word];
+            codePages[word] = 0;
+            for (; bits != 0; bits &= bits - 1) {
+                XLEN_t page = word * 64 + std::countr_zero(bits);
+                if (protectCode) {
+                    Protect(page);
+                }
+            }
+        }
+    }
+
+    // Turns on watchpoints. hit gets the address, size and verb of each read
+    // or write that touches a watched range, after it's done; the client can
+    // stop once the instruction that made it returns. Fetches aren't watched.
+    // With protect, watched pages are protected on the host too, for
+    // FastMemory (see above). That needs 4 KiB host pages, and since read
+    // watches leave their pages inaccessible, clients mustn't run code cached
+    // from host pointers (FetchCache, DecodeCache) out of them.
+    inline bool TrackWatches(std::function<void(XLEN_t, XLEN_t, IOVerb)> hit, bool protect = false) {
+        if (protect && hugePages == HugePages::Explicit) {
+            return false;
+        }
+        watches.clear();
+        RebuildWatchPages();
+        watchHit = hit;
+        protectWatches = protect;
+        return true;
+    }
+
+    inline void Watch(XLEN_t address, XLEN_t length, bool reads, bool writes) {
+        length = InBounds(address, length);
+        if (length == 0 || !watchHit) {
+            return;
+        }
+        watches.push_back({ address, address + length, reads, writes });
+        RebuildWatchPages();
+    }
+
+    // Removes the watches that start at address
+    inline void Unwatch(XLEN_t address) {
+        std::erase_if(watches, [address](const WatchedRange& watch) { return watch.start == address; });
+        RebuildWatchPages();
+    }
+
+    // Takes RAM as it is now as the snapshot for Restore, dropping any earlier
+    // one. With writeProtect, clean pages are read-only on the host (see
+    // above); that needs 4 KiB host pages, and fails with explicit huge pages.
+    inline bool Snapshot(bool writeProtect = false) {
+        if (host == nullptr || (writeProtect && hugePages == HugePages::Explicit)) {
+            return false;
+        }
+        bool wasProtecting = protectClean;
+        dirtyPages.assign(((size >> CodePageShift) + 64) / 64, 0);
+        dirtyList.clear();
+        baseline.clear();
+        protectClean = writeProtect;
+        if (protectClean || wasProtecting) {
+            ProtectAll();
+        }
+        return true;
+    }
+
+    // Puts every page written since the snapshot back as it was, and returns
+    // how many there were. Code decoded from those pages is invalidated as for
+    // any other write; all other code, and every page not written, is left be.
+    inline XLEN_t Restore() {
+        XLEN_t restored = dirtyList.size();
+        for (XLEN_t page : dirtyList) {
+            XLEN_t offset = page << CodePageShift;
+            InvalidateCode(offset, PageBytes(page));
+            if (Protecting()) {
+                mprotect(host + offset, (XLEN_t)1 << CodePageShift, PROT_READ | PROT_WRITE);
+            }
+            memcpy(host + offset, baseline[page].get(), PageBytes(page));
+            dirtyPages[page / 64] &= ~((__uint64_t)1 << (page % 64));
+            if (Protecting()) {
+                Protect(page);
+            }
+        }
+        dirtyList.clear();
+        return restored;
+    }
+
+    // Stops tracking writes, and lets the snapshot go
+    inline void DropSnapshot() {
+        bool wasProtecting = protectClean;
+        dirtyPages.clear();
+        dirtyList.clear();
+        baseline.clear();
+        protectClean = false;
+        if (wasProtecting) {
+            ProtectAll();
+        }
+    }
+
+    inline XLEN_t DirtyPages() { return dirtyList.size(); }
+
+    inline char* Host() { return host; }
+    inline XLEN_t Base() { return base; }
+    inline XLEN_t Size() { return size; }
+    inline HugePages HugePageMode() { return hugePages; }
+
+};
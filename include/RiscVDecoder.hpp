@@ -5,11 +5,17 @@
  * exhaustive tabular walkthrough of the whole encoding space of RISC-V. The
  * trick to making everything go fast is that this is all constexpr, so the
  * compiler can precompute tables that feed into faster decoder strategies.
+ *
+ * Compressed instructions don't get executors of their own. Each 16-bit
+ * encoding is expanded into its 32-bit equivalent (see expand_compressed) and
+ * decoded as that, so clients must hand executors the canonical_encoding of
+ * whatever they fetched, not the raw bits.
  */
 
 #include <DecodedInstruction.hpp>
 #include <RiscV.hpp>
 #include <Instructions.hpp>
+#include <VectorInstructions.hpp>
 
 #define QUADRANT ExtendBits::Zero, 1, 0
 #define OPCODE   ExtendBits::Zero, 6, 2
@@ -18,310 +24,913 @@
 #define FUNCT7   ExtendBits::Zero, 31, 25
 #define SHAMT    ExtendBits::Zero, 24, 20
 #define FUNCT5   ExtendBits::Zero, 31, 27
+#define FP_FMT   ExtendBits::Zero, 26, 25
+#define FUNCT6   ExtendBits::Zero, 31, 26
+#define V_MOP    ExtendBits::Zero, 27, 26
+#define V_MEW    ExtendBits::Zero, 28, 28
 #define C_FUNCT2 ExtendBits::Zero, 6, 5
 #define C_FUNCT3 ExtendBits::Zero, 15, 13
 #define C_FUNCT4 ExtendBits::Zero, 15, 12
 #define C_FUNCT6 ExtendBits::Zero, 15, 10
 
-template<typename XLEN_t>
-constexpr Instruction<XLEN_t> decode_instruction(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+#define CL_UIMM_W  ExtendBits::Zero, 5, 5, 12, 10, 6, 6, 2
+#define CL_UIMM_D  ExtendBits::Zero, 6, 5, 12, 10, 3
+#define CL_UIMM_Q  ExtendBits::Zero, 10, 10, 6, 5, 12, 11, 4
+#define CI_IMM     ExtendBits::Sign, 12, 12, 6, 2
+#define CI_LUI_IMM ExtendBits::Sign, 12, 12, 6, 2, 12
+#define CI_SP_IMM  ExtendBits::Sign, 12, 12, 4, 3, 5, 5, 2, 2, 6, 6, 4
+#define CIW_UIMM   ExtendBits::Zero, 10, 7, 12, 11, 5, 5, 6, 6, 2
+#define CI_UIMM_W  ExtendBits::Zero, 3, 2, 12, 12, 6, 4, 2
+#define CI_UIMM_D  ExtendBits::Zero, 4, 2, 12, 12, 6, 5, 3
+#define CI_UIMM_Q  ExtendBits::Zero, 5, 2, 12, 12, 6, 6, 4
+#define CSS_UIMM_W ExtendBits::Zero, 8, 7, 12, 9, 2
+#define CSS_UIMM_D ExtendBits::Zero, 9, 7, 12, 10, 3
+#define CSS_UIMM_Q ExtendBits::Zero, 10, 7, 12, 11, 4
+#define CB_IMM     ExtendBits::Sign, 12, 12, 6, 5, 2, 2, 11, 10, 4, 3, 1
+#define CJ_IMM     ExtendBits::Sign, 12, 12, 8, 8, 10, 9, 6, 6, 7, 7, 2, 2, 11, 11, 5, 3, 1
+
+// The encoders below build the 32-bit equivalents of compressed instructions.
+// They leave 0b01 in the quadrant bits, which is how executors tell the two
+// forms apart (see inst_length).
+
+constexpr __uint32_t expanded_r_type(__uint32_t opcode, __uint32_t rd, __uint32_t op_minor, __uint32_t rs1, __uint32_t rs2) {
+    return (swizzle<__uint32_t, ExtendBits::Zero, 9, 3>(op_minor) << 25) | (rs2 << 20) | (rs1 << 15) |
+           (swizzle<__uint32_t, ExtendBits::Zero, 2, 0>(op_minor) << 12) | (rd << 7) | (opcode << 2) | 0b01;
+}
+
+constexpr __uint32_t expanded_i_type(__uint32_t opcode, __uint32_t rd, __uint32_t funct3, __uint32_t rs1, __uint32_t imm) {
+    return (swizzle<__uint32_t, ExtendBits::Zero, 11, 0>(imm) << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | (opcode << 2) | 0b01;
+}
+
+constexpr __uint32_t expanded_s_type(__uint32_t opcode, __uint32_t funct3, __uint32_t rs1, __uint32_t rs2, __uint32_t imm) {
+    return (swizzle<__uint32_t, ExtendBits::Zero, 11, 5>(imm) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+           (swizzle<__uint32_t, ExtendBits::Zero, 4, 0>(imm) << 7) | (opcode << 2) | 0b01;
+}
+
+constexpr __uint32_t expanded_b_type(__uint32_t opcode, __uint32_t funct3, __uint32_t rs1, __uint32_t rs2, __uint32_t imm) {
+    return (swizzle<__uint32_t, ExtendBits::Zero, 12, 12, 10, 5>(imm) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+           (swizzle<__uint32_t, ExtendBits::Zero, 4, 1, 11, 11>(imm) << 7) | (opcode << 2) | 0b01;
+}
+
+constexpr __uint32_t expanded_u_type(__uint32_t opcode, __uint32_t rd, __uint32_t imm) {
+    return (imm & 0xfffff000) | (rd << 7) | (opcode << 2) | 0b01;
+}
+
+constexpr __uint32_t expanded_j_type(__uint32_t opcode, __uint32_t rd, __uint32_t imm) {
+    return (swizzle<__uint32_t, ExtendBits::Zero, 20, 20, 10, 1, 11, 11, 19, 12>(imm) << 12) | (rd << 7) | (opcode << 2) | 0b01;
+}
+
+// Returns the 32-bit equivalent of a compressed encoding, or zero if the
+// encoding is reserved under this MXLEN. Zero can't be confused with a real
+// expansion, since every expansion has a non-zero opcode field.
+constexpr __uint32_t expand_compressed(__uint32_t inst, RISCV::XlenMode mxlen) {
+
+    __uint32_t rd_rs1 = swizzle<__uint32_t, CI_RD_RS1>(inst);
+    __uint32_t rs2 = swizzle<__uint32_t, CR_RS2>(inst);
+    __uint32_t rdx_rs2x = swizzle<__uint32_t, CL_RDX>(inst)+8;
+    __uint32_t rs1x = swizzle<__uint32_t, CL_RS1X>(inst)+8;
+
     switch (swizzle<__uint32_t, QUADRANT>(inst)) {
-    case RISCV::OpcodeQuadrant::UNCOMPRESSED:
-        switch (swizzle<__uint32_t, OPCODE>(inst)) {
-        case RISCV::MajorOpcode::LOAD:
-            switch (swizzle<__uint32_t, FUNCT3>(inst)) {
-            case RISCV::MinorOpcode::LB: return inst_lb<XLEN_t>;
-            case RISCV::MinorOpcode::LH: return inst_lh<XLEN_t>;
-            case RISCV::MinorOpcode::LW: return inst_lw<XLEN_t>;
-            case RISCV::MinorOpcode::LD: return inst_ld<XLEN_t>;
-            case RISCV::MinorOpcode::LBU: return inst_lbu<XLEN_t>;
-            case RISCV::MinorOpcode::LHU: return inst_lhu<XLEN_t>;
-            case RISCV::MinorOpcode::LWU: return inst_lwu<XLEN_t>;
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::LOAD_FP: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::CUSTOM_0: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::MISC_MEM: 
-            switch (swizzle<__uint32_t, FUNCT3>(inst)) {
-            case RISCV::MinorOpcode::FENCE: return inst_fence<XLEN_t>;
-            case RISCV::MinorOpcode::FENCE_I: return inst_fencei<XLEN_t>;
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::OP_IMM:
-            // TODO: strictly speaking, SLLI is only valid if FUNCT7 is all zeroes. There are a lot of little non-strict d/c encodings throughout the decoder.
-            switch (swizzle<__uint32_t, FUNCT3>(inst)) {
-            case RISCV::MinorOpcode::ADDI: return inst_addi<XLEN_t>;
-            case RISCV::MinorOpcode::SLLI: return inst_slli<XLEN_t>;
-            case RISCV::MinorOpcode::SLTI: return inst_slti<XLEN_t>;
-            case RISCV::MinorOpcode::SLTIU: return inst_sltiu<XLEN_t>;
-            case RISCV::MinorOpcode::XORI: return inst_xori<XLEN_t>;
-            case RISCV::MinorOpcode::SRI:
-                switch(swizzle<__uint32_t, FUNCT7>(inst)) {
-                case RISCV::SubMinorOpcode::SRAI: return inst_srai<XLEN_t>;
-                case RISCV::SubMinorOpcode::SRLI: return inst_srli<XLEN_t>;
-                default: return inst_illegal<XLEN_t>;
-                }
-            case RISCV::MinorOpcode::ORI: return inst_ori<XLEN_t>;
-            case RISCV::MinorOpcode::ANDI: return inst_andi<XLEN_t>;
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::AUIPC: return inst_auipc<XLEN_t>;
-        case RISCV::MajorOpcode::OP_IMM_32:
-            if (mxlen == RISCV::XlenMode::XL32)
-                return inst_illegal<XLEN_t>; // Reserved encoding
-            switch (swizzle<__uint32_t, FUNCT3>(inst)) {
-            case RISCV::MinorOpcode::ADDIW: return inst_addiw<XLEN_t>;
-            case RISCV::MinorOpcode::SLLIW: return inst_slliw<XLEN_t>;
-            case RISCV::MinorOpcode::SRI:
-                switch(swizzle<__uint32_t, FUNCT7>(inst)) {
-                case RISCV::SubMinorOpcode::SRAIW: return inst_sraiw<XLEN_t>;
-                case RISCV::SubMinorOpcode::SRLIW: return inst_srliw<XLEN_t>;
-                default: return inst_illegal<XLEN_t>;
-                }
-            default: return inst_illegal<XLEN_t>;
-        }
-        case RISCV::MajorOpcode::LONG_48B_1: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::STORE:
-            switch (swizzle<__uint32_t, FUNCT3>(inst)) {
-            case RISCV::MinorOpcode::SB: return inst_sb<XLEN_t>;
-            case RISCV::MinorOpcode::SH: return inst_sh<XLEN_t>;
-            case RISCV::MinorOpcode::SW: return inst_sw<XLEN_t>;
-            case RISCV::MinorOpcode::SD: return inst_sd<XLEN_t>;
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::STORE_FP: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::CUSTOM_1: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::AMO:
-            switch (swizzle<__uint32_t, FUNCT3>(inst)) {
-            case RISCV::AmoWidth::AMO_W:
-                switch (swizzle<__uint32_t, FUNCT5>(inst)) {
-                case RISCV::MinorOpcode::AMOADD: return inst_amoaddw<XLEN_t>;
-                case RISCV::MinorOpcode::AMOSWAP: return inst_amoswapw<XLEN_t>;
-                case RISCV::MinorOpcode::LR: return inst_lrw<XLEN_t>;
-                case RISCV::MinorOpcode::SC: return inst_scw<XLEN_t>;
-                case RISCV::MinorOpcode::AMOXOR: return inst_amoxorw<XLEN_t>;
-                case RISCV::MinorOpcode::AMOOR: return inst_amoorw<XLEN_t>;
-                case RISCV::MinorOpcode::AMOAND: return inst_amoandw<XLEN_t>;
-                case RISCV::MinorOpcode::AMOMIN: return inst_amominw<XLEN_t>;
-                case RISCV::MinorOpcode::AMOMAX: return inst_amomaxw<XLEN_t>;
-                case RISCV::MinorOpcode::AMOMINU: return inst_amominuw<XLEN_t>;
-                case RISCV::MinorOpcode::AMOMAXU: return inst_amomaxuw<XLEN_t>;
-                default: return inst_illegal<XLEN_t>;
-                }
-            case RISCV::AmoWidth::AMO_D:
-                switch (swizzle<__uint32_t, FUNCT5>(inst)) {
-                case RISCV::MinorOpcode::AMOADD: return inst_amoaddd<XLEN_t>;
-                case RISCV::MinorOpcode::AMOSWAP: return inst_amoswapd<XLEN_t>;
-                case RISCV::MinorOpcode::LR: return inst_lrd<XLEN_t>;
-                case RISCV::MinorOpcode::SC: return inst_scd<XLEN_t>;
-                case RISCV::MinorOpcode::AMOXOR: return inst_amoxord<XLEN_t>;
-                case RISCV::MinorOpcode::AMOOR: return inst_amoord<XLEN_t>;
-                case RISCV::MinorOpcode::AMOAND: return inst_amoandd<XLEN_t>;
-                case RISCV::MinorOpcode::AMOMIN: return inst_amomind<XLEN_t>;
-                case RISCV::MinorOpcode::AMOMAX: return inst_amomaxd<XLEN_t>;
-                case RISCV::MinorOpcode::AMOMINU: return inst_amominud<XLEN_t>;
-                case RISCV::MinorOpcode::AMOMAXU: return inst_amomaxud<XLEN_t>;
-                default: return inst_illegal<XLEN_t>;
-                }
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::OP:
-            switch (swizzle<__uint32_t, OP_MINOR>(inst)) {
-            case RISCV::MinorOpcode::ADD: return inst_add<XLEN_t>;
-            case RISCV::MinorOpcode::SUB: return inst_sub<XLEN_t>;
-            case RISCV::MinorOpcode::SLL: return inst_sll<XLEN_t>;
-            case RISCV::MinorOpcode::SLT: return inst_slt<XLEN_t>;
-            case RISCV::MinorOpcode::SLTU: return inst_sltu<XLEN_t>;
-            case RISCV::MinorOpcode::XOR: return inst_xor<XLEN_t>;
-            case RISCV::MinorOpcode::SRA: return inst_sra<XLEN_t>;
-            case RISCV::MinorOpcode::SRL: return inst_srl<XLEN_t>;
-            case RISCV::MinorOpcode::OR: return inst_or<XLEN_t>;
-            case RISCV::MinorOpcode::AND: return inst_and<XLEN_t>;
-            case RISCV::MinorOpcode::MUL: return inst_mul<XLEN_t>;
-            case RISCV::MinorOpcode::MULH: return inst_mulh<XLEN_t>;
-            case RISCV::MinorOpcode::MULHSU: return inst_mulhsu<XLEN_t>;
-            case RISCV::MinorOpcode::MULHU: return inst_mulhu<XLEN_t>;
-            case RISCV::MinorOpcode::DIV: return inst_div<XLEN_t>;
-            case RISCV::MinorOpcode::DIVU: return inst_divu<XLEN_t>;
-            case RISCV::MinorOpcode::REM: return inst_rem<XLEN_t>;
-            case RISCV::MinorOpcode::REMU: return inst_remu<XLEN_t>;
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::LUI: return inst_lui<XLEN_t>;
-        case RISCV::MajorOpcode::OP_32:
-            if (mxlen == RISCV::XlenMode::XL32)
-                return inst_illegal<XLEN_t>;
-            switch (swizzle<__uint32_t, OP_MINOR>(inst)) {
-            case RISCV::MinorOpcode::ADDW: return inst_addw<XLEN_t>;
-            case RISCV::MinorOpcode::SUBW: return inst_subw<XLEN_t>;
-            case RISCV::MinorOpcode::SLLW: return inst_sllw<XLEN_t>;
-            case RISCV::MinorOpcode::SRLW: return inst_srlw<XLEN_t>;
-            case RISCV::MinorOpcode::SRAW: return inst_sraw<XLEN_t>;
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::LONG_64B: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::MADD: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::MSUB: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::NMSUB: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::NMADD: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::OP_FP: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::RESERVED_0: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::CUSTOM_2: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::LONG_48B_2: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::BRANCH:
-            switch (swizzle<__uint32_t, FUNCT3>(inst)) {
-            case RISCV::MinorOpcode::BEQ: return inst_beq<XLEN_t>;
-            case RISCV::MinorOpcode::BNE: return inst_bne<XLEN_t>;
-            case RISCV::MinorOpcode::BLT: return inst_blt<XLEN_t>;
-            case RISCV::MinorOpcode::BGE: return inst_bge<XLEN_t>;
-            case RISCV::MinorOpcode::BLTU: return inst_bltu<XLEN_t>;
-            case RISCV::MinorOpcode::BGEU: return inst_bgeu<XLEN_t>;
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::JALR: return inst_jalr<XLEN_t>;
-        case RISCV::MajorOpcode::RESERVED_1: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::JAL: return inst_jal<XLEN_t>;
-        case RISCV::MajorOpcode::SYSTEM:
-            switch (swizzle<__uint32_t, FUNCT3>(inst)) {
-            case RISCV::MinorOpcode::PRIV:
-                switch (swizzle<__uint32_t, FUNCT7>(inst)) {
-                case RISCV::SubMinorOpcode::ECALL_EBREAK_URET:
-                    switch (swizzle<__uint32_t, RS2>(inst)) {
-                    case RISCV::SubSubMinorOpcode::ECALL: return inst_ecall<XLEN_t>;
-                    case RISCV::SubSubMinorOpcode::EBREAK: return inst_ebreak<XLEN_t>;
-                    case RISCV::SubSubMinorOpcode::URET: return inst_uret<XLEN_t>;
-                    default: return inst_illegal<XLEN_t>;
-                    }
-                case RISCV::SubMinorOpcode::SRET_WFI:
-                    switch (swizzle<__uint32_t, RS2>(inst)) {
-                    case RISCV::SubSubMinorOpcode::WFI: return inst_wfi<XLEN_t>;
-                    case RISCV::SubSubMinorOpcode::SRET: return inst_sret<XLEN_t>;
-                    default: return inst_illegal<XLEN_t>;
-                    }
-                case RISCV::SubMinorOpcode::MRET: return inst_mret<XLEN_t>;
-                case RISCV::SFENCE_VMA: return inst_sfencevma<XLEN_t>;
-                default: return inst_illegal<XLEN_t>;
-                }
-            case RISCV::MinorOpcode::CSRRW: return inst_csrrw<XLEN_t>;
-            case RISCV::MinorOpcode::CSRRS: return inst_csrrs<XLEN_t>;
-            case RISCV::MinorOpcode::CSRRC: return inst_csrrc<XLEN_t>;
-            case RISCV::MinorOpcode::CSRRWI: return inst_csrrwi<XLEN_t>;
-            case RISCV::MinorOpcode::CSRRSI: return inst_csrrsi<XLEN_t>;
-            case RISCV::MinorOpcode::CSRRCI: return inst_csrrci<XLEN_t>;
-            default: return inst_illegal<XLEN_t>;
-            }
-        case RISCV::MajorOpcode::RESERVED_2: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::CUSTOM_3: return inst_unimplemented<XLEN_t>;
-        case RISCV::MajorOpcode::LONG_80B: return inst_unimplemented<XLEN_t>;
-        default: return inst_illegal<XLEN_t>;
-        }
     case RISCV::OpcodeQuadrant::Q0:
         switch(swizzle<__uint32_t, C_FUNCT3>(inst)) {
-        case 0:
-            if (swizzle<__uint32_t, ExtendBits::Zero, 10, 7, 12, 11, 5, 5, 6, 6, 2>(inst) == 0)
-                return inst_illegal<XLEN_t>;
-            return inst_caddi4spn<XLEN_t>;
+        case 0: // C.ADDI4SPN
+            if (swizzle<__uint32_t, CIW_UIMM>(inst) == 0)
+                return 0; // Reserved encoding
+            return expanded_i_type(RISCV::MajorOpcode::OP_IMM, rdx_rs2x, RISCV::MinorOpcode::ADDI, 2, swizzle<__uint32_t, CIW_UIMM>(inst));
         case 1:
-            if (mxlen == RISCV::XlenMode::XL32 || mxlen == RISCV::XlenMode::XL64)
-                return inst_unimplemented<XLEN_t>; // C.FLD TODO
-            return inst_clq<XLEN_t>;
-        case 2: return inst_clw<XLEN_t>;
+            if (mxlen == RISCV::XlenMode::XL128) // C.LQ
+                return expanded_i_type(RISCV::MajorOpcode::MISC_MEM, rdx_rs2x, 2, rs1x, swizzle<__uint32_t, CL_UIMM_Q>(inst));
+            return expanded_i_type(RISCV::MajorOpcode::LOAD_FP, rdx_rs2x, 3, rs1x, swizzle<__uint32_t, CL_UIMM_D>(inst)); // C.FLD
+        case 2: // C.LW
+            return expanded_i_type(RISCV::MajorOpcode::LOAD, rdx_rs2x, RISCV::MinorOpcode::LW, rs1x, swizzle<__uint32_t, CL_UIMM_W>(inst));
         case 3:
-            if (mxlen == RISCV::XlenMode::XL32)
-                return inst_unimplemented<XLEN_t>; // C.FLW TODO
-            return inst_cld<XLEN_t>;
-        case 4: return inst_illegal<XLEN_t>; // Reserved encoding
+            if (mxlen == RISCV::XlenMode::XL32) // C.FLW
+                return expanded_i_type(RISCV::MajorOpcode::LOAD_FP, rdx_rs2x, 2, rs1x, swizzle<__uint32_t, CL_UIMM_W>(inst));
+            return expanded_i_type(RISCV::MajorOpcode::LOAD, rdx_rs2x, RISCV::MinorOpcode::LD, rs1x, swizzle<__uint32_t, CL_UIMM_D>(inst)); // C.LD
+        case 4: return 0; // Reserved encoding
         case 5:
-            if (mxlen == RISCV::XlenMode::XL32 || mxlen == RISCV::XlenMode::XL64)
-                return inst_unimplemented<XLEN_t>; // C.FSD TODO
-            return inst_csq<XLEN_t>;
-        case 6: return inst_csw<XLEN_t>;
+            if (mxlen == RISCV::XlenMode::XL128) // C.SQ
+                return expanded_s_type(RISCV::MajorOpcode::STORE, 4, rs1x, rdx_rs2x, swizzle<__uint32_t, CL_UIMM_Q>(inst));
+            return expanded_s_type(RISCV::MajorOpcode::STORE_FP, 3, rs1x, rdx_rs2x, swizzle<__uint32_t, CL_UIMM_D>(inst)); // C.FSD
+        case 6: // C.SW
+            return expanded_s_type(RISCV::MajorOpcode::STORE, RISCV::MinorOpcode::SW, rs1x, rdx_rs2x, swizzle<__uint32_t, CL_UIMM_W>(inst));
         case 7:
-            if (mxlen == RISCV::XlenMode::XL32)
-                return inst_unimplemented<XLEN_t>; // C.FSW TODO
-            return inst_csd<XLEN_t>;
-        default: return inst_illegal<XLEN_t>;
+            if (mxlen == RISCV::XlenMode::XL32) // C.FSW
+                return expanded_s_type(RISCV::MajorOpcode::STORE_FP, 2, rs1x, rdx_rs2x, swizzle<__uint32_t, CL_UIMM_W>(inst));
+            return expanded_s_type(RISCV::MajorOpcode::STORE, RISCV::MinorOpcode::SD, rs1x, rdx_rs2x, swizzle<__uint32_t, CL_UIMM_D>(inst)); // C.SD
+        default: return 0;
         }
     case RISCV::OpcodeQuadrant::Q1:
         switch(swizzle<__uint32_t, C_FUNCT3>(inst)) {
-        case 0: return inst_caddi<XLEN_t>; // Note that NOP is the same instruction
+        case 0: // C.ADDI, and C.NOP when rd is x0
+            return expanded_i_type(RISCV::MajorOpcode::OP_IMM, rd_rs1, RISCV::MinorOpcode::ADDI, rd_rs1, swizzle<__uint32_t, CI_IMM>(inst));
         case 1:
-            if (mxlen == RISCV::XlenMode::XL32)
-                return inst_cjal<XLEN_t>;
-            return inst_unimplemented<XLEN_t>; // C.ADDIW TODO
-        case 2: return inst_cli<XLEN_t>;
+            if (mxlen == RISCV::XlenMode::XL32) // C.JAL
+                return expanded_j_type(RISCV::MajorOpcode::JAL, 1, swizzle<__uint32_t, CJ_IMM>(inst));
+            if (rd_rs1 == 0)
+                return 0; // Reserved encoding
+            return expanded_i_type(RISCV::MajorOpcode::OP_IMM_32, rd_rs1, RISCV::MinorOpcode::ADDIW, rd_rs1, swizzle<__uint32_t, CI_IMM>(inst)); // C.ADDIW
+        case 2: // C.LI
+            return expanded_i_type(RISCV::MajorOpcode::OP_IMM, rd_rs1, RISCV::MinorOpcode::ADDI, 0, swizzle<__uint32_t, CI_IMM>(inst));
         case 3:
-            if (swizzle<__uint32_t, CI_RD_RS1>(inst) != 2)
-                return inst_clui<XLEN_t>;
-            if (swizzle<__uint32_t, ExtendBits::Sign, 12, 12, 4, 3, 5, 5, 2, 2, 6, 6, 4>(inst) != 0)
-                return inst_caddi16sp<XLEN_t>;
-            return inst_illegal<XLEN_t>; // Reserved encoding
-        case 4:
+            if (rd_rs1 == 2) { // C.ADDI16SP
+                if (swizzle<__uint32_t, CI_SP_IMM>(inst) == 0)
+                    return 0; // Reserved encoding
+                return expanded_i_type(RISCV::MajorOpcode::OP_IMM, 2, RISCV::MinorOpcode::ADDI, 2, swizzle<__uint32_t, CI_SP_IMM>(inst));
+            }
+            if (swizzle<__uint32_t, CI_LUI_IMM>(inst) == 0)
+                return 0; // Reserved encoding
+            return expanded_u_type(RISCV::MajorOpcode::LUI, rd_rs1, swizzle<__uint32_t, CI_LUI_IMM>(inst)); // C.LUI
+        case 4: {
+            __uint32_t shamt = swizzle<__uint32_t, CB_SHAMT>(inst);
+            if (mxlen == RISCV::XlenMode::XL128 && shamt == 0)
+                shamt = 64;
             switch (swizzle<__uint32_t, ExtendBits::Zero, 11, 10>(inst)) {
-            case 0:
-                if (mxlen == RISCV::XlenMode::XL32)
-                    if (swizzle<__uint32_t, CB_SHAMT>(inst) & 1 << 5)
-                        return inst_illegal<XLEN_t>; // Reserved encoding
-                return inst_csrli<XLEN_t>;
-            case 1:
-                if (mxlen == RISCV::XlenMode::XL32)
-                    if (swizzle<__uint32_t, CB_SHAMT>(inst) & 1 << 5)
-                        return inst_illegal<XLEN_t>; // Reserved encoding
-                return inst_csrai<XLEN_t>;
-            case 2: return inst_candi<XLEN_t>;
+            case 0: // C.SRLI
+                if (mxlen == RISCV::XlenMode::XL32 && (shamt & 1 << 5))
+                    return 0; // Reserved encoding
+                return expanded_i_type(RISCV::MajorOpcode::OP_IMM, rs1x, RISCV::MinorOpcode::SRI, rs1x, shamt);
+            case 1: // C.SRAI
+                if (mxlen == RISCV::XlenMode::XL32 && (shamt & 1 << 5))
+                    return 0; // Reserved encoding
+                return expanded_i_type(RISCV::MajorOpcode::OP_IMM, rs1x, RISCV::MinorOpcode::SRI, rs1x, (RISCV::SubMinorOpcode::SRAI << 5) | shamt);
+            case 2: // C.ANDI
+                return expanded_i_type(RISCV::MajorOpcode::OP_IMM, rs1x, RISCV::MinorOpcode::ANDI, rs1x, swizzle<__uint32_t, CI_IMM>(inst));
             case 3:
                 switch(swizzle<__uint32_t, ExtendBits::Zero, 12, 12, 6, 5>(inst)) {
-                case 0: return inst_csub<XLEN_t>;
-                case 1: return inst_cxor<XLEN_t>;
-                case 2: return inst_cor<XLEN_t>;
-                case 3: return inst_cand<XLEN_t>;
-                case 4: return inst_unimplemented<XLEN_t>; // C.SUBW TODO
-                case 5: return inst_unimplemented<XLEN_t>; // C.ADDW TODO
-                case 6: return inst_illegal<XLEN_t>; // Reserved encoding
-                case 7: return inst_illegal<XLEN_t>; // Reserved encoding
-                default: return inst_illegal<XLEN_t>;
+                case 0: return expanded_r_type(RISCV::MajorOpcode::OP, rs1x, RISCV::MinorOpcode::SUB, rs1x, rdx_rs2x);
+                case 1: return expanded_r_type(RISCV::MajorOpcode::OP, rs1x, RISCV::MinorOpcode::XOR, rs1x, rdx_rs2x);
+                case 2: return expanded_r_type(RISCV::MajorOpcode::OP, rs1x, RISCV::MinorOpcode::OR, rs1x, rdx_rs2x);
+                case 3: return expanded_r_type(RISCV::MajorOpcode::OP, rs1x, RISCV::MinorOpcode::AND, rs1x, rdx_rs2x);
+                case 4:
+                    if (mxlen == RISCV::XlenMode::XL32)
+                        return 0; // Reserved encoding
+                    return expanded_r_type(RISCV::MajorOpcode::OP_32, rs1x, RISCV::MinorOpcode::SUBW, rs1x, rdx_rs2x);
+                case 5:
+                    if (mxlen == RISCV::XlenMode::XL32)
+                        return 0; // Reserved encoding
+                    return expanded_r_type(RISCV::MajorOpcode::OP_32, rs1x, RISCV::MinorOpcode::ADDW, rs1x, rdx_rs2x);
+                default: return 0; // Reserved encoding
                 }
-            default: return inst_illegal<XLEN_t>;
+            default: return 0;
             }
-        case 5: return inst_cj<XLEN_t>;
-        case 6: return inst_cbeqz<XLEN_t>;
-        case 7: return inst_cbnez<XLEN_t>;
-        default: return inst_illegal<XLEN_t>;
+        }
+        case 5: // C.J
+            return expanded_j_type(RISCV::MajorOpcode::JAL, 0, swizzle<__uint32_t, CJ_IMM>(inst));
+        case 6: // C.BEQZ
+            return expanded_b_type(RISCV::MajorOpcode::BRANCH, RISCV::MinorOpcode::BEQ, rs1x, 0, swizzle<__uint32_t, CB_IMM>(inst));
+        case 7: // C.BNEZ
+            return expanded_b_type(RISCV::MajorOpcode::BRANCH, RISCV::MinorOpcode::BNE, rs1x, 0, swizzle<__uint32_t, CB_IMM>(inst));
+        default: return 0;
         }
     case RISCV::OpcodeQuadrant::Q2:
         switch(swizzle<__uint32_t, C_FUNCT3>(inst)) {
-        case 0:
-            if (mxlen == RISCV::XlenMode::XL32)
-                if (swizzle<__uint32_t, CI_SHAMT>(inst) & 1 << 5)
-                    return inst_illegal<XLEN_t>; // Reserved encoding
-            return inst_cslli<XLEN_t>;
+        case 0: { // C.SLLI
+            __uint32_t shamt = swizzle<__uint32_t, CI_SHAMT>(inst);
+            if (mxlen == RISCV::XlenMode::XL32 && (shamt & 1 << 5))
+                return 0; // Reserved encoding
+            if (mxlen == RISCV::XlenMode::XL128 && shamt == 0)
+                shamt = 64;
+            return expanded_i_type(RISCV::MajorOpcode::OP_IMM, rd_rs1, RISCV::MinorOpcode::SLLI, rd_rs1, shamt);
+        }
         case 1:
-            if (mxlen == RISCV::XlenMode::XL32 || mxlen == RISCV::XlenMode::XL64)
-                return inst_unimplemented<XLEN_t>; // C.FLDSP TODO
-            return inst_unimplemented<XLEN_t>; // C.LQSP TODO
-        case 2: return inst_clwsp<XLEN_t>;
-        case 3: return inst_unimplemented<XLEN_t>; // C.FLWSP C.LDSP TODO
+            if (mxlen == RISCV::XlenMode::XL128) { // C.LQSP
+                if (rd_rs1 == 0)
+                    return 0; // Reserved encoding
+                return expanded_i_type(RISCV::MajorOpcode::MISC_MEM, rd_rs1, 2, 2, swizzle<__uint32_t, CI_UIMM_Q>(inst));
+            }
+            return expanded_i_type(RISCV::MajorOpcode::LOAD_FP, rd_rs1, 3, 2, swizzle<__uint32_t, CI_UIMM_D>(inst)); // C.FLDSP
+        case 2: // C.LWSP
+            if (rd_rs1 == 0)
+                return 0; // Reserved encoding
+            return expanded_i_type(RISCV::MajorOpcode::LOAD, rd_rs1, RISCV::MinorOpcode::LW, 2, swizzle<__uint32_t, CI_UIMM_W>(inst));
+        case 3:
+            if (mxlen == RISCV::XlenMode::XL32) // C.FLWSP
+                return expanded_i_type(RISCV::MajorOpcode::LOAD_FP, rd_rs1, 2, 2, swizzle<__uint32_t, CI_UIMM_W>(inst));
+            if (rd_rs1 == 0)
+                return 0; // Reserved encoding
+            return expanded_i_type(RISCV::MajorOpcode::LOAD, rd_rs1, RISCV::MinorOpcode::LD, 2, swizzle<__uint32_t, CI_UIMM_D>(inst)); // C.LDSP
         case 4:
             if (inst & 1 << 12) {
-                if (swizzle<__uint32_t, ExtendBits::Zero, 6, 2>(inst) == 0) {
-                    if (swizzle<__uint32_t, ExtendBits::Zero, 11, 7>(inst) == 0)
-                        return inst_cebreak<XLEN_t>;
-                    return inst_cjalr<XLEN_t>;
+                if (rs2 == 0) {
+                    if (rd_rs1 == 0) // C.EBREAK
+                        return expanded_i_type(RISCV::MajorOpcode::SYSTEM, 0, RISCV::MinorOpcode::PRIV, 0, RISCV::SubSubMinorOpcode::EBREAK);
+                    return expanded_i_type(RISCV::MajorOpcode::JALR, 1, 0, rd_rs1, 0); // C.JALR
                 }
-                return inst_cadd<XLEN_t>;
-            } else {
-                if (swizzle<__uint32_t, ExtendBits::Zero, 6, 2>(inst) == 0)
-                    return inst_cjr<XLEN_t>;
-                return inst_cmv<XLEN_t>;
+                return expanded_r_type(RISCV::MajorOpcode::OP, rd_rs1, RISCV::MinorOpcode::ADD, rd_rs1, rs2); // C.ADD
+            }
+            if (rs2 == 0) {
+                if (rd_rs1 == 0)
+                    return 0; // Reserved encoding
+                return expanded_i_type(RISCV::MajorOpcode::JALR, 0, 0, rd_rs1, 0); // C.JR
             }
-        case 5: return inst_unimplemented<XLEN_t>; // C.FSDSP C.SQSP TODO
-        case 6: return inst_cswsp<XLEN_t>;
+            return expanded_r_type(RISCV::MajorOpcode::OP, rd_rs1, RISCV::MinorOpcode::ADD, 0, rs2); // C.MV
+        case 5:
+            if (mxlen == RISCV::XlenMode::XL128) // C.SQSP
+                return expanded_s_type(RISCV::MajorOpcode::STORE, 4, 2, rs2, swizzle<__uint32_t, CSS_UIMM_Q>(inst));
+            return expanded_s_type(RISCV::MajorOpcode::STORE_FP, 3, 2, rs2, swizzle<__uint32_t, CSS_UIMM_D>(inst)); // C.FSDSP
+        case 6: // C.SWSP
+            return expanded_s_type(RISCV::MajorOpcode::STORE, RISCV::MinorOpcode::SW, 2, rs2, swizzle<__uint32_t, CSS_UIMM_W>(inst));
         case 7:
-            if (mxlen == RISCV::XlenMode::XL32)
-                return inst_unimplemented<XLEN_t>; // C.FSWSP TODO
-            return inst_csdsp<XLEN_t>;
+            if (mxlen == RISCV::XlenMode::XL32) // C.FSWSP
+                return expanded_s_type(RISCV::MajorOpcode::STORE_FP, 2, 2, rs2, swizzle<__uint32_t, CSS_UIMM_W>(inst));
+            return expanded_s_type(RISCV::MajorOpcode::STORE, RISCV::MinorOpcode::SD, 2, rs2, swizzle<__uint32_t, CSS_UIMM_D>(inst)); // C.SDSP
+        default: return 0;
+        }
+    default: return 0;
+    }
+}
+
+// The encoding that executors and disassemblers expect: 32-bit instructions
+// pass through untouched, and compressed ones are expanded. Reserved
+// compressed encodings are passed through too. Either way the executor never
+// sees the bits fetched for a compressed instruction, so its illegal-instruction
+// traps report an mtval of 0 (see inst_tval).
+constexpr __uint32_t canonical_encoding(__uint32_t inst, RISCV::XlenMode mxlen) {
+    if (swizzle<__uint32_t, QUADRANT>(inst) == RISCV::OpcodeQuadrant::UNCOMPRESSED) {
+        return inst;
+    }
+    __uint32_t expanded = expand_compressed(inst, mxlen);
+    return expanded ? expanded : inst;
+}
+
+// Whether a canonical encoding ends a basic block: control transfers, SYSTEM
+// (which can trap or change privilege), and fence.i.
+constexpr bool ends_block(__uint32_t encoding) {
+    switch (swizzle<__uint32_t, OPCODE>(encoding)) {
+    case RISCV::MajorOpcode::BRANCH:
+    case RISCV::MajorOpcode::JAL:
+    case RISCV::MajorOpcode::JALR:
+    case RISCV::MajorOpcode::SYSTEM:
+        return true;
+    case RISCV::MajorOpcode::MISC_MEM:
+        return swizzle<__uint32_t, FUNCT3>(encoding) == 1;
+    default:
+        return false;
+    }
+}
+
+// ALU encodings that write x0 are HINTs (C.NOP among them). All they need to
+// do is step the pc, so they share one executor.
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> hint_if_rd_zero(__uint32_t inst, Instruction<XLEN_t> decoded) {
+    if (swizzle<__uint32_t, RD>(inst) == 0 && decoded.executionFunction != inst_illegal<XLEN_t>.executionFunction) {
+        return inst_hint<XLEN_t>;
+    }
+    return decoded;
+}
+
+// Zba, Zbb and Zbs. The extensions vector only has room for single letters, so
+// the three are enabled together by B. OP and OP_32 values are FUNCT7:FUNCT3,
+// the OP_IMM ones are the whole immediate field (or its top six bits, for the
+// ones that take a shift amount).
+enum BitmanipOpcode : __uint32_t {
+    SH1ADD = 0x082, SH2ADD = 0x084, SH3ADD = 0x086,
+    ANDN = 0x107, ORN = 0x106, XNOR = 0x104,
+    MIN = 0x02c, MINU = 0x02d, MAX = 0x02e, MAXU = 0x02f,
+    ROL = 0x181, ROR = 0x185, ZEXT_H = 0x024,
+    BCLR = 0x121, BEXT = 0x125, BINV = 0x1a1, BSET = 0x0a1,
+    ADD_UW = 0x020,
+    CLZ = 0x600, CTZ = 0x601, CPOP = 0x602, SEXT_B = 0x604, SEXT_H = 0x605,
+    ORC_B = 0x287, REV8_32 = 0x698, REV8_64 = 0x6b8,
+    SLLI_UW = 0x02, BCLRI = 0x12, BEXTI = 0x12, BINVI = 0x1a, BSETI = 0x0a, RORI = 0x18
+};
+
+#define IMM_FUNCT6 ExtendBits::Zero, 31, 26
+#define IMM_FULL   ExtendBits::Zero, 31, 20
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op_bitmanip(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    if (!RISCV::vectorHasExtension(extensionsVector, 'B'))
+        return inst_illegal<XLEN_t>;
+    switch (swizzle<__uint32_t, OP_MINOR>(inst)) {
+    case BitmanipOpcode::SH1ADD: return inst_sh1add<XLEN_t>;
+    case BitmanipOpcode::SH2ADD: return inst_sh2add<XLEN_t>;
+    case BitmanipOpcode::SH3ADD: return inst_sh3add<XLEN_t>;
+    case BitmanipOpcode::ANDN: return inst_andn<XLEN_t>;
+    case BitmanipOpcode::ORN: return inst_orn<XLEN_t>;
+    case BitmanipOpcode::XNOR: return inst_xnor<XLEN_t>;
+    case BitmanipOpcode::MIN: return inst_min<XLEN_t>;
+    case BitmanipOpcode::MINU: return inst_minu<XLEN_t>;
+    case BitmanipOpcode::MAX: return inst_max<XLEN_t>;
+    case BitmanipOpcode::MAXU: return inst_maxu<XLEN_t>;
+    case BitmanipOpcode::ROL: return inst_rol<XLEN_t>;
+    case BitmanipOpcode::ROR: return inst_ror<XLEN_t>;
+    case BitmanipOpcode::BCLR: return inst_bclr<XLEN_t>;
+    case BitmanipOpcode::BEXT: return inst_bext<XLEN_t>;
+    case BitmanipOpcode::BINV: return inst_binv<XLEN_t>;
+    case BitmanipOpcode::BSET: return inst_bset<XLEN_t>;
+    case BitmanipOpcode::ZEXT_H: // Lives in OP_32 above RV32
+        if (mxlen != RISCV::XlenMode::XL32 || swizzle<__uint32_t, RS2>(inst) != 0)
+            return inst_illegal<XLEN_t>;
+        return inst_zexth<XLEN_t>;
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op_32_bitmanip(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    if (!RISCV::vectorHasExtension(extensionsVector, 'B'))
+        return inst_illegal<XLEN_t>;
+    switch (swizzle<__uint32_t, OP_MINOR>(inst)) {
+    case BitmanipOpcode::ADD_UW: return inst_adduw<XLEN_t>;
+    case BitmanipOpcode::SH1ADD: return inst_sh1adduw<XLEN_t>;
+    case BitmanipOpcode::SH2ADD: return inst_sh2adduw<XLEN_t>;
+    case BitmanipOpcode::SH3ADD: return inst_sh3adduw<XLEN_t>;
+    case BitmanipOpcode::ROL: return inst_rolw<XLEN_t>;
+    case BitmanipOpcode::ROR: return inst_rorw<XLEN_t>;
+    case BitmanipOpcode::ZEXT_H:
+        if (swizzle<__uint32_t, RS2>(inst) != 0)
+            return inst_illegal<XLEN_t>;
+        return inst_zexth<XLEN_t>;
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+// Everything in the SLLI and SRI spaces that isn't a plain shift
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op_imm_bitmanip(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    if (!RISCV::vectorHasExtension(extensionsVector, 'B'))
+        return inst_illegal<XLEN_t>;
+    // On RV32, shamt[5] is part of the funct field and must be zero
+    bool shamt_ok = mxlen != RISCV::XlenMode::XL32 || !swizzle<__uint32_t, ExtendBits::Zero, 25, 25>(inst);
+    if (swizzle<__uint32_t, FUNCT3>(inst) == RISCV::MinorOpcode::SLLI) {
+        switch (swizzle<__uint32_t, IMM_FULL>(inst)) {
+        case BitmanipOpcode::CLZ: return inst_clz<XLEN_t>;
+        case BitmanipOpcode::CTZ: return inst_ctz<XLEN_t>;
+        case BitmanipOpcode::CPOP: return inst_cpop<XLEN_t>;
+        case BitmanipOpcode::SEXT_B: return inst_sextb<XLEN_t>;
+        case BitmanipOpcode::SEXT_H: return inst_sexth<XLEN_t>;
+        default: break;
+        }
+        switch (swizzle<__uint32_t, IMM_FUNCT6>(inst)) {
+        case BitmanipOpcode::BCLRI: return shamt_ok ? inst_bclri<XLEN_t> : inst_illegal<XLEN_t>;
+        case BitmanipOpcode::BINVI: return shamt_ok ? inst_binvi<XLEN_t> : inst_illegal<XLEN_t>;
+        case BitmanipOpcode::BSETI: return shamt_ok ? inst_bseti<XLEN_t> : inst_illegal<XLEN_t>;
         default: return inst_illegal<XLEN_t>;
         }
+    }
+    switch (swizzle<__uint32_t, IMM_FULL>(inst)) {
+    case BitmanipOpcode::ORC_B: return inst_orcb<XLEN_t>;
+    case BitmanipOpcode::REV8_32: return mxlen == RISCV::XlenMode::XL32 ? inst_rev8<XLEN_t> : inst_illegal<XLEN_t>;
+    case BitmanipOpcode::REV8_64: return mxlen == RISCV::XlenMode::XL64 ? inst_rev8<XLEN_t> : inst_illegal<XLEN_t>;
+    default: break;
+    }
+    switch (swizzle<__uint32_t, IMM_FUNCT6>(inst)) {
+    case BitmanipOpcode::BEXTI: return shamt_ok ? inst_bexti<XLEN_t> : inst_illegal<XLEN_t>;
+    case BitmanipOpcode::RORI: return shamt_ok ? inst_rori<XLEN_t> : inst_illegal<XLEN_t>;
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op_imm_32_bitmanip(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    if (!RISCV::vectorHasExtension(extensionsVector, 'B'))
+        return inst_illegal<XLEN_t>;
+    if (swizzle<__uint32_t, FUNCT3>(inst) == RISCV::MinorOpcode::SLLIW) {
+        switch (swizzle<__uint32_t, IMM_FULL>(inst)) {
+        case BitmanipOpcode::CLZ: return inst_clzw<XLEN_t>;
+        case BitmanipOpcode::CTZ: return inst_ctzw<XLEN_t>;
+        case BitmanipOpcode::CPOP: return inst_cpopw<XLEN_t>;
+        default: break;
+        }
+        if (swizzle<__uint32_t, IMM_FUNCT6>(inst) == BitmanipOpcode::SLLI_UW)
+            return inst_slliuw<XLEN_t>;
+        return inst_illegal<XLEN_t>;
+    }
+    if (swizzle<__uint32_t, FUNCT7>(inst) == BitmanipOpcode::RORI << 1)
+        return inst_roriw<XLEN_t>;
+    return inst_illegal<XLEN_t>;
+}
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op_imm(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    // TODO: strictly speaking, SLLI is only valid if FUNCT7 is all zeroes. There are a lot of little non-strict d/c encodings throughout the decoder.
+    switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+    case RISCV::MinorOpcode::ADDI: return inst_addi<XLEN_t>;
+    case RISCV::MinorOpcode::SLLI:
+        if ((swizzle<__uint32_t, FUNCT7>(inst) & (mxlen == RISCV::XlenMode::XL32 ? ~0 : ~1)) != 0)
+            return decode_op_imm_bitmanip<XLEN_t>(inst, extensionsVector, mxlen);
+        return inst_slli<XLEN_t>;
+    case RISCV::MinorOpcode::SLTI: return inst_slti<XLEN_t>;
+    case RISCV::MinorOpcode::SLTIU: return inst_sltiu<XLEN_t>;
+    case RISCV::MinorOpcode::XORI: return inst_xori<XLEN_t>;
+    case RISCV::MinorOpcode::SRI:
+        // Above RV32, shamt[5] lives in the low bit of FUNCT7
+        switch(swizzle<__uint32_t, FUNCT7>(inst) & (mxlen == RISCV::XlenMode::XL32 ? ~0 : ~1)) {
+        case RISCV::SubMinorOpcode::SRAI: return inst_srai<XLEN_t>;
+        case RISCV::SubMinorOpcode::SRLI: return inst_srli<XLEN_t>;
+        default: return decode_op_imm_bitmanip<XLEN_t>(inst, extensionsVector, mxlen);
+        }
+    case RISCV::MinorOpcode::ORI: return inst_ori<XLEN_t>;
+    case RISCV::MinorOpcode::ANDI: return inst_andi<XLEN_t>;
     default: return inst_illegal<XLEN_t>;
     }
 }
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op_imm_32(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    if (mxlen == RISCV::XlenMode::XL32)
+        return inst_illegal<XLEN_t>; // Reserved encoding
+    switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+    case RISCV::MinorOpcode::ADDIW: return inst_addiw<XLEN_t>;
+    case RISCV::MinorOpcode::SLLIW:
+        if (swizzle<__uint32_t, FUNCT7>(inst) != 0)
+            return decode_op_imm_32_bitmanip<XLEN_t>(inst, extensionsVector, mxlen);
+        return inst_slliw<XLEN_t>;
+    case RISCV::MinorOpcode::SRI:
+        switch(swizzle<__uint32_t, FUNCT7>(inst)) {
+        case RISCV::SubMinorOpcode::SRAIW: return inst_sraiw<XLEN_t>;
+        case RISCV::SubMinorOpcode::SRLIW: return inst_srliw<XLEN_t>;
+        default: return decode_op_imm_32_bitmanip<XLEN_t>(inst, extensionsVector, mxlen);
+        }
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    switch (swizzle<__uint32_t, OP_MINOR>(inst)) {
+    case RISCV::MinorOpcode::ADD: return inst_add<XLEN_t>;
+    case RISCV::MinorOpcode::SUB: return inst_sub<XLEN_t>;
+    case RISCV::MinorOpcode::SLL: return inst_sll<XLEN_t>;
+    case RISCV::MinorOpcode::SLT: return inst_slt<XLEN_t>;
+    case RISCV::MinorOpcode::SLTU: return inst_sltu<XLEN_t>;
+    case RISCV::MinorOpcode::XOR: return inst_xor<XLEN_t>;
+    case RISCV::MinorOpcode::SRA: return inst_sra<XLEN_t>;
+    case RISCV::MinorOpcode::SRL: return inst_srl<XLEN_t>;
+    case RISCV::MinorOpcode::OR: return inst_or<XLEN_t>;
+    case RISCV::MinorOpcode::AND: return inst_and<XLEN_t>;
+    default: break;
+    }
+    if (!RISCV::vectorHasExtension(extensionsVector, 'M'))
+        return decode_op_bitmanip<XLEN_t>(inst, extensionsVector, mxlen);
+    switch (swizzle<__uint32_t, OP_MINOR>(inst)) {
+    case RISCV::MinorOpcode::MUL: return inst_mul<XLEN_t>;
+    case RISCV::MinorOpcode::MULH: return inst_mulh<XLEN_t>;
+    case RISCV::MinorOpcode::MULHSU: return inst_mulhsu<XLEN_t>;
+    case RISCV::MinorOpcode::MULHU: return inst_mulhu<XLEN_t>;
+    case RISCV::MinorOpcode::DIV: return inst_div<XLEN_t>;
+    case RISCV::MinorOpcode::DIVU: return inst_divu<XLEN_t>;
+    case RISCV::MinorOpcode::REM: return inst_rem<XLEN_t>;
+    case RISCV::MinorOpcode::REMU: return inst_remu<XLEN_t>;
+    default: return decode_op_bitmanip<XLEN_t>(inst, extensionsVector, mxlen);
+    }
+}
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op_32(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    if (mxlen == RISCV::XlenMode::XL32)
+        return inst_illegal<XLEN_t>;
+    switch (swizzle<__uint32_t, OP_MINOR>(inst)) {
+    case RISCV::MinorOpcode::ADDW: return inst_addw<XLEN_t>;
+    case RISCV::MinorOpcode::SUBW: return inst_subw<XLEN_t>;
+    case RISCV::MinorOpcode::SLLW: return inst_sllw<XLEN_t>;
+    case RISCV::MinorOpcode::SRLW: return inst_srlw<XLEN_t>;
+    case RISCV::MinorOpcode::SRAW: return inst_sraw<XLEN_t>;
+    default: return decode_op_32_bitmanip<XLEN_t>(inst, extensionsVector, mxlen);
+    }
+}
+
+// Both F and D decode through here; fmt picks the precision and the caller
+// has already checked that the matching extension is present.
+template<typename XLEN_t, typename FLOAT_t>
+constexpr Instruction<XLEN_t> decode_op_fp_fmt(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    typedef std::conditional_t<sizeof(FLOAT_t) == 4, double, float> OTHER_FLOAT_t;
+    switch (swizzle<__uint32_t, FUNCT5>(inst)) {
+    case 0b00000: return inst_fadd<XLEN_t, FLOAT_t>;
+    case 0b00001: return inst_fsub<XLEN_t, FLOAT_t>;
+    case 0b00010: return inst_fmul<XLEN_t, FLOAT_t>;
+    case 0b00011: return inst_fdiv<XLEN_t, FLOAT_t>;
+    case 0b01011:
+        if (swizzle<__uint32_t, RS2>(inst) != 0)
+            return inst_illegal<XLEN_t>;
+        return inst_fsqrt<XLEN_t, FLOAT_t>;
+    case 0b00100:
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case 0: return inst_fsgnj<XLEN_t, FLOAT_t>;
+        case 1: return inst_fsgnjn<XLEN_t, FLOAT_t>;
+        case 2: return inst_fsgnjx<XLEN_t, FLOAT_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case 0b00101:
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case 0: return inst_fmin<XLEN_t, FLOAT_t>;
+        case 1: return inst_fmax<XLEN_t, FLOAT_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case 0b01000:
+        if (swizzle<__uint32_t, RS2>(inst) != (swizzle<__uint32_t, FP_FMT>(inst) ^ 1))
+            return inst_illegal<XLEN_t>;
+        if (!RISCV::vectorHasExtension(extensionsVector, 'D'))
+            return inst_illegal<XLEN_t>;
+        return inst_fcvt_fp<XLEN_t, FLOAT_t, OTHER_FLOAT_t>;
+    case 0b10100:
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case 0: return inst_fle<XLEN_t, FLOAT_t>;
+        case 1: return inst_flt<XLEN_t, FLOAT_t>;
+        case 2: return inst_feq<XLEN_t, FLOAT_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case 0b11000:
+        switch (swizzle<__uint32_t, RS2>(inst)) {
+        case 0: return inst_fcvt_to_int<XLEN_t, FLOAT_t, __int32_t>;
+        case 1: return inst_fcvt_to_int<XLEN_t, FLOAT_t, __uint32_t>;
+        case 2: return inst_fcvt_to_int<XLEN_t, FLOAT_t, __int64_t>;
+        case 3: return inst_fcvt_to_int<XLEN_t, FLOAT_t, __uint64_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case 0b11010:
+        switch (swizzle<__uint32_t, RS2>(inst)) {
+        case 0: return inst_fcvt_from_int<XLEN_t, FLOAT_t, __int32_t>;
+        case 1: return inst_fcvt_from_int<XLEN_t, FLOAT_t, __uint32_t>;
+        case 2: return inst_fcvt_from_int<XLEN_t, FLOAT_t, __int64_t>;
+        case 3: return inst_fcvt_from_int<XLEN_t, FLOAT_t, __uint64_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case 0b11100:
+        if (swizzle<__uint32_t, RS2>(inst) != 0)
+            return inst_illegal<XLEN_t>;
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case 0: return inst_fmvx<XLEN_t, FLOAT_t>;
+        case 1: return inst_fclass<XLEN_t, FLOAT_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case 0b11110:
+        if (swizzle<__uint32_t, RS2>(inst) != 0 || swizzle<__uint32_t, FUNCT3>(inst) != 0)
+            return inst_illegal<XLEN_t>;
+        return inst_fmvf<XLEN_t, FLOAT_t>;
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+// Sorts out the precision of an F/D encoding from its fmt (or width) field
+// and hands off to the matching decoder, if that extension is present.
+template<typename XLEN_t, template<typename, typename> typename Decoder>
+constexpr Instruction<XLEN_t> decode_fp_precision(__uint32_t fmt, __uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    if (fmt == 0 && RISCV::vectorHasExtension(extensionsVector, 'F'))
+        return Decoder<XLEN_t, float>::decode(inst, extensionsVector, mxlen);
+    if (fmt == 1 && RISCV::vectorHasExtension(extensionsVector, 'D'))
+        return Decoder<XLEN_t, double>::decode(inst, extensionsVector, mxlen);
+    return inst_illegal<XLEN_t>;
+}
+
+template<typename XLEN_t, typename FLOAT_t>
+struct LoadFPDecoder {
+    static constexpr Instruction<XLEN_t> decode(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+        return inst_fl<XLEN_t, FLOAT_t>;
+    }
+};
+
+template<typename XLEN_t, typename FLOAT_t>
+struct StoreFPDecoder {
+    static constexpr Instruction<XLEN_t> decode(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+        return inst_fs<XLEN_t, FLOAT_t>;
+    }
+};
+
+template<typename XLEN_t, typename FLOAT_t>
+struct OpFPDecoder {
+    static constexpr Instruction<XLEN_t> decode(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+        return decode_op_fp_fmt<XLEN_t, FLOAT_t>(inst, extensionsVector, mxlen);
+    }
+};
+
+template<typename XLEN_t, bool negate_product, bool negate_addend>
+struct FMADecoder {
+    template<typename, typename FLOAT_t>
+    struct Of {
+        static constexpr Instruction<XLEN_t> decode(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+            if constexpr (!negate_product && !negate_addend) return inst_fmadd<XLEN_t, FLOAT_t>;
+            else if constexpr (!negate_product) return inst_fmsub<XLEN_t, FLOAT_t>;
+            else if constexpr (!negate_addend) return inst_fnmsub<XLEN_t, FLOAT_t>;
+            else return inst_fnmadd<XLEN_t, FLOAT_t>;
+        }
+    };
+};
+
+// Vector loads and stores share LOAD_FP and STORE_FP, told apart by width.
+// Valid RVV encodings that HartKit doesn't implement yet (segment, indexed and
+// fault-only-first accesses, widening ops, slides, the FP ops...) decode as
+// illegal rather than unimplemented, so the guest traps and can fall back to
+// scalar code instead of taking the host down.
+constexpr bool is_vector_memory_width(__uint32_t inst) {
+    __uint32_t width = swizzle<__uint32_t, FUNCT3>(inst);
+    return width == 0 || width >= 5;
+}
+
+template<typename XLEN_t, typename EEW_t, IOVerb verb>
+constexpr Instruction<XLEN_t> decode_vector_memory_eew(__uint32_t inst) {
+    __uint32_t nf = swizzle<__uint32_t, V_NF>(inst);
+    bool unmasked = swizzle<__uint32_t, V_VM>(inst);
+    if (swizzle<__uint32_t, V_MEW>(inst)) {
+        return inst_illegal<XLEN_t>;
+    }
+    switch (swizzle<__uint32_t, V_MOP>(inst)) {
+    case 0b00: // Unit-stride, sub-op in the rs2 field
+        switch (swizzle<__uint32_t, RS2>(inst)) {
+        case 0b00000:
+            if (nf != 0)
+                return inst_illegal<XLEN_t>; // Segment
+            return inst_vector_memory<XLEN_t, EEW_t, VectorAccess::UnitStride, verb>;
+        case 0b01000:
+            if (!unmasked || (nf & (nf + 1)) != 0 || (verb == IOVerb::Write && sizeof(EEW_t) != 1))
+                return inst_illegal<XLEN_t>;
+            return inst_vector_memory<XLEN_t, EEW_t, VectorAccess::WholeRegister, verb>;
+        case 0b01011:
+            if (!unmasked || nf != 0 || sizeof(EEW_t) != 1)
+                return inst_illegal<XLEN_t>;
+            return inst_vector_memory<XLEN_t, EEW_t, VectorAccess::Mask, verb>;
+        case 0b10000: return inst_illegal<XLEN_t>; // Fault-only-first
+        default: return inst_illegal<XLEN_t>;
+        }
+    case 0b10:
+        if (nf != 0)
+            return inst_illegal<XLEN_t>; // Segment
+        return inst_vector_memory<XLEN_t, EEW_t, VectorAccess::Strided, verb>;
+    default: return inst_illegal<XLEN_t>; // Indexed
+    }
+}
+
+template<typename XLEN_t, IOVerb verb>
+constexpr Instruction<XLEN_t> decode_vector_memory(__uint32_t inst) {
+    switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+    case 0: return decode_vector_memory_eew<XLEN_t, __uint8_t, verb>(inst);
+    case 5: return decode_vector_memory_eew<XLEN_t, __uint16_t, verb>(inst);
+    case 6: return decode_vector_memory_eew<XLEN_t, __uint32_t, verb>(inst);
+    case 7: return decode_vector_memory_eew<XLEN_t, __uint64_t, verb>(inst);
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+// OPIVV, OPIVX and OPIVI share a funct6 space, but not every op has every form
+template<typename XLEN_t, VectorOperand operand>
+constexpr Instruction<XLEN_t> decode_op_v_int(__uint32_t inst) {
+    constexpr bool vv = operand == VectorOperand::Vector;
+    constexpr bool vi = operand == VectorOperand::Immediate;
+    constexpr VectorOperand shift_operand = vi ? VectorOperand::UnsignedImmediate : operand;
+    switch (swizzle<__uint32_t, FUNCT6>(inst)) {
+    case 0b000000: return inst_vadd<XLEN_t, operand>;
+    case 0b000010: return vi ? inst_illegal<XLEN_t> : inst_vsub<XLEN_t, operand>;
+    case 0b000011: return vv ? inst_illegal<XLEN_t> : inst_vrsub<XLEN_t, operand>;
+    case 0b000100: return vi ? inst_illegal<XLEN_t> : inst_vminu<XLEN_t, operand>;
+    case 0b000101: return vi ? inst_illegal<XLEN_t> : inst_vmin<XLEN_t, operand>;
+    case 0b000110: return vi ? inst_illegal<XLEN_t> : inst_vmaxu<XLEN_t, operand>;
+    case 0b000111: return vi ? inst_illegal<XLEN_t> : inst_vmax<XLEN_t, operand>;
+    case 0b001001: return inst_vand<XLEN_t, operand>;
+    case 0b001010: return inst_vor<XLEN_t, operand>;
+    case 0b001011: return inst_vxor<XLEN_t, operand>;
+    case 0b010111:
+        if (swizzle<__uint32_t, V_VM>(inst) && swizzle<__uint32_t, RS2>(inst) != 0)
+            return inst_illegal<XLEN_t>;
+        return inst_vmerge<XLEN_t, operand>;
+    case 0b011000: return inst_vmseq<XLEN_t, operand>;
+    case 0b011001: return inst_vmsne<XLEN_t, operand>;
+    case 0b011010: return vi ? inst_illegal<XLEN_t> : inst_vmsltu<XLEN_t, operand>;
+    case 0b011011: return vi ? inst_illegal<XLEN_t> : inst_vmslt<XLEN_t, operand>;
+    case 0b011100: return inst_vmsleu<XLEN_t, operand>;
+    case 0b011101: return inst_vmsle<XLEN_t, operand>;
+    case 0b011110: return vv ? inst_illegal<XLEN_t> : inst_vmsgtu<XLEN_t, operand>;
+    case 0b011111: return vv ? inst_illegal<XLEN_t> : inst_vmsgt<XLEN_t, operand>;
+    case 0b100101: return inst_vsll<XLEN_t, shift_operand>;
+    case 0b101000: return inst_vsrl<XLEN_t, shift_operand>;
+    case 0b101001: return inst_vsra<XLEN_t, shift_operand>;
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+// OPMVV and OPMVX
+template<typename XLEN_t, VectorOperand operand>
+constexpr Instruction<XLEN_t> decode_op_v_mul(__uint32_t inst) {
+    constexpr bool vv = operand == VectorOperand::Vector;
+    bool unmasked = swizzle<__uint32_t, V_VM>(inst);
+    switch (swizzle<__uint32_t, FUNCT6>(inst)) {
+    case 0b000000: return vv ? inst_vredsum<XLEN_t> : inst_illegal<XLEN_t>;
+    case 0b000001: return vv ? inst_vredand<XLEN_t> : inst_illegal<XLEN_t>;
+    case 0b000010: return vv ? inst_vredor<XLEN_t> : inst_illegal<XLEN_t>;
+    case 0b000011: return vv ? inst_vredxor<XLEN_t> : inst_illegal<XLEN_t>;
+    case 0b000100: return vv ? inst_vredminu<XLEN_t> : inst_illegal<XLEN_t>;
+    case 0b000101: return vv ? inst_vredmin<XLEN_t> : inst_illegal<XLEN_t>;
+    case 0b000110: return vv ? inst_vredmaxu<XLEN_t> : inst_illegal<XLEN_t>;
+    case 0b000111: return vv ? inst_vredmax<XLEN_t> : inst_illegal<XLEN_t>;
+    case 0b010000:
+        if (vv && unmasked && swizzle<__uint32_t, RS1>(inst) == 0)
+            return inst_vmv_x_s<XLEN_t>;
+        if (!vv && unmasked && swizzle<__uint32_t, RS2>(inst) == 0)
+            return inst_vmv_s_x<XLEN_t>;
+        return inst_illegal<XLEN_t>;
+    case 0b010100:
+        if (vv && swizzle<__uint32_t, RS1>(inst) == 0b10001 && swizzle<__uint32_t, RS2>(inst) == 0)
+            return inst_vid<XLEN_t>;
+        return inst_illegal<XLEN_t>;
+    case 0b100100: return inst_vmulhu<XLEN_t, operand>;
+    case 0b100101: return inst_vmul<XLEN_t, operand>;
+    case 0b100111: return inst_vmulh<XLEN_t, operand>;
+    case 0b101101: return inst_vmacc<XLEN_t, operand>;
+    case 0b101111: return inst_vnmsac<XLEN_t, operand>;
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_op_v(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+    case 0: return decode_op_v_int<XLEN_t, VectorOperand::Vector>(inst);
+    case 1: return inst_illegal<XLEN_t>; // OPFVV
+    case 2: return decode_op_v_mul<XLEN_t, VectorOperand::Vector>(inst);
+    case 3: return decode_op_v_int<XLEN_t, VectorOperand::Immediate>(inst);
+    case 4: return decode_op_v_int<XLEN_t, VectorOperand::Scalar>(inst);
+    case 5: return inst_illegal<XLEN_t>; // OPFVF
+    case 6: return decode_op_v_mul<XLEN_t, VectorOperand::Scalar>(inst);
+    case 7:
+        if (swizzle<__uint32_t, ExtendBits::Zero, 31, 31>(inst) == 0)
+            return inst_vset<XLEN_t, VsetForm::Vsetvli>;
+        if (swizzle<__uint32_t, ExtendBits::Zero, 31, 30>(inst) == 0b11)
+            return inst_vset<XLEN_t, VsetForm::Vsetivli>;
+        if (swizzle<__uint32_t, FUNCT7>(inst) == 0b1000000)
+            return inst_vset<XLEN_t, VsetForm::Vsetvl>;
+        return inst_illegal<XLEN_t>;
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+// Decodes a 32-bit encoding, or a compressed one after expansion; the quadrant
+// bits are not consulted.
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_uncompressed(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    switch (swizzle<__uint32_t, OPCODE>(inst)) {
+    case RISCV::MajorOpcode::LOAD:
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case RISCV::MinorOpcode::LB: return inst_lb<XLEN_t>;
+        case RISCV::MinorOpcode::LH: return inst_lh<XLEN_t>;
+        case RISCV::MinorOpcode::LW: return inst_lw<XLEN_t>;
+        case RISCV::MinorOpcode::LD: return inst_ld<XLEN_t>;
+        case RISCV::MinorOpcode::LBU: return inst_lbu<XLEN_t>;
+        case RISCV::MinorOpcode::LHU: return inst_lhu<XLEN_t>;
+        case RISCV::MinorOpcode::LWU: return inst_lwu<XLEN_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case RISCV::MajorOpcode::LOAD_FP:
+        if (is_vector_memory_width(inst) && RISCV::vectorHasExtension(extensionsVector, 'V'))
+            return decode_vector_memory<XLEN_t, IOVerb::Read>(inst);
+        return decode_fp_precision<XLEN_t, LoadFPDecoder>(swizzle<__uint32_t, FUNCT3>(inst) - 2, inst, extensionsVector, mxlen);
+    case RISCV::MajorOpcode::CUSTOM_0: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::MISC_MEM:
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case RISCV::MinorOpcode::FENCE: return inst_fence<XLEN_t>;
+        case RISCV::MinorOpcode::FENCE_I: return inst_fencei<XLEN_t>;
+        case 2: // LQ
+            if (mxlen == RISCV::XlenMode::XL128)
+                return inst_lq<XLEN_t>;
+            return inst_illegal<XLEN_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case RISCV::MajorOpcode::OP_IMM: return hint_if_rd_zero<XLEN_t>(inst, decode_op_imm<XLEN_t>(inst, extensionsVector, mxlen));
+    case RISCV::MajorOpcode::AUIPC: return hint_if_rd_zero<XLEN_t>(inst, inst_auipc<XLEN_t>);
+    case RISCV::MajorOpcode::OP_IMM_32: return hint_if_rd_zero<XLEN_t>(inst, decode_op_imm_32<XLEN_t>(inst, extensionsVector, mxlen));
+    case RISCV::MajorOpcode::LONG_48B_1: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::STORE:
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case RISCV::MinorOpcode::SB: return inst_sb<XLEN_t>;
+        case RISCV::MinorOpcode::SH: return inst_sh<XLEN_t>;
+        case RISCV::MinorOpcode::SW: return inst_sw<XLEN_t>;
+        case RISCV::MinorOpcode::SD: return inst_sd<XLEN_t>;
+        case 4: // SQ
+            if (mxlen == RISCV::XlenMode::XL128)
+                return inst_sq<XLEN_t>;
+            return inst_illegal<XLEN_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case RISCV::MajorOpcode::STORE_FP:
+        if (is_vector_memory_width(inst) && RISCV::vectorHasExtension(extensionsVector, 'V'))
+            return decode_vector_memory<XLEN_t, IOVerb::Write>(inst);
+        return decode_fp_precision<XLEN_t, StoreFPDecoder>(swizzle<__uint32_t, FUNCT3>(inst) - 2, inst, extensionsVector, mxlen);
+    case RISCV::MajorOpcode::CUSTOM_1: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::AMO:
+        if (!RISCV::vectorHasExtension(extensionsVector, 'A'))
+            return inst_illegal<XLEN_t>;
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case RISCV::AmoWidth::AMO_W:
+            switch (swizzle<__uint32_t, FUNCT5>(inst)) {
+            case RISCV::MinorOpcode::AMOADD: return inst_amoaddw<XLEN_t>;
+            case RISCV::MinorOpcode::AMOSWAP: return inst_amoswapw<XLEN_t>;
+            case RISCV::MinorOpcode::LR: return inst_lrw<XLEN_t>;
+            case RISCV::MinorOpcode::SC: return inst_scw<XLEN_t>;
+            case RISCV::MinorOpcode::AMOXOR: return inst_amoxorw<XLEN_t>;
+            case RISCV::MinorOpcode::AMOOR: return inst_amoorw<XLEN_t>;
+            case RISCV::MinorOpcode::AMOAND: return inst_amoandw<XLEN_t>;
+            case RISCV::MinorOpcode::AMOMIN: return inst_amominw<XLEN_t>;
+            case RISCV::MinorOpcode::AMOMAX: return inst_amomaxw<XLEN_t>;
+            case RISCV::MinorOpcode::AMOMINU: return inst_amominuw<XLEN_t>;
+            case RISCV::MinorOpcode::AMOMAXU: return inst_amomaxuw<XLEN_t>;
+            default: return inst_illegal<XLEN_t>;
+            }
+        case RISCV::AmoWidth::AMO_D:
+            switch (swizzle<__uint32_t, FUNCT5>(inst)) {
+            case RISCV::MinorOpcode::AMOADD: return inst_amoaddd<XLEN_t>;
+            case RISCV::MinorOpcode::AMOSWAP: return inst_amoswapd<XLEN_t>;
+            case RISCV::MinorOpcode::LR: return inst_lrd<XLEN_t>;
+            case RISCV::MinorOpcode::SC: return inst_scd<XLEN_t>;
+            case RISCV::MinorOpcode::AMOXOR: return inst_amoxord<XLEN_t>;
+            case RISCV::MinorOpcode::AMOOR: return inst_amoord<XLEN_t>;
+            case RISCV::MinorOpcode::AMOAND: return inst_amoandd<XLEN_t>;
+            case RISCV::MinorOpcode::AMOMIN: return inst_amomind<XLEN_t>;
+            case RISCV::MinorOpcode::AMOMAX: return inst_amomaxd<XLEN_t>;
+            case RISCV::MinorOpcode::AMOMINU: return inst_amominud<XLEN_t>;
+            case RISCV::MinorOpcode::AMOMAXU: return inst_amomaxud<XLEN_t>;
+            default: return inst_illegal<XLEN_t>;
+            }
+        default: return inst_illegal<XLEN_t>;
+        }
+    case RISCV::MajorOpcode::OP: return hint_if_rd_zero<XLEN_t>(inst, decode_op<XLEN_t>(inst, extensionsVector, mxlen));
+    case RISCV::MajorOpcode::LUI: return hint_if_rd_zero<XLEN_t>(inst, inst_lui<XLEN_t>);
+    case RISCV::MajorOpcode::OP_32: return hint_if_rd_zero<XLEN_t>(inst, decode_op_32<XLEN_t>(inst, extensionsVector, mxlen));
+    case RISCV::MajorOpcode::LONG_64B: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::MADD:
+        return decode_fp_precision<XLEN_t, FMADecoder<XLEN_t, false, false>::template Of>(swizzle<__uint32_t, FP_FMT>(inst), inst, extensionsVector, mxlen);
+    case RISCV::MajorOpcode::MSUB:
+        return decode_fp_precision<XLEN_t, FMADecoder<XLEN_t, false, true>::template Of>(swizzle<__uint32_t, FP_FMT>(inst), inst, extensionsVector, mxlen);
+    case RISCV::MajorOpcode::NMSUB:
+        return decode_fp_precision<XLEN_t, FMADecoder<XLEN_t, true, false>::template Of>(swizzle<__uint32_t, FP_FMT>(inst), inst, extensionsVector, mxlen);
+    case RISCV::MajorOpcode::NMADD:
+        return decode_fp_precision<XLEN_t, FMADecoder<XLEN_t, true, true>::template Of>(swizzle<__uint32_t, FP_FMT>(inst), inst, extensionsVector, mxlen);
+    case RISCV::MajorOpcode::OP_FP:
+        return decode_fp_precision<XLEN_t, OpFPDecoder>(swizzle<__uint32_t, FP_FMT>(inst), inst, extensionsVector, mxlen);
+    case RISCV::MajorOpcode::RESERVED_0: // OP-V
+        if (!RISCV::vectorHasExtension(extensionsVector, 'V'))
+            return inst_illegal<XLEN_t>;
+        return decode_op_v<XLEN_t>(inst, extensionsVector, mxlen);
+    case RISCV::MajorOpcode::CUSTOM_2: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::LONG_48B_2: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::BRANCH:
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case RISCV::MinorOpcode::BEQ: return inst_beq<XLEN_t>;
+        case RISCV::MinorOpcode::BNE: return inst_bne<XLEN_t>;
+        case RISCV::MinorOpcode::BLT: return inst_blt<XLEN_t>;
+        case RISCV::MinorOpcode::BGE: return inst_bge<XLEN_t>;
+        case RISCV::MinorOpcode::BLTU: return inst_bltu<XLEN_t>;
+        case RISCV::MinorOpcode::BGEU: return inst_bgeu<XLEN_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case RISCV::MajorOpcode::JALR: return inst_jalr<XLEN_t>;
+    case RISCV::MajorOpcode::RESERVED_1: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::JAL: return inst_jal<XLEN_t>;
+    case RISCV::MajorOpcode::SYSTEM:
+        switch (swizzle<__uint32_t, FUNCT3>(inst)) {
+        case RISCV::MinorOpcode::PRIV:
+            switch (swizzle<__uint32_t, FUNCT7>(inst)) {
+            case RISCV::SubMinorOpcode::ECALL_EBREAK_URET:
+                switch (swizzle<__uint32_t, RS2>(inst)) {
+                case RISCV::SubSubMinorOpcode::ECALL: return inst_ecall<XLEN_t>;
+                case RISCV::SubSubMinorOpcode::EBREAK: return inst_ebreak<XLEN_t>;
+                case RISCV::SubSubMinorOpcode::URET: return inst_uret<XLEN_t>;
+                default: return inst_illegal<XLEN_t>;
+                }
+            case RISCV::SubMinorOpcode::SRET_WFI:
+                switch (swizzle<__uint32_t, RS2>(inst)) {
+                case RISCV::SubSubMinorOpcode::WFI: return inst_wfi<XLEN_t>;
+                case RISCV::SubSubMinorOpcode::SRET: return inst_sret<XLEN_t>;
+                default: return inst_illegal<XLEN_t>;
+                }
+            case RISCV::SubMinorOpcode::MRET: return inst_mret<XLEN_t>;
+            case RISCV::SFENCE_VMA: return inst_sfencevma<XLEN_t>;
+            default: return inst_illegal<XLEN_t>;
+            }
+        case RISCV::MinorOpcode::CSRRW: return inst_csrrw<XLEN_t>;
+        case RISCV::MinorOpcode::CSRRS: return inst_csrrs<XLEN_t>;
+        case RISCV::MinorOpcode::CSRRC: return inst_csrrc<XLEN_t>;
+        case RISCV::MinorOpcode::CSRRWI: return inst_csrrwi<XLEN_t>;
+        case RISCV::MinorOpcode::CSRRSI: return inst_csrrsi<XLEN_t>;
+        case RISCV::MinorOpcode::CSRRCI: return inst_csrrci<XLEN_t>;
+        default: return inst_illegal<XLEN_t>;
+        }
+    case RISCV::MajorOpcode::RESERVED_2: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::CUSTOM_3: return inst_unimplemented<XLEN_t>;
+    case RISCV::MajorOpcode::LONG_80B: return inst_unimplemented<XLEN_t>;
+    default: return inst_illegal<XLEN_t>;
+    }
+}
+
+template<typename XLEN_t>
+constexpr Instruction<XLEN_t> decode_instruction(__uint32_t inst, __uint32_t extensionsVector, RISCV::XlenMode mxlen) {
+    if (swizzle<__uint32_t, QUADRANT>(inst) == RISCV::OpcodeQuadrant::UNCOMPRESSED) {
+        return decode_uncompressed<XLEN_t>(inst, extensionsVector, mxlen);
+    }
+    if (!RISCV::vectorHasExtension(extensionsVector, 'C')) {
+        return inst_illegal<XLEN_t>;
+    }
+    __uint32_t expanded = expand_compressed(inst, mxlen);
+    if (expanded == 0) {
+        return inst_illegal<XLEN_t>;
+    }
+    return decode_uncompressed<XLEN_t>(expanded, extensionsVector, mxlen);
+}
+
+// Decodes for a FixedISA (see ISA.hpp). Flattening inlines the whole decoder
+// here, where the ISA's extensions and MXLEN are constants, so the branches for
+// anything it leaves out fold away and their executors are never referenced.
+template<typename XLEN_t, typename ISA>
+[[gnu::flatten]] constexpr Instruction<XLEN_t> decode_instruction(__uint32_t inst, __uint32_t extensionsVector) {
+    static_assert(ISA::Fixed, "decode AnyISA with the run-time mxlen instead");
+    return decode_instruction<XLEN_t>(inst, extensionsVector & ISA::extensions, ISA::mxlen);
+}
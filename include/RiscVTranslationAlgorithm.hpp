@@ -25,7 +25,9 @@ static inline Translation<XLEN_t> TranslationAlgorithm(
         RISCV::PagingMode currentPagingMode,
         RISCV::PrivilegeMode translationPrivilege,
         bool mxrBit,
-        bool sumBit
+        bool sumBit,
+        PMP<XLEN_t>* pmp = nullptr,
+        bool hardwareAD = false
     ) {
     
     unsigned int i = 0;
@@ -61,13 +63,23 @@ static inline Translation<XLEN_t> TranslationAlgorithm(
 
     XLEN_t a = root_ppn * pagesize;
     XLEN_t pte = 0; // TODO PTE should be Sv** determined, not XLEN_t sized...
+    XLEN_t pteaddr = 0;
 
     while (true) {
 
-        XLEN_t pteaddr = a + (vpn[i] * ptesize);
-        transactor->Read(pteaddr, ptesize, (char*)&pte);
+        pteaddr = a + (vpn[i] * ptesize);
 
-        // TODO PMA & PMP checks
+        // Page table reads are checked as S-mode reads, but fault as whatever
+        // access needed the translation. PMAs are the transactor's business:
+        // memory that can't hold a page table faults the read or cuts it short.
+        if (pmp != nullptr &&
+            !pmp->template Allows<IOVerb::Read>(pteaddr, ptesize, RISCV::PrivilegeMode::Supervisor)) {
+            return { virt_addr, 0, 0, 0, AccessFault<verb>() };
+        }
+        Transaction<XLEN_t> read = transactor->Read(pteaddr, ptesize, (char*)&pte);
+        if (read.trapCause != RISCV::TrapCause::NONE || read.transferredSize != ptesize) {
+            return { virt_addr, 0, 0, 0, AccessFault<verb>() };
+        }
 
         if ( !(pte & RISCV::PTEBit::V) ||
             (!(pte & RISCV::PTEBit::R) && (pte & RISCV::PTEBit::W))) {
@@ -142,16 +154,29 @@ static inline Translation<XLEN_t> TranslationAlgorithm(
         }
     }
 
-    // TODO the alternative A/D bit scheme mentioned in the spec.
-
-    if (!(pte & RISCV::PTEBit::A)) {
-        return PageFault<XLEN_t, verb>(virt_addr);
-    }
-
-    if constexpr (verb == IOVerb::Write) {
-        if (!(pte & RISCV::PTEBit::D)) {
+    // Without hardwareAD, a clear A (or D, for a store) is a page fault, and
+    // the guest sets the bit itself. With it, the walk sets them, with a
+    // compare-and-swap so a PTE another hart changed meanwhile isn't clobbered;
+    // if it was changed, the walk starts over and checks it again.
+    XLEN_t needed = RISCV::PTEBit::A | (verb == IOVerb::Write ? RISCV::PTEBit::D : 0);
+    if ((pte & needed) != needed) {
+        if (!hardwareAD) {
             return PageFault<XLEN_t, verb>(virt_addr);
         }
+        if (pmp != nullptr &&
+            !pmp->template Allows<IOVerb::Write>(pteaddr, ptesize, RISCV::PrivilegeMode::Supervisor)) {
+            return { virt_addr, 0, 0, 0, AccessFault<verb>() };
+        }
+        XLEN_t observed = pte;
+        XLEN_t updated = pte | needed;
+        Transaction<XLEN_t> swap = transactor->CompareAndSwap(pteaddr, ptesize, (char*)&observed, (char*)&updated);
+        if (swap.trapCause != RISCV::TrapCause::NONE || swap.transferredSize != ptesize) {
+            return { virt_addr, 0, 0, 0, AccessFault<verb>() };
+        }
+        if (observed != pte) {
+            return TranslationAlgorithm<XLEN_t, verb>(virt_addr, transactor, root_ppn, currentPagingMode,
+                translationPrivilege, mxrBit, sumBit, pmp, hardwareAD);
+        }
     }
 
     // TODO this is where we can determine a better validThrough.
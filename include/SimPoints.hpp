@@ -0,0 +1,192 @@
+#pragma once
+
+/*
+ * SimPoint-style sampling, for studying runs far too long to simulate in
+ * detail from start to end. A profiling run counts, per interval of N
+ * instructions, how many instructions each basic block executed - the
+ * interval's basic block vector - and writes them out in SimPoint's .bb
+ * format. tools/SimPoints.cpp (or SimPoint itself) clusters the intervals and
+ * picks one per cluster to stand for it. Later runs then fast-forward through
+ * everything else on the fastest engine the client has, and run just the
+ * chosen intervals in detail, weighting each one's results by its cluster.
+ *
+ * BasicBlockVectors is driven by the client's run loop, which calls Retire for
+ * every instruction it executes. A block runs from the instruction after one
+ * that ends_block (see RiscVDecoder.hpp; DecodeCache keeps it per slot) up to
+ * and including the next one, and is known by its first pc. Traps and
+ * interrupts don't end blocks, which SimPoint's own tools don't do either.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+template<typename XLEN_t>
+class BasicBlockVectors {
+
+private:
+
+    struct Block {
+        __uint64_t id; // 1-based, in order of first execution, as SimPoint expects
+        __uint64_t count = 0; // Instructions executed this interval
+    };
+
+    std::ostream* out;
+    __uint64_t intervalLength;
+    std::unordered_map<XLEN_t, Block> blocks;
+    std::vector<Block*> touched; // Blocks with a count this interval
+    XLEN_t blockStart = 0;
+    __uint64_t blockLength = 0;
+    __uint64_t intervalCount = 0;
+    __uint64_t intervals = 0;
+
+    inline void EndBlock() {
+        auto [entry, added] = blocks.try_emplace(blockStart, Block{ blocks.size() + 1 });
+        Block* block = &entry->second;
+        if (block->count == 0) {
+            touched.push_back(block);
+        }
+        block->count += blockLength;
+        blockLength = 0;
+    }
+
+    inline void EndInterval() {
+        *out << 'T';
+        for (Block* block : touched) {
+            *out << ':' << block->id << ':' << block->count << ' ';
+            block->count = 0;
+        }
+        *out << '\n';
+        touched.clear();
+        intervalCount = 0;
+        intervals++;
+    }
+
+public:
+
+    BasicBlockVectors(std::ostream* out, __uint64_t intervalLength)
+        : out(out), intervalLength(intervalLength) {
+    }
+
+    ~BasicBlockVectors() {
+        Flush();
+    }
+
+    BasicBlockVectors(const BasicBlockVectors&) = delete;
+    BasicBlockVectors& operator=(const BasicBlockVectors&) = delete;
+
+    // For each instruction executed, with the pc it was fetched from
+    inline void Retire(XLEN_t pc, bool endsBlock) {
+        if (blockLength == 0) {
+            blockStart = pc;
+        }
+        blockLength++;
+        intervalCount++;
+        if (endsBlock) {
+            EndBlock();
+        }
+        if (intervalCount == intervalLength) [[unlikely]] {
+            if (blockLength != 0) {
+                EndBlock();
+            }
+            EndInterval();
+        }
+    }
+
+    // Writes out the last, partial interval; the destructor does this too
+    inline void Flush() {
+        if (blockLength != 0) {
+            EndBlock();
+        }
+        if (intervalCount != 0) {
+            EndInterval();
+        }
+        out->flush();
+    }
+
+    inline __uint64_t Intervals() { return intervals; }
+    inline __uint64_t Blocks() { return blocks.size(); }
+
+};
+
+// An interval chosen to stand for its cluster, and the share of the run's
+// intervals that cluster has
+struct SimPoint {
+    __uint64_t interval;
+    __uint64_t cluster;
+    double weight;
+};
+
+// Reads SimPoint's .simpoints ("interval cluster" per line) and .weights
+// ("weight cluster" per line) output, sorted by interval. Returns nothing if
+// either is malformed.
+inline std::vector<SimPoint> read_simpoints(std::istream& points, std::istream& weights) {
+    std::unordered_map<__uint64_t, double> clusterWeights;
+    double weight;
+    __uint64_t cluster;
+    while (weights >> weight >> cluster) {
+        clusterWeights[cluster] = weight;
+    }
+    if (!weights.eof()) {
+        return {};
+    }
+    std::vector<SimPoint> simPoints;
+    __uint64_t interval;
+    while (points >> interval >> cluster) {
+        auto found = clusterWeights.find(cluster);
+        if (found == clusterWeights.end()) {
+            return {};
+        }
+        simPoints.push_back({ interval, cluster, found->second });
+    }
+    if (!points.eof()) {
+        return {};
+    }
+    std::sort(simPoints.begin(), simPoints.end(),
+              [](const SimPoint& a, const SimPoint& b) { return a.interval < b.interval; });
+    return simPoints;
+}
+
+// Runs a whole sampled simulation in one pass. fastForward(instructions) runs
+// the hart that many instructions on the fastest engine there is (FastMemory,
+// a DecodeCache, no profiling), and returns how many it actually ran, fewer if
+// the program ended. detailed(simPoint, warmup, instructions) then runs the
+// detailed model for warmup instructions, to warm its caches and predictors,
+// and then the interval's instructions, and likewise returns how many it ran
+// in all. Warmup is shorter than asked for where the run's too young. To try
+// several configurations on each interval, take a HartSnapshot at the start
+// of detailed and Restore it between them. Returns the number of simpoints
+// reached.
+template<typename FastForward, typename Detailed>
+inline std::size_t run_simpoints(const std::vector<SimPoint>& simPoints, __uint64_t intervalLength,
+                                 __uint64_t warmup, FastForward fastForward, Detailed detailed) {
+    __uint64_t executed = 0;
+    std::size_t reached = 0;
+    for (const SimPoint& simPoint : simPoints) {
+        __uint64_t start = simPoint.interval * intervalLength;
+        __uint64_t warmStart = start > warmup ? start - warmup : 0;
+        if (warmStart < executed) {
+            warmStart = executed; // Intervals this close share their warmup
+        }
+        if (warmStart > executed) {
+            __uint64_t ran = fastForward(warmStart - executed);
+            executed += ran;
+            if (executed != warmStart) {
+                break;
+            }
+        }
+        if (start < executed) {
+            continue; // Listed twice
+        }
+        __uint64_t ran = detailed(simPoint, start - executed, intervalLength);
+        executed += ran;
+        reached++;
+        if (executed != start + intervalLength) {
+            break;
+        }
+    }
+    return reached;
+}
@@ -1,34 +1,193 @@
 #pragma once
 
+/*
+ * Immediate and field extraction. A slice list is pairs of hi, lo bit indices
+ * into the source, most significant slice first, optionally followed by a
+ * final left shift; swizzle concatenates the slices, shifts, and zero- or
+ * sign-extends from the top bit of the result.
+ *
+ * The list is folded at compile time into each slice's source and destination
+ * masks. The portable path moves each slice with one shift and mask. With
+ * BMI2 (build with -mbmi2 or -march=native), slices whose source bits are in
+ * the same order as their destination bits are grouped, and a group of at
+ * least HARTKIT_SWIZZLE_PEXT_SLICES slices moves at once with a pext and a
+ * pdep; smaller groups keep the shifts and masks, which are cheaper, since
+ * both instructions take three cycles on one port even where they're fast.
+ * With the default of four, that's CJ's immediate, whose eight slices gather
+ * as four, three and one. Define HARTKIT_PORTABLE_SWIZZLE where pext and pdep
+ * are microcoded (AMD before Zen 3). bench/Swizzle.cpp compares the two.
+ */
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#if defined(__BMI2__) && !defined(HARTKIT_PORTABLE_SWIZZLE)
+#define HARTKIT_BMI2_SWIZZLE
+#include <immintrin.h>
+#endif
+
+#if !defined(HARTKIT_SWIZZLE_PEXT_SLICES)
+#define HARTKIT_SWIZZLE_PEXT_SLICES 4
+#endif
+
 enum class ExtendBits { Zero, Sign };
 
-template <typename XLEN_t, unsigned int applied, unsigned int... slices>
-static inline constexpr XLEN_t swizzleHelper(XLEN_t source_bits, XLEN_t result) {
+// Bits [0, width) set, for any width up to 64
+inline constexpr __uint64_t swizzle_low_bits(unsigned int width) {
+    return width >= 64 ? ~(__uint64_t)0 : ((__uint64_t)1 << width) - 1;
+}
+
+template<unsigned int... slices>
+struct SwizzleLayout {
+
+    struct Slice {
+        unsigned int hi;
+        unsigned int lo;
+        unsigned int destination; // Lowest bit of the result it lands in
+    };
+
+    static constexpr std::array<unsigned int, sizeof...(slices)> values = { slices... };
+    static constexpr unsigned int count = sizeof...(slices) / 2;
+    static constexpr unsigned int shift = sizeof...(slices) % 2 ? values[sizeof...(slices) - 1] : 0;
+
+    static constexpr std::array<Slice, count> Slices() {
+        std::array<Slice, count> result = {};
+        unsigned int destination = shift;
+        for (unsigned int index = count; index-- > 0;) {
+            result[index] = { values[index * 2], values[index * 2 + 1], destination };
+            destination += values[index * 2] - values[index * 2 + 1] + 1;
+        }
+        return result;
+    }
 
-    constexpr unsigned int numSliceInts = sizeof...(slices);
-    constexpr XLEN_t values[numSliceInts] = {slices...};
+    static constexpr std::array<Slice, count> slice = Slices();
+    static constexpr unsigned int width = count == 0 ? shift : slice[0].destination + slice[0].hi - slice[0].lo + 1;
 
-    XLEN_t sliceHi = values[applied];
-    XLEN_t sliceLo = values[applied+1];
-    XLEN_t slice_len = sliceHi-sliceLo+1;
-    result <<= slice_len;
-    result |= (source_bits >> sliceLo) & ((1 << slice_len) - 1);
+    static constexpr __uint64_t SourceMask(const Slice& s) {
+        return swizzle_low_bits(s.hi - s.lo + 1) << s.lo;
+    }
+
+    static constexpr __uint64_t DestinationMask(const Slice& s) {
+        return swizzle_low_bits(s.hi - s.lo + 1) << s.destination;
+    }
 
-    if constexpr (applied + 2 == numSliceInts) {
+    // Slices, in order, go into the first group whose last slice lies wholly
+    // above them in the source, so each group's slices keep the same order in
+    // source and destination, and pext then pdep moves them all.
+    struct Group {
+        __uint64_t source = 0;
+        __uint64_t destination = 0;
+        unsigned int size = 0; // Slices in it
+        unsigned int lowest = 0; // Lowest source bit so far
+    };
+
+    static constexpr std::array<Group, count> Groups() {
+        std::array<Group, count> result = {};
+        unsigned int groups = 0;
+        for (unsigned int index = 0; index < count; index++) {
+            unsigned int group = 0;
+            while (group < groups && result[group].lowest <= slice[index].hi) {
+                group++;
+            }
+            if (group == groups) {
+                groups++;
+            }
+            result[group].source |= SourceMask(slice[index]);
+            result[group].destination |= DestinationMask(slice[index]);
+            result[group].size++;
+            result[group].lowest = slice[index].lo;
+        }
         return result;
-    } else if constexpr (applied + 2 == numSliceInts - 1) {
-        return result << values[applied + 2];
+    }
+
+    static constexpr std::array<Group, count> group = Groups();
+
+    static constexpr unsigned int GroupCount() {
+        unsigned int groups = 0;
+        while (groups < count && group[groups].size != 0) {
+            groups++;
+        }
+        return groups;
+    }
+
+    static constexpr unsigned int groups = GroupCount();
+
+    // Whether a slice is moved by its group's pext and pdep
+    static constexpr bool Gathered(unsigned int index) {
+        for (unsigned int g = 0; g < groups; g++) {
+            if (group[g].size >= HARTKIT_SWIZZLE_PEXT_SLICES &&
+                (group[g].source & SourceMask(slice[index])) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+};
+
+// Moves one slice into place with a shift and a mask
+template<typename XLEN_t, typename Layout, unsigned int index>
+inline constexpr XLEN_t swizzle_slice(XLEN_t source_bits) {
+    constexpr typename Layout::Slice s = Layout::slice[index];
+    constexpr XLEN_t mask = (XLEN_t)swizzle_low_bits(s.hi - s.lo + 1);
+    return ((source_bits >> s.lo) & mask) << s.destination;
+}
+
+template<typename XLEN_t, typename Layout, unsigned int... indices>
+inline constexpr XLEN_t swizzle_portable(XLEN_t source_bits, std::integer_sequence<unsigned int, indices...>) {
+    return (XLEN_t)0 | (swizzle_slice<XLEN_t, Layout, indices>(source_bits) | ...);
+}
+
+#if defined(HARTKIT_BMI2_SWIZZLE)
+template<typename XLEN_t, typename Layout, unsigned int index>
+inline XLEN_t swizzle_group(XLEN_t source_bits) {
+    constexpr typename Layout::Group g = Layout::group[index];
+    if constexpr (g.size < HARTKIT_SWIZZLE_PEXT_SLICES) {
+        return 0;
+    } else if constexpr (sizeof(XLEN_t) <= sizeof(__uint32_t) && g.source <= 0xffffffff && g.destination <= 0xffffffff) {
+        return _pdep_u32(_pext_u32((__uint32_t)source_bits, (__uint32_t)g.source), (__uint32_t)g.destination);
+    } else {
+        return _pdep_u64(_pext_u64((__uint64_t)source_bits, g.source), g.destination);
+    }
+}
+
+template<typename XLEN_t, typename Layout, unsigned int index>
+inline XLEN_t swizzle_ungathered(XLEN_t source_bits) {
+    if constexpr (Layout::Gathered(index)) {
+        return 0;
     } else {
-        return swizzleHelper<XLEN_t, applied+2, slices...>(source_bits, result);
+        return swizzle_slice<XLEN_t, Layout, index>(source_bits);
     }
 }
 
+template<typename XLEN_t, typename Layout, unsigned int... groups, unsigned int... indices>
+inline XLEN_t swizzle_bmi2(XLEN_t source_bits, std::integer_sequence<unsigned int, groups...>,
+                           std::integer_sequence<unsigned int, indices...>) {
+    return (XLEN_t)0 | (swizzle_group<XLEN_t, Layout, groups>(source_bits) | ...) |
+           (swizzle_ungathered<XLEN_t, Layout, indices>(source_bits) | ...);
+}
+#endif
+
 template <typename XLEN_t, ExtendBits extend, unsigned int... slices>
 inline constexpr XLEN_t swizzle(XLEN_t source_bits) {
-    if constexpr (extend == ExtendBits::Sign) {
-        constexpr XLEN_t values[sizeof...(slices)] = {slices...};
-        XLEN_t result = source_bits & (1 << values[0]) ? ~0 : 0;
-        return swizzleHelper<XLEN_t, 0, slices...>(source_bits, result);
+    typedef SwizzleLayout<slices...> Layout;
+    static_assert(Layout::width <= 64, "slices must fit in 64 bits");
+    XLEN_t result;
+#if defined(HARTKIT_BMI2_SWIZZLE)
+    if (std::is_constant_evaluated() || sizeof(XLEN_t) > sizeof(__uint64_t)) {
+        result = swizzle_portable<XLEN_t, Layout>(source_bits, std::make_integer_sequence<unsigned int, Layout::count>());
+    } else {
+        result = swizzle_bmi2<XLEN_t, Layout>(source_bits, std::make_integer_sequence<unsigned int, Layout::groups>(),
+                                              std::make_integer_sequence<unsigned int, Layout::count>());
+    }
+#else
+    result = swizzle_portable<XLEN_t, Layout>(source_bits, std::make_integer_sequence<unsigned int, Layout::count>());
+#endif
+    if constexpr (extend == ExtendBits::Sign && Layout::width != 0 && Layout::width < sizeof(XLEN_t) * 8) {
+        XLEN_t sign = (XLEN_t)0 - ((result >> (Layout::width - 1)) & 1);
+        result |= sign << Layout::width;
     }
-    return swizzleHelper<XLEN_t, 0, slices...>(source_bits, 0);
+    return result;
 }
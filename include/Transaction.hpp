@@ -1,9 +1,22 @@
 #pragma once
 
 #include <RiscV.hpp>
+#include <IOVerb.hpp>
 
 template<typename XLEN_t>
 struct Transaction {
     RISCV::TrapCause trapCause;
     XLEN_t transferredSize;
 };
+
+// The trap a transaction of each kind raises when there's nothing there
+template<IOVerb verb>
+constexpr RISCV::TrapCause AccessFault() {
+    if constexpr (verb == IOVerb::Read) {
+        return RISCV::TrapCause::LOAD_ACCESS_FAULT;
+    } else if constexpr (verb == IOVerb::Write) {
+        return RISCV::TrapCause::STORE_AMO_ACCESS_FAULT;
+    } else {
+        return RISCV::TrapCause::INSTRUCTION_ACCESS_FAULT;
+    }
+}
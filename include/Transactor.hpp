@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstring>
+
 #include <IOVerb.hpp>
 #include <Transaction.hpp>
 
@@ -9,6 +11,22 @@ public:
     virtual inline Transaction<XLEN_t> Read(XLEN_t startAddress, XLEN_t size, char* buf) = 0;
     virtual inline Transaction<XLEN_t> Write(XLEN_t startAddress, XLEN_t size, char* buf) = 0;
     virtual inline Transaction<XLEN_t> Fetch(XLEN_t startAddress, XLEN_t size, char* buf) = 0;
+    // Writes desired over the size (at most 8) bytes at startAddress if they
+    // match expected, and leaves what was there in expected either way. This
+    // default is only atomic if nothing else touches that memory meanwhile, so
+    // Transactors for memory that host threads share override it.
+    virtual inline Transaction<XLEN_t> CompareAndSwap(XLEN_t startAddress, XLEN_t size, char* expected, char* desired) {
+        char current[8];
+        Transaction<XLEN_t> transaction = Read(startAddress, size, current);
+        if (transaction.trapCause != RISCV::TrapCause::NONE) {
+            return { RISCV::TrapCause::STORE_AMO_ACCESS_FAULT, 0 };
+        }
+        if (memcmp(current, expected, size) != 0) {
+            memcpy(expected, current, size);
+            return { RISCV::TrapCause::NONE, size };
+        }
+        return Write(startAddress, size, desired);
+    }
     template<IOVerb verb>
     inline Transaction<XLEN_t> Transact(XLEN_t startAddress, XLEN_t size, char* buf) {
         if constexpr (verb == IOVerb::Read) {
@@ -0,0 +1,191 @@
+#pragma once
+
+/*
+ * A reference 16550 UART with byte-wide registers at consecutive addresses,
+ * as Linux's "ns16550a" expects. It's only as much of a 16550 as software
+ * notices: transmitted bytes go straight to the output callback, so the
+ * transmitter is always empty; received bytes queue up until the guest reads
+ * them; and the line control, modem and scratch registers just hold what's
+ * written. The interrupt callback follows the state of the UART's interrupt
+ * line, for the client to route to an interrupt controller.
+ */
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+#include <RiscV.hpp>
+#include <Transaction.hpp>
+#include <Transactor.hpp>
+
+template<typename XLEN_t>
+class UART16550 final : public Transactor<XLEN_t> {
+
+public:
+
+    static constexpr XLEN_t DefaultBase = 0x10000000;
+    static constexpr XLEN_t Size = 0x8;
+
+    enum Register : XLEN_t {
+        RBR_THR_DLL = 0,
+        IER_DLM = 1,
+        IIR_FCR = 2,
+        LCR = 3,
+        MCR = 4,
+        LSR = 5,
+        MSR = 6,
+        SCR = 7
+    };
+
+    enum Bits : __uint8_t {
+        IER_RX_AVAILABLE = 0x01,
+        IER_TX_EMPTY = 0x02,
+        IIR_NONE = 0x01,
+        IIR_TX_EMPTY = 0x02,
+        IIR_RX_AVAILABLE = 0x04,
+        IIR_FIFO_ENABLED = 0xC0,
+        LCR_DLAB = 0x80,
+        LSR_DATA_READY = 0x01,
+        LSR_TX_EMPTY = 0x60
+    };
+
+private:
+
+    XLEN_t base;
+    std::deque<char> received;
+    __uint8_t ier = 0, lcr = 0, mcr = 0, scr = 0, dll = 0, dlm = 0;
+    bool fifoEnabled = false;
+    bool txEmptyPending = false; // Cleared by reading IIR, as on the real part
+    bool interruptLine = false;
+
+    std::function<void(char)> output;
+    std::function<void(bool)> interrupt;
+
+    inline __uint8_t InterruptIdentification() {
+        __uint8_t fifoBits = fifoEnabled ? IIR_FIFO_ENABLED : 0;
+        if ((ier & IER_RX_AVAILABLE) && !received.empty()) {
+            return fifoBits | IIR_RX_AVAILABLE;
+        }
+        if ((ier & IER_TX_EMPTY) && txEmptyPending) {
+            return fifoBits | IIR_TX_EMPTY;
+        }
+        return fifoBits | IIR_NONE;
+    }
+
+    inline void UpdateInterrupt() {
+        bool line = !(InterruptIdentification() & IIR_NONE);
+        if (line != interruptLine) {
+            interruptLine = line;
+            interrupt(line);
+        }
+    }
+
+    inline __uint8_t ReadRegister(XLEN_t reg) {
+        switch (reg) {
+            case RBR_THR_DLL: {
+                if (lcr & LCR_DLAB) {
+                    return dll;
+                }
+                if (received.empty()) {
+                    return 0;
+                }
+                __uint8_t value = received.front();
+                received.pop_front();
+                return value;
+            }
+            case IER_DLM: return (lcr & LCR_DLAB) ? dlm : ier;
+            case IIR_FCR: {
+                __uint8_t value = InterruptIdentification();
+                if ((value & ~IIR_FIFO_ENABLED) == IIR_TX_EMPTY) {
+                    txEmptyPending = false;
+                }
+                return value;
+            }
+            case LCR: return lcr;
+            case MCR: return mcr;
+            case LSR: return LSR_TX_EMPTY | (received.empty() ? 0 : LSR_DATA_READY);
+            case MSR: return 0xB0; // DCD, DSR and CTS asserted
+            case SCR: return scr;
+            default: return 0;
+        }
+    }
+
+    inline void WriteRegister(XLEN_t reg, __uint8_t value) {
+        switch (reg) {
+            case RBR_THR_DLL:
+                if (lcr & LCR_DLAB) {
+                    dll = value;
+                    break;
+                }
+                output((char)value);
+                txEmptyPending = true;
+                break;
+            case IER_DLM:
+                if (lcr & LCR_DLAB) {
+                    dlm = value;
+                    break;
+                }
+                // Enabling the empty interrupt raises it, since we always are
+                if ((value & IER_TX_EMPTY) && !(ier & IER_TX_EMPTY)) {
+                    txEmptyPending = true;
+                }
+                ier = value & 0x0f;
+                break;
+            case IIR_FCR:
+                fifoEnabled = value & 0x01;
+                if (value & 0x02) {
+                    received.clear();
+                }
+                break;
+            case LCR: lcr = value; break;
+            case MCR: mcr = value; break;
+            case SCR: scr = value; break;
+            default: break;
+        }
+    }
+
+    template<IOVerb verb>
+    inline Transaction<XLEN_t> Access(XLEN_t startAddress, XLEN_t size, char* buf) {
+        if constexpr (verb == IOVerb::Fetch) {
+            return { AccessFault<verb>(), 0 };
+        }
+        for (XLEN_t i = 0; i < size; i++) {
+            XLEN_t reg = startAddress - base + i;
+            if constexpr (verb == IOVerb::Write) {
+                WriteRegister(reg, buf[i]);
+            } else {
+                buf[i] = ReadRegister(reg);
+            }
+        }
+        UpdateInterrupt();
+        return { RISCV::TrapCause::NONE, size };
+    }
+
+public:
+
+    UART16550(std::function<void(char)> output, std::function<void(bool)> interrupt = [](bool) {},
+              XLEN_t base = DefaultBase)
+        : base(base), output(output), interrupt(interrupt) {
+    }
+
+    inline Transaction<XLEN_t> Read(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Read>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Write(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Write>(startAddress, size, buf);
+    }
+
+    inline Transaction<XLEN_t> Fetch(XLEN_t startAddress, XLEN_t size, char* buf) override {
+        return Access<IOVerb::Fetch>(startAddress, size, buf);
+    }
+
+    // Input from the host side, e.g. a terminal
+    inline void Receive(char c) {
+        received.push_back(c);
+        UpdateInterrupt();
+    }
+
+    inline XLEN_t Base() { return base; }
+
+};
@@ -0,0 +1,527 @@
+#pragma once
+
+/*
+ * Executors for the V extension. The element-wise work is done by the kernels
+ * in VectorKernels.hpp; the executors here check legality against vtype, pick
+ * the element type for the current SEW and hand the register groups over.
+ *
+ * Tail and masked-off elements are always left undisturbed, which is a legal
+ * implementation of both the agnostic and undisturbed policies.
+ */
+
+#include <Instructions.hpp>
+#include <VectorKernels.hpp>
+#include <VectorState.hpp>
+
+#define V_VM          ExtendBits::Zero, 25, 25
+#define V_NF          ExtendBits::Zero, 31, 29
+#define V_SIMM5       ExtendBits::Sign, 19, 15
+#define V_UIMM5       ExtendBits::Zero, 19, 15
+#define VSETVLI_ZIMM  ExtendBits::Zero, 30, 20
+#define VSETIVLI_ZIMM ExtendBits::Zero, 29, 20
+
+enum class VectorOperand { Vector, Scalar, Immediate, UnsignedImmediate };
+enum class VectorAccess { UnitStride, Strided, WholeRegister, Mask };
+enum class VsetForm { Vsetvli, Vsetivli, Vsetvl };
+
+// Calls body with a T of the element type for the given vsew. Unsigned unless
+// the operation cares about sign (compares, min/max, right shifts, ...).
+template<bool is_signed, typename Body>
+inline void vector_for_sew(__uint32_t vsew, Body body) {
+    switch (vsew) {
+        case 0: body.template operator()<std::conditional_t<is_signed, __int8_t, __uint8_t>>(); break;
+        case 1: body.template operator()<std::conditional_t<is_signed, __int16_t, __uint16_t>>(); break;
+        case 2: body.template operator()<std::conditional_t<is_signed, __int32_t, __uint32_t>>(); break;
+        case 3: body.template operator()<std::conditional_t<is_signed, __int64_t, __uint64_t>>(); break;
+    }
+}
+
+// Every V instruction is illegal while mstatus.VS is Off. Otherwise VS goes
+// Dirty up front, as the spec allows, rather than each executor working out
+// whether it really changed anything.
+template<typename XLEN_t>
+inline bool vector_enabled(__uint32_t encoding, HartState<XLEN_t> *state) {
+    if (!state->VectorEnabled()) [[unlikely]] {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return false;
+    }
+    state->DirtyVector();
+    return true;
+}
+
+// The second operand of .vx and .vi forms. x registers narrower than SEW are
+// sign-extended; immediates are simm5, except for shifts, which take uimm5.
+template<typename XLEN_t, typename T, VectorOperand operand>
+inline T vector_scalar_operand(__uint32_t encoding, HartState<XLEN_t> *state) {
+    if constexpr (operand == VectorOperand::Scalar) {
+        return (T)(std::make_signed_t<XLEN_t>)state->regs[swizzle<__uint32_t, RS1>(encoding)];
+    } else if constexpr (operand == VectorOperand::Immediate) {
+        return (T)(__int32_t)swizzle<__uint32_t, V_SIMM5>(encoding);
+    } else if constexpr (operand == VectorOperand::UnsignedImmediate) {
+        return (T)swizzle<__uint32_t, V_UIMM5>(encoding);
+    } else {
+        return 0;
+    }
+}
+
+// Every register group must be aligned to LMUL, and a masked instruction that
+// writes a group (rather than a mask) must not overwrite v0.
+template<typename XLEN_t, VectorOperand operand>
+inline bool vector_operands_illegal(__uint32_t encoding, HartState<XLEN_t> *state, bool vd_is_group) {
+    VectorState& v = state->vector;
+    int lmul = v.LMULShift();
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t vs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t vs2 = swizzle<__uint32_t, RS2>(encoding);
+    bool masked = !swizzle<__uint32_t, V_VM>(encoding);
+    return v.vill ||
+           (vd_is_group && !VectorState::GroupAligned(vd, lmul)) ||
+           (vd_is_group && masked && vd == 0) ||
+           !VectorState::GroupAligned(vs2, lmul) ||
+           (operand == VectorOperand::Vector && !VectorState::GroupAligned(vs1, lmul));
+}
+
+template<typename XLEN_t>
+inline const __uint8_t* vector_mask(__uint32_t encoding, HartState<XLEN_t> *state) {
+    return swizzle<__uint32_t, V_VM>(encoding) ? nullptr : state->vector.Register(0);
+}
+
+template<StringLiteral mnemonic, VectorOperand operand>
+inline void print_vector_instr(__uint32_t encoding, std::ostream* out) {
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t vs2 = swizzle<__uint32_t, RS2>(encoding);
+    *out << mnemonic.value;
+    switch (operand) {
+        case VectorOperand::Vector: *out << ".vv v" << vd << ", v" << vs2 << ", v" << rs1; break;
+        case VectorOperand::Scalar: *out << ".vx v" << vd << ", v" << vs2 << ", " << RISCV::regName(rs1); break;
+        case VectorOperand::Immediate: *out << ".vi v" << vd << ", v" << vs2 << ", " << (__int32_t)swizzle<__uint32_t, V_SIMM5>(encoding); break;
+        case VectorOperand::UnsignedImmediate: *out << ".vi v" << vd << ", v" << vs2 << ", " << rs1; break;
+    }
+    *out << (swizzle<__uint32_t, V_VM>(encoding) ? "" : ", v0.t") << std::endl;
+}
+
+template<VectorOperand operand>
+inline void print_vector_merge(__uint32_t encoding, std::ostream* out) {
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t vs2 = swizzle<__uint32_t, RS2>(encoding);
+    const char *suffix = operand == VectorOperand::Vector ? "v" : operand == VectorOperand::Scalar ? "x" : "i";
+    if (swizzle<__uint32_t, V_VM>(encoding)) {
+        *out << "vmv.v." << suffix << " v" << vd << ", ";
+    } else {
+        *out << "vmerge.v" << suffix << "m v" << vd << ", v" << vs2 << ", ";
+    }
+    switch (operand) {
+        case VectorOperand::Vector: *out << "v" << rs1; break;
+        case VectorOperand::Scalar: *out << RISCV::regName(rs1); break;
+        default: *out << (__int32_t)swizzle<__uint32_t, V_SIMM5>(encoding); break;
+    }
+    *out << (swizzle<__uint32_t, V_VM>(encoding) ? "" : ", v0") << std::endl;
+}
+
+template<StringLiteral mnemonic>
+inline void print_vector_reduction(__uint32_t encoding, std::ostream* out) {
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t vs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t vs2 = swizzle<__uint32_t, RS2>(encoding);
+    *out << mnemonic.value << ".vs v" << vd << ", v" << vs2 << ", v" << vs1 << (swizzle<__uint32_t, V_VM>(encoding) ? "" : ", v0.t") << std::endl;
+}
+
+template<bool to_scalar>
+inline void print_vector_scalar_move(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t vs2 = swizzle<__uint32_t, RS2>(encoding);
+    if constexpr (to_scalar) {
+        *out << "vmv.x.s " << RISCV::regName(rd) << ", v" << vs2 << std::endl;
+    } else {
+        *out << "vmv.s.x v" << rd << ", " << RISCV::regName(rs1) << std::endl;
+    }
+}
+
+inline void print_vid(__uint32_t encoding, std::ostream* out) {
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    *out << "vid.v v" << vd << (swizzle<__uint32_t, V_VM>(encoding) ? "" : ", v0.t") << std::endl;
+}
+
+template<VsetForm form>
+inline void print_vset(__uint32_t encoding, std::ostream* out) {
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    if constexpr (form == VsetForm::Vsetvl) {
+        *out << "vsetvl " << RISCV::regName(rd) << ", " << RISCV::regName(rs1) << ", " << RISCV::regName(rs2) << std::endl;
+        return;
+    }
+    __uint32_t zimm = form == VsetForm::Vsetvli ? swizzle<__uint32_t, VSETVLI_ZIMM>(encoding) : swizzle<__uint32_t, VSETIVLI_ZIMM>(encoding);
+    const char *lmul_names[] = { "m1", "m2", "m4", "m8", "m?", "mf8", "mf4", "mf2" };
+    *out << (form == VsetForm::Vsetvli ? "vsetvli " : "vsetivli ") << RISCV::regName(rd) << ", ";
+    if constexpr (form == VsetForm::Vsetvli) {
+        *out << RISCV::regName(rs1);
+    } else {
+        *out << rs1;
+    }
+    *out << ", e" << (8 << ((zimm >> 3) & 0b111)) << ", " << lmul_names[zimm & 0b111]
+         << ((zimm >> 6) & 1 ? ", ta" : ", tu") << ((zimm >> 7) & 1 ? ", ma" : ", mu") << std::endl;
+}
+
+template<typename EEW_t, VectorAccess access, IOVerb verb>
+inline void print_vector_memory(__uint32_t encoding, std::ostream* out) {
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    *out << (verb == IOVerb::Read ? "vl" : "vs");
+    switch (access) {
+        case VectorAccess::UnitStride: *out << "e" << sizeof(EEW_t)*8; break;
+        case VectorAccess::Strided: *out << "se" << sizeof(EEW_t)*8; break;
+        case VectorAccess::WholeRegister:
+            *out << swizzle<__uint32_t, V_NF>(encoding) + 1 << "r";
+            if (verb == IOVerb::Read) *out << "e" << sizeof(EEW_t)*8;
+            break;
+        case VectorAccess::Mask: *out << "m"; break;
+    }
+    *out << ".v v" << vd << ", (" << RISCV::regName(rs1) << ")";
+    if (access == VectorAccess::Strided) *out << ", " << RISCV::regName(rs2);
+    *out << (swizzle<__uint32_t, V_VM>(encoding) ? "" : ", v0.t") << std::endl;
+}
+
+template<typename XLEN_t, VsetForm form>
+inline void ex_vset(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    XLEN_t vtype;
+    XLEN_t avl;
+    if constexpr (form == VsetForm::Vsetvli) {
+        vtype = swizzle<__uint32_t, VSETVLI_ZIMM>(encoding);
+    } else if constexpr (form == VsetForm::Vsetivli) {
+        vtype = swizzle<__uint32_t, VSETIVLI_ZIMM>(encoding);
+    } else {
+        vtype = state->regs[rs2];
+    }
+    if constexpr (form == VsetForm::Vsetivli) {
+        avl = rs1;
+    } else if (rs1 != 0) {
+        avl = state->regs[rs1];
+    } else if (rd != 0) {
+        avl = ~(XLEN_t)0; // VLMAX
+    } else {
+        avl = state->vector.vl; // Change vtype, keep vl
+    }
+    state->regs[rd] = state->vector.template SetVType<XLEN_t>(vtype, avl);
+    state->regs[0] = 0;
+    state->vector.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+template<typename XLEN_t, template<typename> typename Operation, bool is_signed, VectorOperand operand>
+inline void ex_vector_binary_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    if (vector_operands_illegal<XLEN_t, operand>(encoding, state, true)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    VectorState& v = state->vector;
+    __uint8_t* vd = v.Register(swizzle<__uint32_t, RD>(encoding));
+    __uint8_t* vs1 = v.Register(swizzle<__uint32_t, RS1>(encoding));
+    __uint8_t* vs2 = v.Register(swizzle<__uint32_t, RS2>(encoding));
+    const __uint8_t* mask = vector_mask(encoding, state);
+    vector_for_sew<is_signed>(v.vsew, [&]<typename T>() {
+        VectorKernels::Binary<T, Operation<T>, operand != VectorOperand::Vector>(
+            vd, vs2, vs1, vector_scalar_operand<XLEN_t, T, operand>(encoding, state), mask, v.vstart, v.vl);
+    });
+    v.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+template<typename XLEN_t, template<typename> typename Operation, VectorOperand operand>
+inline void ex_vector_ternary_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    if (vector_operands_illegal<XLEN_t, operand>(encoding, state, true)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    VectorState& v = state->vector;
+    __uint8_t* vd = v.Register(swizzle<__uint32_t, RD>(encoding));
+    __uint8_t* vs1 = v.Register(swizzle<__uint32_t, RS1>(encoding));
+    __uint8_t* vs2 = v.Register(swizzle<__uint32_t, RS2>(encoding));
+    const __uint8_t* mask = vector_mask(encoding, state);
+    vector_for_sew<false>(v.vsew, [&]<typename T>() {
+        VectorKernels::Ternary<T, Operation<T>, operand != VectorOperand::Vector>(
+            vd, vs2, vs1, vector_scalar_operand<XLEN_t, T, operand>(encoding, state), mask, v.vstart, v.vl);
+    });
+    v.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+template<typename XLEN_t, template<typename> typename Comparison, bool is_signed, VectorOperand operand>
+inline void ex_vector_compare_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    if (vector_operands_illegal<XLEN_t, operand>(encoding, state, false)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    VectorState& v = state->vector;
+    __uint8_t* vd = v.Register(swizzle<__uint32_t, RD>(encoding));
+    __uint8_t* vs1 = v.Register(swizzle<__uint32_t, RS1>(encoding));
+    __uint8_t* vs2 = v.Register(swizzle<__uint32_t, RS2>(encoding));
+    const __uint8_t* mask = vector_mask(encoding, state);
+    __uint8_t result[VectorState::VLENB];
+    memcpy(result, vd, VectorState::VLENB);
+    vector_for_sew<is_signed>(v.vsew, [&]<typename T>() {
+        VectorKernels::Compare<T, Comparison<T>, operand != VectorOperand::Vector>(
+            result, vs2, vs1, vector_scalar_operand<XLEN_t, T, operand>(encoding, state), mask, v.vstart, v.vl);
+    });
+    memcpy(vd, result, VectorState::VLENB);
+    v.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+// vmerge when masked, vmv.v when not. The decoder has made sure vs2 is v0 for
+// the latter.
+template<typename XLEN_t, VectorOperand operand>
+inline void ex_vector_merge(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    bool merge = !swizzle<__uint32_t, V_VM>(encoding);
+    __uint32_t vd_reg = swizzle<__uint32_t, RD>(encoding);
+    if (vector_operands_illegal<XLEN_t, operand>(encoding, state, false) ||
+        !VectorState::GroupAligned(vd_reg, state->vector.LMULShift()) || (merge && vd_reg == 0)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    VectorState& v = state->vector;
+    __uint8_t* vd = v.Register(vd_reg);
+    __uint8_t* vs1 = v.Register(swizzle<__uint32_t, RS1>(encoding));
+    __uint8_t* vs2 = v.Register(swizzle<__uint32_t, RS2>(encoding));
+    vector_for_sew<false>(v.vsew, [&]<typename T>() {
+        T scalar = vector_scalar_operand<XLEN_t, T, operand>(encoding, state);
+        if (!merge) {
+            VectorKernels::Binary<T, VectorKernels::Move<T>, operand != VectorOperand::Vector>(
+                vd, vs2, vs1, scalar, nullptr, v.vstart, v.vl);
+            return;
+        }
+        for (__uint64_t i = v.vstart; i < v.vl; i++) {
+            T chosen = v.MaskBit(0, i) ? (operand == VectorOperand::Vector ? VectorKernels::Load<T>(vs1, i) : scalar)
+                                       : VectorKernels::Load<T>(vs2, i);
+            VectorKernels::Store<T>(vd, i, chosen);
+        }
+    });
+    v.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+// vd[0] = vs1[0] folded with the active elements of vs2. Only vs2 is a group.
+template<typename XLEN_t, template<typename> typename Operation, bool is_signed>
+inline void ex_vector_reduction_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    VectorState& v = state->vector;
+    if (v.vill || v.vstart != 0 || !VectorState::GroupAligned(swizzle<__uint32_t, RS2>(encoding), v.LMULShift())) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t vs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint8_t* vs2 = v.Register(swizzle<__uint32_t, RS2>(encoding));
+    const __uint8_t* mask = vector_mask(encoding, state);
+    if (v.vl != 0) {
+        vector_for_sew<is_signed>(v.vsew, [&]<typename T>() {
+            v.SetElement<T>(vd, 0, VectorKernels::Reduce<T, Operation<T>>(vs2, v.Element<T>(vs1, 0), mask, 0, v.vl));
+        });
+    }
+    state->pc += inst_length(encoding);
+}
+
+template<typename XLEN_t>
+inline void ex_vmv_x_s(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    VectorState& v = state->vector;
+    if (v.vill) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t rd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t vs2 = swizzle<__uint32_t, RS2>(encoding);
+    vector_for_sew<true>(v.vsew, [&]<typename T>() {
+        state->regs[rd] = (std::make_signed_t<XLEN_t>)v.Element<T>(vs2, 0);
+    });
+    state->regs[0] = 0;
+    v.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+template<typename XLEN_t>
+inline void ex_vmv_s_x(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    VectorState& v = state->vector;
+    if (v.vill) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    if (v.vstart < v.vl) {
+        vector_for_sew<false>(v.vsew, [&]<typename T>() {
+            v.SetElement<T>(vd, 0, (T)(std::make_signed_t<XLEN_t>)state->regs[rs1]);
+        });
+    }
+    v.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+template<typename XLEN_t>
+inline void ex_vid(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    if (vector_operands_illegal<XLEN_t, VectorOperand::Scalar>(encoding, state, true)) {
+        state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+        return;
+    }
+    VectorState& v = state->vector;
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    const __uint8_t* mask = vector_mask(encoding, state);
+    vector_for_sew<false>(v.vsew, [&]<typename T>() {
+        for (__uint64_t i = v.vstart; i < v.vl; i++) {
+            if (VectorKernels::Active(mask, i)) {
+                v.SetElement<T>(vd, i, (T)i);
+            }
+        }
+    });
+    v.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+// Loads and stores move data straight between memory and the register file.
+// An unmasked contiguous access is a single bulk transaction; anything else
+// goes element by element. A fault leaves vstart at the faulting element so
+// the access resumes there once the trap is handled.
+template<typename XLEN_t, typename EEW_t, VectorAccess access, IOVerb verb>
+inline void ex_vector_memory_generic(__uint32_t encoding, HartState<XLEN_t> *state, Transactor<XLEN_t> *mem) {
+    if (!vector_enabled(encoding, state)) {
+        return;
+    }
+    VectorState& v = state->vector;
+    __uint32_t vd = swizzle<__uint32_t, RD>(encoding);
+    __uint32_t rs1 = swizzle<__uint32_t, RS1>(encoding);
+    __uint32_t rs2 = swizzle<__uint32_t, RS2>(encoding);
+    bool masked = !swizzle<__uint32_t, V_VM>(encoding);
+
+    __uint64_t evl;
+    if constexpr (access == VectorAccess::WholeRegister) {
+        __uint32_t registers = swizzle<__uint32_t, V_NF>(encoding) + 1;
+        evl = registers * VectorState::VLENB / sizeof(EEW_t);
+        if (vd % registers != 0) {
+            state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+            return;
+        }
+    } else if constexpr (access == VectorAccess::Mask) {
+        evl = (v.vl + 7) / 8;
+        if (v.vill) {
+            state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+            return;
+        }
+    } else {
+        evl = v.vl;
+        int emul = v.EMULShift(sizeof(EEW_t));
+        if (v.vill || emul < -3 || emul > 3 || !VectorState::GroupAligned(vd, emul) || (masked && vd == 0)) {
+            state->RaiseException(RISCV::TrapCause::ILLEGAL_INSTRUCTION, inst_tval(encoding));
+            return;
+        }
+    }
+
+    char* group = (char*)v.Register(vd);
+    XLEN_t base = state->regs[rs1];
+
+    if (access != VectorAccess::Strided && !masked) {
+        if (v.vstart < evl) {
+            XLEN_t address = base + v.vstart * sizeof(EEW_t);
+            XLEN_t size = (evl - v.vstart) * sizeof(EEW_t);
+            Transaction<XLEN_t> transaction = mem->template Transact<verb>(address, size, group + v.vstart * sizeof(EEW_t));
+            if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != size) {
+                __uint64_t completed = transaction.transferredSize / sizeof(EEW_t);
+                v.vstart += completed;
+                state->RaiseException(transaction.trapCause, address + completed * sizeof(EEW_t));
+                return;
+            }
+        }
+    } else {
+        XLEN_t stride = access == VectorAccess::Strided ? state->regs[rs2] : sizeof(EEW_t);
+        for (__uint64_t i = v.vstart; i < evl; i++) {
+            if (masked && !v.MaskBit(0, i)) {
+                continue;
+            }
+            XLEN_t address = base + i * stride;
+            Transaction<XLEN_t> transaction = mem->template Transact<verb>(address, sizeof(EEW_t), group + i * sizeof(EEW_t));
+            if (transaction.trapCause != RISCV::TrapCause::NONE || transaction.transferredSize != sizeof(EEW_t)) {
+                v.vstart = i;
+                state->RaiseException(transaction.trapCause, address);
+                return;
+            }
+        }
+    }
+    v.vstart = 0;
+    state->pc += inst_length(encoding);
+}
+
+// TODO segment, indexed and fault-only-first accesses; widening, narrowing,
+// fixed-point, permutation and mask-logical ops; the FP vector ops. Until then
+// the decoder maps them to inst_illegal.
+
+template<typename XLEN_t, VsetForm form> Instruction<XLEN_t> inst_vset { ex_vset<XLEN_t, form>, print_vset<form> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vadd  { ex_vector_binary_generic<XLEN_t, VectorKernels::Add, false, operand>, print_vector_instr<"vadd", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vsub  { ex_vector_binary_generic<XLEN_t, VectorKernels::Subtract, false, operand>, print_vector_instr<"vsub", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vrsub { ex_vector_binary_generic<XLEN_t, VectorKernels::ReverseSubtract, false, operand>, print_vector_instr<"vrsub", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vminu { ex_vector_binary_generic<XLEN_t, VectorKernels::Min, false, operand>, print_vector_instr<"vminu", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmin  { ex_vector_binary_generic<XLEN_t, VectorKernels::Min, true, operand>, print_vector_instr<"vmin", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmaxu { ex_vector_binary_generic<XLEN_t, VectorKernels::Max, false, operand>, print_vector_instr<"vmaxu", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmax  { ex_vector_binary_generic<XLEN_t, VectorKernels::Max, true, operand>, print_vector_instr<"vmax", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vand  { ex_vector_binary_generic<XLEN_t, VectorKernels::And, false, operand>, print_vector_instr<"vand", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vor   { ex_vector_binary_generic<XLEN_t, VectorKernels::Or, false, operand>, print_vector_instr<"vor", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vxor  { ex_vector_binary_generic<XLEN_t, VectorKernels::Xor, false, operand>, print_vector_instr<"vxor", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vsll  { ex_vector_binary_generic<XLEN_t, VectorKernels::ShiftLeft, false, operand>, print_vector_instr<"vsll", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vsrl  { ex_vector_binary_generic<XLEN_t, VectorKernels::ShiftRight, false, operand>, print_vector_instr<"vsrl", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vsra  { ex_vector_binary_generic<XLEN_t, VectorKernels::ShiftRight, true, operand>, print_vector_instr<"vsra", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmul  { ex_vector_binary_generic<XLEN_t, VectorKernels::Multiply, false, operand>, print_vector_instr<"vmul", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmulh { ex_vector_binary_generic<XLEN_t, VectorKernels::MultiplyHigh, true, operand>, print_vector_instr<"vmulh", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmulhu { ex_vector_binary_generic<XLEN_t, VectorKernels::MultiplyHigh, false, operand>, print_vector_instr<"vmulhu", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmacc  { ex_vector_ternary_generic<XLEN_t, VectorKernels::MultiplyAccumulate, operand>, print_vector_instr<"vmacc", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vnmsac { ex_vector_ternary_generic<XLEN_t, VectorKernels::NegativeMultiplySubtract, operand>, print_vector_instr<"vnmsac", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmerge { ex_vector_merge<XLEN_t, operand>, print_vector_merge<operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmseq  { ex_vector_compare_generic<XLEN_t, std::equal_to, false, operand>, print_vector_instr<"vmseq", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmsne  { ex_vector_compare_generic<XLEN_t, std::not_equal_to, false, operand>, print_vector_instr<"vmsne", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmsltu { ex_vector_compare_generic<XLEN_t, std::less, false, operand>, print_vector_instr<"vmsltu", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmslt  { ex_vector_compare_generic<XLEN_t, std::less, true, operand>, print_vector_instr<"vmslt", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmsleu { ex_vector_compare_generic<XLEN_t, std::less_equal, false, operand>, print_vector_instr<"vmsleu", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmsle  { ex_vector_compare_generic<XLEN_t, std::less_equal, true, operand>, print_vector_instr<"vmsle", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmsgtu { ex_vector_compare_generic<XLEN_t, std::greater, false, operand>, print_vector_instr<"vmsgtu", operand> };
+template<typename XLEN_t, VectorOperand operand> Instruction<XLEN_t> inst_vmsgt  { ex_vector_compare_generic<XLEN_t, std::greater, true, operand>, print_vector_instr<"vmsgt", operand> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vredsum  { ex_vector_reduction_generic<XLEN_t, VectorKernels::Add, false>, print_vector_reduction<"vredsum"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vredand  { ex_vector_reduction_generic<XLEN_t, VectorKernels::And, false>, print_vector_reduction<"vredand"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vredor   { ex_vector_reduction_generic<XLEN_t, VectorKernels::Or, false>, print_vector_reduction<"vredor"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vredxor  { ex_vector_reduction_generic<XLEN_t, VectorKernels::Xor, false>, print_vector_reduction<"vredxor"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vredminu { ex_vector_reduction_generic<XLEN_t, VectorKernels::Min, false>, print_vector_reduction<"vredminu"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vredmin  { ex_vector_reduction_generic<XLEN_t, VectorKernels::Min, true>, print_vector_reduction<"vredmin"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vredmaxu { ex_vector_reduction_generic<XLEN_t, VectorKernels::Max, false>, print_vector_reduction<"vredmaxu"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vredmax  { ex_vector_reduction_generic<XLEN_t, VectorKernels::Max, true>, print_vector_reduction<"vredmax"> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vmv_x_s { ex_vmv_x_s<XLEN_t>, print_vector_scalar_move<true> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vmv_s_x { ex_vmv_s_x<XLEN_t>, print_vector_scalar_move<false> };
+template<typename XLEN_t> Instruction<XLEN_t> inst_vid { ex_vid<XLEN_t>, print_vid };
+template<typename XLEN_t, typename EEW_t, VectorAccess access, IOVerb verb> Instruction<XLEN_t> inst_vector_memory { ex_vector_memory_generic<XLEN_t, EEW_t, access, verb>, print_vector_memory<EEW_t, access, verb> };
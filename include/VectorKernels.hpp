@@ -0,0 +1,269 @@
+#pragma once
+
+/*
+ * Host SIMD kernels behind the V extension's element-wise integer ops and
+ * reductions. A kernel sees a register group as a flat array of elements and
+ * walks it a host vector at a time, using GCC/Clang vector extensions so the
+ * same code lowers to AVX-512, AVX2 or SSE2 (or NEON) depending on what the
+ * build targets. Whatever doesn't fill a host vector - the tail, masked and
+ * restarted (vstart != 0) instructions, operations with no host vector form,
+ * and everything on compilers without vector extensions - goes through the
+ * scalar fallback, which applies the very same operation one element at a time.
+ *
+ * Operations are templated on the element type, and have a templated call
+ * operator so one functor serves both paths. Those that can't be expressed on
+ * host vectors (they need a wider type, say) say so with vectorizes = false.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace VectorKernels {
+
+#if defined(__AVX512BW__)
+inline constexpr unsigned int HostVectorBytes = 64;
+#elif defined(__AVX2__)
+inline constexpr unsigned int HostVectorBytes = 32;
+#else
+inline constexpr unsigned int HostVectorBytes = 16;
+#endif
+
+#if defined(__GNUC__)
+#define HARTKIT_HOST_VECTORS
+template<typename T>
+struct HostVector {
+    typedef T type __attribute__((vector_size(HostVectorBytes)));
+};
+#endif
+
+template<typename T>
+struct Add {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a + b; }
+};
+
+template<typename T>
+struct Subtract {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a - b; }
+};
+
+template<typename T>
+struct ReverseSubtract {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return b - a; }
+};
+
+template<typename T>
+struct And {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a & b; }
+};
+
+template<typename T>
+struct Or {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a | b; }
+};
+
+template<typename T>
+struct Xor {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a ^ b; }
+};
+
+template<typename T>
+struct Min {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a < b ? a : b; }
+};
+
+template<typename T>
+struct Max {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a > b ? a : b; }
+};
+
+template<typename T>
+struct Multiply {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a * b; }
+};
+
+// Used by vmv.v.*, which only reads its second operand
+template<typename T>
+struct Move {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return b; }
+};
+
+// Shift amounts only use the low log2(SEW) bits. Whether a right shift is
+// arithmetic or logical follows the signedness of the element type.
+template<typename T>
+struct ShiftLeft {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a << (b & (sizeof(T)*8 - 1)); }
+};
+
+template<typename T>
+struct ShiftRight {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b) const { return a >> (b & (sizeof(T)*8 - 1)); }
+};
+
+template<typename T>
+struct MultiplyHigh {
+    static constexpr bool vectorizes = false;
+    typedef std::conditional_t<std::is_signed_v<T>, __int128_t, __uint128_t> Wide;
+    T operator()(T a, T b) const { return (T)(((Wide)a * (Wide)b) >> (sizeof(T)*8)); }
+};
+
+// Three-operand forms: the third operand is the old destination element
+template<typename T>
+struct MultiplyAccumulate {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b, U d) const { return d + a * b; }
+};
+
+template<typename T>
+struct NegativeMultiplySubtract {
+    static constexpr bool vectorizes = true;
+    template<typename U> U operator()(U a, U b, U d) const { return d - a * b; }
+};
+
+inline bool Active(const __uint8_t* mask, __uint64_t index) {
+    return mask == nullptr || ((mask[index / 8] >> (index % 8)) & 1);
+}
+
+template<typename T>
+inline T Load(const __uint8_t* base, __uint64_t index) {
+    T value;
+    memcpy(&value, base + index * sizeof(T), sizeof(T));
+    return value;
+}
+
+template<typename T>
+inline void Store(__uint8_t* base, __uint64_t index, T value) {
+    memcpy(base + index * sizeof(T), &value, sizeof(T));
+}
+
+// vd[i] = operation(vs2[i], vs1[i] or scalar), for active i in [vstart, vl).
+// mask is v0, or nullptr for an unmasked instruction.
+template<typename T, typename Operation, bool scalar_rhs>
+inline void Binary(__uint8_t* vd, const __uint8_t* vs2, const __uint8_t* vs1, T scalar,
+                   const __uint8_t* mask, __uint64_t vstart, __uint64_t vl) {
+    Operation operation;
+    __uint64_t i = vstart;
+#if defined(HARTKIT_HOST_VECTORS)
+    if constexpr (Operation::vectorizes) {
+        typedef typename HostVector<T>::type V;
+        constexpr __uint64_t lanes = sizeof(V) / sizeof(T);
+        if (mask == nullptr) {
+            V b = V{} + scalar;
+            for (; i + lanes <= vl; i += lanes) {
+                V a;
+                memcpy(&a, vs2 + i * sizeof(T), sizeof(V));
+                if constexpr (!scalar_rhs) {
+                    memcpy(&b, vs1 + i * sizeof(T), sizeof(V));
+                }
+                V result = operation(a, b);
+                memcpy(vd + i * sizeof(T), &result, sizeof(V));
+            }
+        }
+    }
+#endif
+    for (; i < vl; i++) {
+        if (!Active(mask, i)) {
+            continue;
+        }
+        T b = scalar_rhs ? scalar : Load<T>(vs1, i);
+        Store<T>(vd, i, operation(Load<T>(vs2, i), b));
+    }
+}
+
+// vd[i] = operation(vs2[i], vs1[i] or scalar, vd[i])
+template<typename T, typename Operation, bool scalar_rhs>
+inline void Ternary(__uint8_t* vd, const __uint8_t* vs2, const __uint8_t* vs1, T scalar,
+                    const __uint8_t* mask, __uint64_t vstart, __uint64_t vl) {
+    Operation operation;
+    __uint64_t i = vstart;
+#if defined(HARTKIT_HOST_VECTORS)
+    if constexpr (Operation::vectorizes) {
+        typedef typename HostVector<T>::type V;
+        constexpr __uint64_t lanes = sizeof(V) / sizeof(T);
+        if (mask == nullptr) {
+            V b = V{} + scalar;
+            for (; i + lanes <= vl; i += lanes) {
+                V a, d;
+                memcpy(&a, vs2 + i * sizeof(T), sizeof(V));
+                memcpy(&d, vd + i * sizeof(T), sizeof(V));
+                if constexpr (!scalar_rhs) {
+                    memcpy(&b, vs1 + i * sizeof(T), sizeof(V));
+                }
+                V result = operation(a, b, d);
+                memcpy(vd + i * sizeof(T), &result, sizeof(V));
+            }
+        }
+    }
+#endif
+    for (; i < vl; i++) {
+        if (!Active(mask, i)) {
+            continue;
+        }
+        T b = scalar_rhs ? scalar : Load<T>(vs1, i);
+        Store<T>(vd, i, operation(Load<T>(vs2, i), b, Load<T>(vd, i)));
+    }
+}
+
+// Folds the active elements of vs2 into init. Every integer reduction is
+// associative and commutative, so lanes are accumulated independently and
+// folded together at the end.
+template<typename T, typename Operation>
+inline T Reduce(const __uint8_t* vs2, T init, const __uint8_t* mask, __uint64_t vstart, __uint64_t vl) {
+    Operation operation;
+    T result = init;
+    __uint64_t i = vstart;
+#if defined(HARTKIT_HOST_VECTORS)
+    if constexpr (Operation::vectorizes) {
+        typedef typename HostVector<T>::type V;
+        constexpr __uint64_t lanes = sizeof(V) / sizeof(T);
+        if (mask == nullptr && i + lanes <= vl) {
+            V accumulator;
+            memcpy(&accumulator, vs2 + i * sizeof(T), sizeof(V));
+            for (i += lanes; i + lanes <= vl; i += lanes) {
+                V a;
+                memcpy(&a, vs2 + i * sizeof(T), sizeof(V));
+                accumulator = operation(accumulator, a);
+            }
+            for (__uint64_t lane = 0; lane < lanes; lane++) {
+                result = operation(result, (T)accumulator[lane]);
+            }
+        }
+    }
+#endif
+    for (; i < vl; i++) {
+        if (Active(mask, i)) {
+            result = operation(result, Load<T>(vs2, i));
+        }
+    }
+    return result;
+}
+
+// Mask-producing compares stay scalar; they write one bit per element into a
+// scratch mask that the caller copies over vd, since vd may overlap a source.
+template<typename T, typename Comparison, bool scalar_rhs>
+inline void Compare(__uint8_t* result, const __uint8_t* vs2, const __uint8_t* vs1, T scalar,
+                    const __uint8_t* mask, __uint64_t vstart, __uint64_t vl) {
+    Comparison comparison;
+    for (__uint64_t i = vstart; i < vl; i++) {
+        if (!Active(mask, i)) {
+            continue;
+        }
+        T b = scalar_rhs ? scalar : Load<T>(vs1, i);
+        bool bit = comparison(Load<T>(vs2, i), b);
+        result[i / 8] = (result[i / 8] & ~(1 << (i % 8))) | (bit << (i % 8));
+    }
+}
+
+} // namespace VectorKernels
@@ -0,0 +1,193 @@
+#pragma once
+
+/*
+ * Architectural state of the V extension. VLEN is a compile-time constant so
+ * the register file can sit inline in HartState and the kernels can size their
+ * loops statically. Clients choose it by defining HARTKIT_VLEN before including
+ * any HartKit header; it must be a power of two no smaller than ELEN.
+ *
+ * The register file is one flat byte array, so a register group of LMUL > 1 is
+ * just a longer run of it starting at the group's base register. Element i of a
+ * group is at byte offset i*SEW/8 from there, on a little-endian host.
+ */
+
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#include <RiscV.hpp>
+
+#ifndef HARTKIT_VLEN
+#define HARTKIT_VLEN 128
+#endif
+
+struct VectorState {
+
+    static constexpr unsigned int VLEN = HARTKIT_VLEN;
+    static constexpr unsigned int VLENB = VLEN / 8;
+    static constexpr unsigned int ELEN = 64;
+    static_assert(VLEN >= ELEN && (VLEN & (VLEN - 1)) == 0, "VLEN must be a power of two, at least ELEN");
+
+    // Not all of these are in RISCV::CSRAddress, so they're matched by value.
+    enum CSR : __uint32_t {
+        VSTART = 0x008,
+        VXSAT = 0x009,
+        VXRM = 0x00A,
+        VCSR = 0x00F,
+        VL = 0xC20,
+        VTYPE = 0xC21,
+        VLENB_CSR = 0xC22
+    };
+
+    alignas(64) __uint8_t vregs[32 * VLENB];
+
+    __uint64_t vl;
+    __uint64_t vstart;
+
+    // vtype, broken out
+    bool vill;
+    bool vma;
+    bool vta;
+    __uint32_t vsew;  // SEW is 8 << vsew
+    __uint32_t vlmul; // 0-3 are LMUL 1-8, 5-7 are LMUL 1/8-1/2
+
+    __uint32_t vxrm;
+    bool vxsat;
+
+    // mstatus.VS. Neither mstatus type has the field, so it lives here and
+    // HartState splices it into mstatus and sstatus.
+    __uint32_t vs;
+
+    void Reset() {
+        memset(vregs, 0, sizeof(vregs));
+        vl = 0;
+        vstart = 0;
+        vill = true;
+        vma = false;
+        vta = false;
+        vsew = 0;
+        vlmul = 0;
+        vxrm = 0;
+        vxsat = false;
+        vs = 0;
+    }
+
+    inline __uint8_t* Register(unsigned int reg) {
+        return &vregs[reg * VLENB];
+    }
+
+    template<typename T>
+    inline T Element(unsigned int reg, __uint64_t index) {
+        T value;
+        memcpy(&value, &vregs[reg * VLENB + index * sizeof(T)], sizeof(T));
+        return value;
+    }
+
+    template<typename T>
+    inline void SetElement(unsigned int reg, __uint64_t index, T value) {
+        memcpy(&vregs[reg * VLENB + index * sizeof(T)], &value, sizeof(T));
+    }
+
+    inline bool MaskBit(unsigned int reg, __uint64_t index) {
+        return (vregs[reg * VLENB + index / 8] >> (index % 8)) & 1;
+    }
+
+    inline void SetMaskBit(unsigned int reg, __uint64_t index, bool value) {
+        __uint8_t& byte = vregs[reg * VLENB + index / 8];
+        byte = (byte & ~(1 << (index % 8))) | (value << (index % 8));
+    }
+
+    // log2 of LMUL, or of EMUL for a memory access of the given element width
+    inline int LMULShift() {
+        return vlmul < 4 ? (int)vlmul : (int)vlmul - 8;
+    }
+
+    inline int EMULShift(unsigned int eewBytes) {
+        return std::countr_zero(eewBytes) - (int)vsew + LMULShift();
+    }
+
+    static inline __uint64_t VLMAX(__uint32_t sew, int lmulShift) {
+        __uint64_t perRegister = VLEN >> (3 + sew);
+        return lmulShift >= 0 ? perRegister << lmulShift : perRegister >> -lmulShift;
+    }
+
+    // A group of LMUL registers must start on a multiple of LMUL
+    static inline bool GroupAligned(unsigned int reg, int lmulShift) {
+        return lmulShift <= 0 || (reg & ((1 << lmulShift) - 1)) == 0;
+    }
+
+    // Returns the new vl. An unsupported vtype sets vill, and vl to zero.
+    template<typename XLEN_t>
+    inline __uint64_t SetVType(XLEN_t value, XLEN_t avl) {
+        __uint32_t newSew = (value >> 3) & 0b111;
+        __uint32_t newLmul = value & 0b111;
+        bool reserved = (value >> 8) != 0 || newLmul == 4 || newSew > 3;
+        // Fractional LMUL must still leave room for one SEW element at ELEN
+        if (newLmul > 4 && newSew > newLmul - 5) {
+            reserved = true;
+        }
+        if (reserved) {
+            vill = true;
+            vma = vta = false;
+            vsew = vlmul = 0;
+            vl = 0;
+            return 0;
+        }
+        vill = false;
+        vma = (value >> 7) & 1;
+        vta = (value >> 6) & 1;
+        vsew = newSew;
+        vlmul = newLmul;
+        __uint64_t vlmax = VLMAX(vsew, LMULShift());
+        vl = (__uint64_t)avl < vlmax ? (__uint64_t)avl : vlmax;
+        return vl;
+    }
+
+    template<typename XLEN_t>
+    inline XLEN_t VType() {
+        if (vill) {
+            return (XLEN_t)1 << (sizeof(XLEN_t) * 8 - 1);
+        }
+        return (vma << 7) | (vta << 6) | (vsew << 3) | vlmul;
+    }
+
+    static inline bool IsCSR(RISCV::CSRAddress csrAddress) {
+        switch ((__uint32_t)csrAddress) {
+            case VSTART: case VXSAT: case VXRM: case VCSR:
+            case VL: case VTYPE: case VLENB_CSR:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    template<typename XLEN_t>
+    inline XLEN_t ReadCSR(RISCV::CSRAddress csrAddress) {
+        switch ((__uint32_t)csrAddress) {
+            case VSTART: return vstart;
+            case VXSAT: return vxsat;
+            case VXRM: return vxrm;
+            case VCSR: return (vxrm << 1) | vxsat;
+            case VL: return vl;
+            case VTYPE: return VType<XLEN_t>();
+            case VLENB_CSR: return VLENB;
+            default: return 0;
+        }
+    }
+
+    // vl, vtype and vlenb are read-only, and only change through vset{i}vl{i}
+    template<typename XLEN_t>
+    inline void WriteCSR(RISCV::CSRAddress csrAddress, XLEN_t value) {
+        switch ((__uint32_t)csrAddress) {
+            case VSTART: vstart = value & (VLEN - 1); break;
+            case VXSAT: vxsat = value & 1; break;
+            case VXRM: vxrm = value & 0b11; break;
+            case VCSR:
+                vxsat = value & 1;
+                vxrm = (value >> 1) & 0b11;
+                break;
+            default: break;
+        }
+    }
+
+};
@@ -0,0 +1,256 @@
+/*
+ * Picks simpoints from the basic block vectors that BasicBlockVectors (see
+ * SimPoints.hpp) wrote, the way SimPoint 3.0 does: each interval's vector is
+ * normalized and randomly projected down to a few dimensions, k-means is run
+ * for each k up to a maximum, and the smallest k whose BIC score comes within
+ * 90% of the best is taken. The interval nearest each cluster's centre stands
+ * for the cluster, weighted by the share of intervals in it. Build with
+ *
+ *     g++ -std=c++20 -O2 tools/SimPoints.cpp -o simpoints
+ *
+ * and run as
+ *
+ *     simpoints <run.bb> <run.simpoints> <run.weights> [max k]
+ *
+ * The two outputs are in SimPoint's own formats, for read_simpoints.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static constexpr unsigned int Dimensions = 15;
+static constexpr unsigned int Seeds = 5;
+static constexpr unsigned int MaxIterations = 100;
+static constexpr double BICThreshold = 0.9;
+static constexpr double VarianceFloor = 1e-4;
+
+typedef std::vector<double> Point;
+
+struct Clustering {
+    std::vector<Point> centres;
+    std::vector<unsigned int> assignment;
+    double distortion = std::numeric_limits<double>::infinity();
+};
+
+static double Distance(const Point& a, const Point& b) {
+    double sum = 0;
+    for (unsigned int dimension = 0; dimension < Dimensions; dimension++) {
+        sum += (a[dimension] - b[dimension]) * (a[dimension] - b[dimension]);
+    }
+    return sum;
+}
+
+// Reads T:id:count :id:count ... lines, projecting each interval as it goes,
+// so only the projection matrix's rows for blocks seen so far are kept.
+static bool ReadVectors(const char* path, std::vector<Point>* points) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::mt19937_64 random(1);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::vector<Point> projection;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] != 'T') {
+            continue;
+        }
+        std::vector<std::pair<__uint64_t, double>> counts;
+        double total = 0;
+        std::istringstream fields(line.substr(1));
+        char colon;
+        __uint64_t id, count;
+        while (fields >> colon >> id >> colon >> count) {
+            counts.push_back({ id, (double)count });
+            total += count;
+        }
+        Point point(Dimensions, 0.0);
+        for (auto [block, count] : counts) {
+            while (projection.size() < block) {
+                Point row(Dimensions);
+                for (double& value : row) {
+                    value = uniform(random);
+                }
+                projection.push_back(row);
+            }
+            for (unsigned int dimension = 0; dimension < Dimensions; dimension++) {
+                point[dimension] += projection[block - 1][dimension] * (count / total);
+            }
+        }
+        points->push_back(point);
+    }
+    return true;
+}
+
+// k-means with k-means++ seeding
+static Clustering KMeans(const std::vector<Point>& points, unsigned int k, std::mt19937_64& random) {
+    Clustering result;
+    std::vector<double> nearest(points.size(), std::numeric_limits<double>::infinity());
+    result.centres.push_back(points[std::uniform_int_distribution<std::size_t>(0, points.size() - 1)(random)]);
+    while (result.centres.size() < k) {
+        double sum = 0;
+        for (std::size_t index = 0; index < points.size(); index++) {
+            nearest[index] = std::min(nearest[index], Distance(points[index], result.centres.back()));
+            sum += nearest[index];
+        }
+        double pick = sum > 0 ? std::uniform_real_distribution<double>(0, sum)(random) : 0;
+        std::size_t chosen = 0;
+        for (; chosen + 1 < points.size() && pick > nearest[chosen]; chosen++) {
+            pick -= nearest[chosen];
+        }
+        result.centres.push_back(points[chosen]);
+    }
+    result.assignment.assign(points.size(), 0);
+    for (unsigned int iteration = 0; iteration < MaxIterations; iteration++) {
+        bool changed = iteration == 0;
+        result.distortion = 0;
+        for (std::size_t index = 0; index < points.size(); index++) {
+            unsigned int best = 0;
+            double bestDistance = std::numeric_limits<double>::infinity();
+            for (unsigned int cluster = 0; cluster < k; cluster++) {
+                double distance = Distance(points[index], result.centres[cluster]);
+                if (distance < bestDistance) {
+                    best = cluster;
+                    bestDistance = distance;
+                }
+            }
+            changed = changed || result.assignment[index] != best;
+            result.assignment[index] = best;
+            result.distortion += bestDistance;
+        }
+        if (!changed) {
+            break;
+        }
+        std::vector<Point> sums(k, Point(Dimensions, 0.0));
+        std::vector<std::size_t> sizes(k, 0);
+        for (std::size_t index = 0; index < points.size(); index++) {
+            for (unsigned int dimension = 0; dimension < Dimensions; dimension++) {
+                sums[result.assignment[index]][dimension] += points[index][dimension];
+            }
+            sizes[result.assignment[index]]++;
+        }
+        for (unsigned int cluster = 0; cluster < k; cluster++) {
+            if (sizes[cluster] == 0) {
+                continue; // Keeps its old centre
+            }
+            for (unsigned int dimension = 0; dimension < Dimensions; dimension++) {
+                result.centres[cluster][dimension] = sums[cluster][dimension] / sizes[cluster];
+            }
+        }
+    }
+    return result;
+}
+
+// The Bayesian information criterion of a clustering under an identical
+// spherical Gaussian model, as in X-means and SimPoint. The variance is kept
+// above a small fraction of the whole run's, minimumVariance, or else a run
+// that repeats exactly scores infinitely well for one cluster per distinct
+// interval.
+static double BIC(const std::vector<Point>& points, const Clustering& clustering, unsigned int k,
+                  double minimumVariance) {
+    double n = points.size();
+    if (n <= k) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    double variance = std::max(clustering.distortion / (n - k), minimumVariance);
+    std::vector<double> sizes(k, 0.0);
+    for (unsigned int cluster : clustering.assignment) {
+        sizes[cluster]++;
+    }
+    double likelihood = 0;
+    for (double size : sizes) {
+        if (size == 0) {
+            continue;
+        }
+        likelihood += size * std::log(size) - size * std::log(n) -
+                      size * Dimensions / 2.0 * std::log(2 * M_PI * variance) - (size - 1) * Dimensions / 2.0;
+    }
+    double parameters = (k - 1) + k * Dimensions + 1;
+    return likelihood - parameters / 2.0 * std::log(n);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <run.bb> <run.simpoints> <run.weights> [max k]\n", argv[0]);
+        return 1;
+    }
+    unsigned int maxK = argc > 4 ? std::stoul(argv[4]) : 30;
+    std::vector<Point> points;
+    if (!ReadVectors(argv[1], &points) || points.empty()) {
+        fprintf(stderr, "%s: no basic block vectors in %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    if (maxK > points.size()) {
+        maxK = points.size();
+    }
+
+    std::mt19937_64 random(1);
+    std::vector<Clustering> best(maxK + 1);
+    std::vector<double> scores(maxK + 1, -std::numeric_limits<double>::infinity());
+    for (unsigned int k = 1; k <= maxK; k++) {
+        for (unsigned int seed = 0; seed < Seeds; seed++) {
+            Clustering clustering = KMeans(points, k, random);
+            if (clustering.distortion < best[k].distortion) {
+                best[k] = clustering;
+            }
+        }
+        double minimumVariance = std::max(best[1].distortion / points.size() * VarianceFloor,
+                                          std::numeric_limits<double>::min());
+        scores[k] = BIC(points, best[k], k, minimumVariance);
+    }
+
+    double lowest = std::numeric_limits<double>::infinity();
+    double highest = -std::numeric_limits<double>::infinity();
+    for (unsigned int k = 1; k <= maxK; k++) {
+        if (std::isfinite(scores[k])) {
+            lowest = std::min(lowest, scores[k]);
+            highest = std::max(highest, scores[k]);
+        }
+    }
+    unsigned int chosen = 1;
+    for (unsigned int k = 1; k <= maxK; k++) {
+        if (std::isfinite(scores[k]) && scores[k] >= lowest + BICThreshold * (highest - lowest)) {
+            chosen = k;
+            break;
+        }
+    }
+
+    const Clustering& clustering = best[chosen];
+    std::ofstream simPoints(argv[2]);
+    std::ofstream weights(argv[3]);
+    for (unsigned int cluster = 0; cluster < chosen; cluster++) {
+        std::size_t representative = points.size();
+        std::size_t size = 0;
+        double nearest = std::numeric_limits<double>::infinity();
+        for (std::size_t index = 0; index < points.size(); index++) {
+            if (clustering.assignment[index] != cluster) {
+                continue;
+            }
+            size++;
+            double distance = Distance(points[index], clustering.centres[cluster]);
+            if (distance < nearest) {
+                representative = index;
+                nearest = distance;
+            }
+        }
+        if (size == 0) {
+            continue;
+        }
+        simPoints << representative << ' ' << cluster << '\n';
+        weights << (double)size / points.size() << ' ' << cluster << '\n';
+    }
+    if (!simPoints || !weights) {
+        fprintf(stderr, "%s: couldn't write %s or %s\n", argv[0], argv[2], argv[3]);
+        return 1;
+    }
+    fprintf(stderr, "%zu intervals, %u clusters\n", points.size(), chosen);
+    return 0;
+}